@@ -0,0 +1,92 @@
+#include "aggregate.hpp"
+#include "arena.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+const char* agg_func_name(AggFunc func) {
+    switch (func) {
+        case AGG_NONE:  return "";
+        case AGG_COUNT: return "COUNT";
+        case AGG_MAX:   return "MAX";
+        case AGG_MIN:   return "MIN";
+        case AGG_AVG:   return "AVG";
+        case AGG_SUM:   return "SUM";
+    }
+    return "?";
+}
+
+AggFunc parse_aggregate(const char *item, char *argument, size_t size) {
+    const char *open = strchr(item, '(');
+    const char *close = open ? strrchr(open, ')') : NULL;
+    if (!open || !close) {
+        snprintf(argument, size, "%s", item);
+        return AGG_NONE;
+    }
+    snprintf(argument, size, "%.*s", (int)(close - open - 1), open + 1);
+    size_t length = open - item;
+    for (int f = AGG_COUNT; f <= AGG_SUM; f++) {
+        const char *name = agg_func_name((AggFunc)f);
+        if (strlen(name) == length && strncasecmp(item, name, length) == 0) return (AggFunc)f;
+    }
+    snprintf(argument, size, "%s", item);
+    return AGG_NONE;
+}
+
+const char* next_list_item(const char *list, char *item, size_t size) {
+    if (!list) return NULL;
+    while (isspace((unsigned char)*list)) list++;
+    if (!*list) return NULL;
+    const char *end = strchr(list, ',');
+    size_t length = end ? (size_t)(end - list) : strlen(list);
+    while (length > 0 && isspace((unsigned char)list[length - 1])) length--;
+    if (length >= size) length = size - 1;
+    memcpy(item, list, length);
+    item[length] = '\0';
+    return end ? end + 1 : list + strlen(list);
+}
+
+static int list_contains(const char *list, size_t used, const char *item) {
+    char existing[256];
+    char *copy = strndup(list, used);
+    int found = 0;
+    for (const char *rest = copy; !found && (rest = next_list_item(rest, existing, sizeof(existing))); ) {
+        found = strcmp(existing, item) == 0;
+    }
+    free(copy);
+    return found;
+}
+
+static size_t append_item(char *list, size_t used, const char *item) {
+    if (used) list[used++] = ',';
+    strcpy(list + used, item);
+    return used + strlen(item);
+}
+
+Node* new_aggregate_node(const char *select_list, const char *group_by) {
+    char item[256], argument[256];
+    int aggregates = 0;
+    for (const char *rest = select_list; (rest = next_list_item(rest, item, sizeof(item))); ) {
+        if (parse_aggregate(item, argument, sizeof(argument)) != AGG_NONE) aggregates++;
+    }
+    if (!aggregates && !group_by) return NULL;
+
+    // Keys first, then aggregates: γ's output has the same order
+    size_t capacity = strlen(select_list) + (group_by ? strlen(group_by) : 0) + 2, used = 0;
+    char *list = (char *)arena_alloc(get_node_arena(), capacity);
+    list[0] = '\0';
+    for (const char *rest = group_by; (rest = next_list_item(rest, item, sizeof(item))); ) {
+        if (!list_contains(list, used, item)) used = append_item(list, used, item);
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        for (const char *rest = select_list; (rest = next_list_item(rest, item, sizeof(item))); ) {
+            int key = parse_aggregate(item, argument, sizeof(argument)) == AGG_NONE;
+            if (key == (pass == 0) && !list_contains(list, used, item)) used = append_item(list, used, item);
+        }
+    }
+
+    Node *node = new_node(OP_AGGREGATE, NULL, NULL);
+    node->arg1 = list;
+    return node;
+}
@@ -0,0 +1,30 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "parser.hpp"
+
+typedef enum AggFunc {
+    AGG_NONE,   // Plain column: a group key
+    AGG_COUNT,
+    AGG_MAX,
+    AGG_MIN,
+    AGG_AVG,
+    AGG_SUM     // Not in the grammar: the partial sums an AVG is pre-aggregated into
+} AggFunc;
+
+const char* agg_func_name(AggFunc func);
+
+// Splits an item such as "COUNT(t.c)" into its function and argument ("t.c");
+// a plain column is AGG_NONE with the item itself as the argument
+AggFunc parse_aggregate(const char *item, char *argument, size_t size);
+
+// Copies the next item of a comma separated list into item and returns the
+// rest of the list, or NULL once the list is exhausted
+const char* next_list_item(const char *list, char *item, size_t size);
+
+// γ for a select list: the GROUP BY columns (group_by may be NULL) and the
+// list's other plain columns as group keys, followed by its distinct
+// aggregates. NULL when there is neither an aggregate nor a GROUP BY.
+Node* new_aggregate_node(const char *select_list, const char *group_by);
+
+#endif
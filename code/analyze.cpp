@@ -0,0 +1,198 @@
+#include "analyze.hpp"
+#include "executor.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+
+// ---------------------------------------------------------------------------
+// HyperLogLog
+// ---------------------------------------------------------------------------
+
+static inline unsigned long long mix64(unsigned long long x) {
+    // splitmix64 finalizer: spreads nearby integers over all 64 bits
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+void hll_init(HyperLogLog *hll) {
+    memset(hll->registers, 0, sizeof(hll->registers));
+}
+
+void hll_add(HyperLogLog *hll, long long value) {
+    unsigned long long hash = mix64((unsigned long long)value);
+    unsigned int index = (unsigned int)(hash >> (64 - HLL_PRECISION));
+    // Rank of the first set bit in the remaining bits; the guard bit caps it
+    unsigned long long rest = (hash << HLL_PRECISION) | (1ULL << (HLL_PRECISION - 1));
+    unsigned char rank = (unsigned char)(__builtin_clzll(rest) + 1);
+    if (rank > hll->registers[index]) hll->registers[index] = rank;
+}
+
+void hll_merge(HyperLogLog *into, const HyperLogLog *from) {
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        if (from->registers[i] > into->registers[i]) into->registers[i] = from->registers[i];
+    }
+}
+
+double hll_estimate(const HyperLogLog *hll) {
+    double m = HLL_REGISTERS;
+    double sum = 0.0;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -hll->registers[i]);
+        zeros += hll->registers[i] == 0;
+    }
+    double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+    // Linear counting is more accurate while many registers are still empty
+    if (estimate <= 2.5 * m && zeros > 0) estimate = m * log(m / zeros);
+    return estimate;
+}
+
+// ---------------------------------------------------------------------------
+// ANALYZE
+// ---------------------------------------------------------------------------
+
+typedef struct ColumnSummary {
+    long long min_value;
+    long long max_value;
+    long long null_count;
+    HyperLogLog sketch;
+} ColumnSummary;
+
+// One thread's share of a table: rows [begin, end) of every column
+typedef struct AnalyzeTask {
+    const ColumnTable *table;
+    int begin;
+    int end;
+    ColumnSummary *summaries;   // One per column
+} AnalyzeTask;
+
+static void* analyze_rows(void *arg) {
+    AnalyzeTask *task = (AnalyzeTask *)arg;
+    for (int c = 0; c < task->table->column_count; c++) {
+        const long long *values = task->table->columns[c];
+        ColumnSummary *summary = &task->summaries[c];
+        long long min_value = LLONG_MAX, max_value = LLONG_MIN, nulls = 0;
+        for (int row = task->begin; row < task->end; row++) {
+            long long value = values[row];
+            if (value == COLFILE_NULL) {
+                nulls++;
+                continue;
+            }
+            if (value < min_value) min_value = value;
+            if (value > max_value) max_value = value;
+            hll_add(&summary->sketch, value);
+        }
+        summary->min_value = min_value;
+        summary->max_value = max_value;
+        summary->null_count = nulls;
+    }
+    return NULL;
+}
+
+static int clamp_int(long long value) {
+    return value > INT_MAX ? INT_MAX : (value < INT_MIN ? INT_MIN : (int)value);
+}
+
+TableStats* analyze_table(Symbol table_id, int thread_count) {
+    ColumnTable *table = exec_table(table_id);
+    if (!table) return NULL;
+
+    if (thread_count < 1) thread_count = 1;
+    // Threads with fewer rows than this are not worth starting
+    int max_threads = table->row_count / 65536 + 1;
+    if (thread_count > max_threads) thread_count = max_threads;
+
+    AnalyzeTask *tasks = (AnalyzeTask *)malloc(thread_count * sizeof(AnalyzeTask));
+    pthread_t *threads = (pthread_t *)malloc(thread_count * sizeof(pthread_t));
+    for (int t = 0; t < thread_count; t++) {
+        tasks[t].table = table;
+        tasks[t].begin = (int)((long long)table->row_count * t / thread_count);
+        tasks[t].end = (int)((long long)table->row_count * (t + 1) / thread_count);
+        tasks[t].summaries = (ColumnSummary *)malloc(table->column_count * sizeof(ColumnSummary));
+        for (int c = 0; c < table->column_count; c++) hll_init(&tasks[t].summaries[c].sketch);
+    }
+
+    // The calling thread takes the first range itself
+    for (int t = 1; t < thread_count; t++) pthread_create(&threads[t], NULL, analyze_rows, &tasks[t]);
+    analyze_rows(&tasks[0]);
+    for (int t = 1; t < thread_count; t++) pthread_join(threads[t], NULL);
+
+    // Merge into the first task's summaries
+    ColumnSummary *total = tasks[0].summaries;
+    for (int t = 1; t < thread_count; t++) {
+        for (int c = 0; c < table->column_count; c++) {
+            ColumnSummary *part = &tasks[t].summaries[c];
+            if (part->min_value < total[c].min_value) total[c].min_value = part->min_value;
+            if (part->max_value > total[c].max_value) total[c].max_value = part->max_value;
+            total[c].null_count += part->null_count;
+            hll_merge(&total[c].sketch, &part->sketch);
+        }
+    }
+
+    const char *name = symbol_name(table_id);
+    TableStats *stats = add_table_stats(name, table->row_count, table->column_count * (int)sizeof(long long));
+    for (int c = 0; c < table->column_count; c++) {
+        long long non_null = table->row_count - total[c].null_count;
+        double estimate = floor(hll_estimate(&total[c].sketch) + 0.5);
+        // The sketch can overshoot slightly; a column never has more values than rows
+        int distinct = (int)fmax(1.0, fmin(estimate, (double)non_null));
+        // String columns are recorded with min = max = 0, as the catalog expects
+        int string_column = exec_string_column(table, c);
+        ColumnStats *column = add_column_stats(stats, symbol_name(table->column_ids[c]), distinct,
+                                               string_column || non_null == 0 ? 0 : clamp_int(total[c].min_value),
+                                               string_column || non_null == 0 ? 0 : clamp_int(total[c].max_value),
+                                               1.0 / distinct);
+        column->null_count = clamp_int(total[c].null_count);
+        set_column_histogram(column, NULL, 0);
+        set_column_mcv(column, NULL, NULL, 0);
+    }
+
+    for (int t = 0; t < thread_count; t++) free(tasks[t].summaries);
+    free(tasks);
+    free(threads);
+    return stats;
+}
+
+int analyze_data_dir(const char *dir, int thread_count) {
+    DIR *handle = opendir(dir);
+    if (!handle) {
+        perror(dir);
+        return 0;
+    }
+    exec_set_data_dir(dir);
+
+    int analyzed = 0;
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length <= 4 || strcmp(entry->d_name + length - 4, ".col") != 0) continue;
+
+        char name[256];
+        snprintf(name, sizeof(name), "%.*s", (int)(length - 4), entry->d_name);
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        TableStats *stats = analyze_table(intern(name), thread_count);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (!stats) continue;
+
+        double elapsed_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+        printf("Analyzed %s: %d rows in %.1f ms\n", stats->name, stats->row_count, elapsed_ms);
+        for (int c = 0; c < stats->column_count; c++) {
+            ColumnStats *column = stats->columns[c];
+            printf("  %-20s distinct=%-10d min=%-12d max=%-12d nulls=%d\n", column->column,
+                   column->distinct_values, column->min_value, column->max_value, column->null_count);
+        }
+        analyzed++;
+    }
+    closedir(handle);
+    return analyzed;
+}
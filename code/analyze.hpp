@@ -0,0 +1,30 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include "stats.hpp"
+
+// HyperLogLog distinct-value sketch. Sketches built over disjoint parts of a
+// column merge into the sketch of the whole column.
+#define HLL_PRECISION 14
+#define HLL_REGISTERS (1 << HLL_PRECISION)
+
+typedef struct HyperLogLog {
+    unsigned char registers[HLL_REGISTERS];
+} HyperLogLog;
+
+void hll_init(HyperLogLog *hll);
+void hll_add(HyperLogLog *hll, long long value);
+void hll_merge(HyperLogLog *into, const HyperLogLog *from);
+double hll_estimate(const HyperLogLog *hll);
+
+// ANALYZE: scans a table once with thread_count threads (each over its own row
+// range, then merged) and replaces its catalog statistics with the row count
+// and, per column, NDV, min/max and NULL count. Histograms and MCV lists of the
+// table are dropped, since they no longer describe the data. Returns the
+// updated statistics, or NULL if the table has no data.
+TableStats* analyze_table(Symbol table_id, int thread_count);
+
+// Analyzes every <table>.col file in dir; returns the number of tables analyzed
+int analyze_data_dir(const char *dir, int thread_count);
+
+#endif
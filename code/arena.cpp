@@ -0,0 +1,110 @@
+#include "arena.hpp"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 16
+
+// Per thread, so every thread can parse and optimize its own query
+static thread_local Arena *node_arena = NULL;
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static char *block_data(ArenaBlock *block) {
+    return (char *)block + align_up(sizeof(ArenaBlock));
+}
+
+static ArenaBlock *new_block(Arena *arena, size_t min_size) {
+    size_t size = min_size > arena->block_size ? min_size : arena->block_size;
+    ArenaBlock *block = (ArenaBlock *)malloc(align_up(sizeof(ArenaBlock)) + size);
+    if (!block) return NULL;
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    arena->block_count++;
+    return block;
+}
+
+void arena_init(Arena *arena, size_t block_size) {
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->bytes_allocated = 0;
+    arena->block_count = 0;
+    arena->head = new_block(arena, arena->block_size);
+    arena->current = arena->head;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = align_up(size ? size : 1);
+    ArenaBlock *block = arena->current;
+
+    while (block->used + size > block->size) {
+        // Reuse blocks left over from before the last reset when they are big enough
+        if (block->next && block->next->size >= size) {
+            block = block->next;
+            block->used = 0;
+            continue;
+        }
+        ArenaBlock *fresh = new_block(arena, size);
+        if (!fresh) return NULL;
+        fresh->next = block->next;
+        block->next = fresh;
+        block = fresh;
+    }
+
+    arena->current = block;
+    void *ptr = block_data(block) + block->used;
+    block->used += size;
+    arena->bytes_allocated += size;
+    return ptr;
+}
+
+char *arena_strdup(Arena *arena, const char *str) {
+    if (!str) return NULL;
+    size_t len = strlen(str) + 1;
+    char *copy = (char *)arena_alloc(arena, len);
+    memcpy(copy, str, len);
+    return copy;
+}
+
+char *arena_printf(Arena *arena, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (len < 0) return NULL;
+
+    char *str = (char *)arena_alloc(arena, len + 1);
+    va_start(args, format);
+    vsnprintf(str, len + 1, format, args);
+    va_end(args);
+    return str;
+}
+
+void arena_reset(Arena *arena) {
+    arena->current = arena->head;
+    arena->head->used = 0;
+    arena->bytes_allocated = 0;
+}
+
+void arena_destroy(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = arena->current = NULL;
+    arena->bytes_allocated = 0;
+    if (node_arena == arena) node_arena = NULL;
+}
+
+void set_node_arena(Arena *arena) {
+    node_arena = arena;
+}
+
+Arena *get_node_arena() {
+    return node_arena;
+}
@@ -0,0 +1,46 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+// Bump allocator for everything that lives exactly as long as one query
+// (AST, plan copies, rewrite products and their strings). Individual
+// allocations are never freed; arena_reset releases all of them at once.
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;            // Usable bytes after the header
+    size_t used;
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock *head;       // First block, kept across resets
+    ArenaBlock *current;    // Block currently being bumped
+    size_t block_size;      // Default size for new blocks
+    size_t bytes_allocated; // Bytes handed out since the last reset
+    size_t block_count;     // Blocks obtained from malloc over the arena's lifetime
+} Arena;
+
+void arena_init(Arena *arena, size_t block_size);
+
+// Returns size bytes aligned for any type; never returns NULL unless malloc fails
+void *arena_alloc(Arena *arena, size_t size);
+
+char *arena_strdup(Arena *arena, const char *str);
+
+// printf into a string sized exactly for the result
+char *arena_printf(Arena *arena, const char *format, ...);
+
+// Releases every allocation in O(1); blocks are kept and reused by later allocations
+void arena_reset(Arena *arena);
+
+// Returns all blocks to the system
+void arena_destroy(Arena *arena);
+
+// Arena used by new_node() and the predicate constructors for the query the
+// calling thread is processing
+void set_node_arena(Arena *arena);
+Arena *get_node_arena();
+
+#endif
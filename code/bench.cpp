@@ -0,0 +1,303 @@
+// Microbenchmarks for the optimizer phases: parsing, cost estimation, the two
+// pushdown rewrites and the whole optimize_query(), over generated queries with
+// a growing number of joins and filters.
+//
+//   ./bench [--samples <n>] [--max-joins <n>] [--json <file|->]
+//
+// Every case runs a number of samples; a sample times a batch of operations
+// sized to take a few milliseconds. Reported are the mean time per operation
+// over the samples, their standard deviation and the fastest sample, plus
+// malloc() calls and arena bytes per operation. --json writes one JSON object
+// per case for trend tracking. Build with `make bench`.
+#include "parser.hpp"
+#include "optimizer.hpp"
+#include "arena.hpp"
+#include "stats.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_SAMPLES 15
+#define BENCH_DEFAULT_MAX_JOINS 8
+#define BENCH_MAX_TABLES 16
+#define BENCH_SAMPLE_NS 5e6             // Target duration of one sample
+#define BENCH_MAX_BATCH 4096            // Operations per sample at most (inputs are prepared up front)
+
+// ---------------------------------------------------------------------------
+// Allocation counting
+// ---------------------------------------------------------------------------
+
+static long malloc_calls = 0;
+
+// These replace glibc's allocator functions for the whole process, so calls
+// made inside libc (strdup(), fopen(), ...) are counted too. The glibc
+// allocator still does the work through its __libc_ entry points.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    malloc_calls++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    malloc_calls++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    malloc_calls++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+}
+
+// ---------------------------------------------------------------------------
+// Workload
+// ---------------------------------------------------------------------------
+
+// A chain of tables bench_t0 ⨝ bench_t1 ⨝ ... where each table references the
+// previous one, growing in size so that join order matters
+static void add_bench_tables() {
+    for (int t = 0; t < BENCH_MAX_TABLES; t++) {
+        char name[32];
+        snprintf(name, sizeof(name), "bench_t%d", t);
+        int rows = 1000 * (1 + (t * 7) % 11);
+        TableStats *table = add_table_stats(name, rows, 24);
+        add_column_stats(table, "id", rows, 1, rows, 1.0 / rows);
+        add_column_stats(table, "ref", rows / 4 + 1, 1, rows, 4.0 / rows);
+        add_column_stats(table, "val", 1000, 0, 999, 0.001);
+    }
+}
+
+// Filters alternate between the last and the first table, AND-ed together
+static char* bench_query(int joins, int filters) {
+    static char text[4096];
+    int length = snprintf(text, sizeof(text), "SELECT bench_t0.val, bench_t%d.val FROM bench_t0", joins);
+    for (int j = 1; j <= joins; j++) {
+        length += snprintf(text + length, sizeof(text) - length, " JOIN bench_t%d ON bench_t%d.id = bench_t%d.ref",
+                           j, j - 1, j);
+    }
+    for (int f = 0; f < filters; f++) {
+        length += snprintf(text + length, sizeof(text) - length, f % 2 ? " %s bench_t0.val > %d" : " %s bench_t%d.val < 100",
+                           f ? "AND" : "WHERE", f % 2 ? 900 - f : joins);
+    }
+    snprintf(text + length, sizeof(text) - length, ";");
+    return text;
+}
+
+// ---------------------------------------------------------------------------
+// Phases
+// ---------------------------------------------------------------------------
+
+typedef struct BenchCase {
+    const char *query;
+    Node *bound;                // Parsed and bound once, outside the arena under test
+    Node *inputs[BENCH_MAX_BATCH];
+    Arena *arena;
+} BenchCase;
+
+typedef enum PhaseKind {
+    PHASE_PARSE,
+    PHASE_ESTIMATE_COST,
+    PHASE_TOTAL_COST,
+    PHASE_PUSH_SELECTIONS,
+    PHASE_PUSH_PROJECTIONS,
+    PHASE_OPTIMIZE
+} PhaseKind;
+
+static const char *phase_names[] = {
+    "parse", "estimate_cost", "total_plan_cost", "push_down_selections", "push_down_projections", "optimize_query"
+};
+#define PHASE_COUNT 6
+
+// Gives every operation of the next batch its own copy of the plan, since the
+// rewrites modify their input and the cost phases must start without cached costs
+static void prepare_inputs(BenchCase *bench, PhaseKind phase, int batch) {
+    if (phase == PHASE_PARSE) return;
+    for (int i = 0; i < batch; i++) {
+        bench->inputs[i] = duplicate_node(bench->bound);
+        invalidate_costs(bench->inputs[i]);
+    }
+}
+
+static void run_operation(BenchCase *bench, PhaseKind phase, int i) {
+    switch (phase) {
+        case PHASE_PARSE: {
+            ParseContext parse;
+            init_parse_context(&parse, bench->arena);
+            parse_query(bench->query, &parse);
+            break;
+        }
+        case PHASE_ESTIMATE_COST:    estimate_cost(bench->inputs[i]); break;
+        case PHASE_TOTAL_COST:       calculate_total_plan_cost(bench->inputs[i]); break;
+        case PHASE_PUSH_SELECTIONS:  push_down_selections(bench->inputs[i]); break;
+        case PHASE_PUSH_PROJECTIONS: push_down_projections(bench->inputs[i]); break;
+        case PHASE_OPTIMIZE:         optimize_query(bench->inputs[i]); break;
+    }
+}
+
+static double now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+typedef struct BenchResult {
+    double mean_ns;
+    double stddev_ns;
+    double min_ns;
+    double mallocs_per_op;
+    double arena_bytes_per_op;
+    int batch;
+} BenchResult;
+
+// Times one batch; returns ns per operation
+static double run_batch(BenchCase *bench, PhaseKind phase, int batch, long *mallocs, size_t *arena_bytes) {
+    arena_reset(bench->arena);
+    prepare_inputs(bench, phase, batch);
+    long mallocs_before = malloc_calls;
+    size_t bytes_before = bench->arena->bytes_allocated;
+
+    double start = now_ns();
+    for (int i = 0; i < batch; i++) run_operation(bench, phase, i);
+    double elapsed = now_ns() - start;
+
+    *mallocs = malloc_calls - mallocs_before;
+    *arena_bytes = bench->arena->bytes_allocated - bytes_before;
+    return elapsed / batch;
+}
+
+static BenchResult run_phase(BenchCase *bench, PhaseKind phase, int samples) {
+    BenchResult result = {0.0, 0.0, 0.0, 0.0, 0.0, 1};
+    long mallocs;
+    size_t arena_bytes;
+
+    // Grow the batch until a sample takes long enough to time reliably
+    double per_op = run_batch(bench, phase, 1, &mallocs, &arena_bytes);
+    while (result.batch < BENCH_MAX_BATCH && per_op * result.batch < BENCH_SAMPLE_NS) {
+        result.batch *= 2;
+        per_op = run_batch(bench, phase, result.batch, &mallocs, &arena_bytes);
+    }
+
+    double sum = 0.0, sum_squares = 0.0;
+    long total_mallocs = 0;
+    size_t total_bytes = 0;
+    result.min_ns = INFINITY;
+    for (int s = 0; s < samples; s++) {
+        per_op = run_batch(bench, phase, result.batch, &mallocs, &arena_bytes);
+        sum += per_op;
+        sum_squares += per_op * per_op;
+        if (per_op < result.min_ns) result.min_ns = per_op;
+        total_mallocs += mallocs;
+        total_bytes += arena_bytes;
+    }
+    long ops = (long)samples * result.batch;
+    result.mean_ns = sum / samples;
+    result.stddev_ns = sqrt(fmax(0.0, sum_squares / samples - result.mean_ns * result.mean_ns));
+    result.mallocs_per_op = (double)total_mallocs / ops;
+    result.arena_bytes_per_op = (double)total_bytes / ops;
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------------
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--samples <n>] [--max-joins <n>] [--json <file|->]\n", program);
+}
+
+int main(int argc, char **argv) {
+    int samples = BENCH_DEFAULT_SAMPLES, max_joins = BENCH_DEFAULT_MAX_JOINS;
+    const char *json_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-joins") == 0 && i + 1 < argc) {
+            max_joins = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (samples < 2) samples = 2;
+    if (max_joins < 0) max_joins = 0;
+    if (max_joins > BENCH_MAX_TABLES - 1) max_joins = BENCH_MAX_TABLES - 1;
+
+    // With --json - the results own stdout; everything else goes to stderr
+    FILE *json = NULL;
+    if (json_path && strcmp(json_path, "-") == 0) {
+        fflush(stdout);
+        json = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    } else if (json_path) {
+        json = fopen(json_path, "w");
+        if (!json) {
+            perror(json_path);
+            return 1;
+        }
+    }
+
+    optimizer_verbose = 0;
+    init_stats();
+    add_bench_tables();
+
+    Arena setup_arena, bench_arena;
+    arena_init(&setup_arena, ARENA_DEFAULT_BLOCK_SIZE);
+    arena_init(&bench_arena, ARENA_DEFAULT_BLOCK_SIZE);
+    BenchCase *bench = (BenchCase *)calloc(1, sizeof(BenchCase));
+    bench->arena = &bench_arena;
+
+    printf("\n%-22s | %5s | %7s | %12s | %10s | %12s | %9s | %s\n", "Phase", "Joins", "Filters",
+           "ns/op", "stddev %", "min ns/op", "mallocs", "arena B/op");
+    printf("-----------------------+-------+---------+--------------+------------+--------------+-----------+-----------\n");
+
+    for (int joins = 0; joins <= max_joins; joins = joins ? joins * 2 : 1) {
+        for (int filters = 0; filters <= 2; filters++) {
+            bench->query = arena_strdup(&setup_arena, bench_query(joins, filters));
+            set_node_arena(&setup_arena);
+            ParseContext parse;
+            init_parse_context(&parse, &setup_arena);
+            bench->bound = parse_query(bench->query, &parse);
+            if (!bench->bound) {
+                fprintf(stderr, "Could not parse benchmark query: %s\n", bench->query);
+                return 1;
+            }
+            bind_predicates(bench->bound);
+            set_node_arena(&bench_arena);
+
+            for (int phase = 0; phase < PHASE_COUNT; phase++) {
+                BenchResult result = run_phase(bench, (PhaseKind)phase, samples);
+                printf("%-22s | %5d | %7d | %12.1f | %10.1f | %12.1f | %9.1f | %.0f\n", phase_names[phase], joins,
+                       filters, result.mean_ns, 100.0 * result.stddev_ns / result.mean_ns, result.min_ns,
+                       result.mallocs_per_op, result.arena_bytes_per_op);
+                if (json) {
+                    fprintf(json, "{\"phase\":\"%s\",\"joins\":%d,\"filters\":%d,\"ns_per_op\":%.1f,\"stddev_ns\":%.1f,"
+                            "\"min_ns\":%.1f,\"mallocs_per_op\":%.2f,\"arena_bytes_per_op\":%.0f,\"samples\":%d,"
+                            "\"batch\":%d}\n", phase_names[phase], joins, filters, result.mean_ns, result.stddev_ns,
+                            result.min_ns, result.mallocs_per_op, result.arena_bytes_per_op, samples, result.batch);
+                }
+            }
+            arena_reset(&setup_arena);
+        }
+    }
+
+    if (json) fclose(json);
+    free(bench);
+    arena_destroy(&bench_arena);
+    arena_destroy(&setup_arena);
+    free_stats();
+    return 0;
+}
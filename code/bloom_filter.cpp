@@ -0,0 +1,53 @@
+#include "bloom_filter.hpp"
+#include <stdlib.h>
+
+// Odd multipliers spreading the low hash word over the eight words of a block
+static const unsigned int bloom_salts[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+static inline unsigned long long bloom_hash(long long key) {
+    return (unsigned long long)key * 0x9E3779B97F4A7C15ULL;
+}
+
+BloomFilter* bloom_create(int keys) {
+    unsigned long long bits = (unsigned long long)(keys > 0 ? keys : 1) * BLOOM_BITS_PER_KEY;
+    unsigned int blocks = 1;
+    while ((unsigned long long)blocks * 256 < bits) blocks <<= 1;
+
+    BloomFilter *filter = (BloomFilter *)malloc(sizeof(BloomFilter));
+    filter->words = (unsigned int *)calloc((size_t)blocks * 8, sizeof(unsigned int));
+    filter->block_mask = blocks - 1;
+    return filter;
+}
+
+void bloom_free(BloomFilter *filter) {
+    if (!filter) return;
+    free(filter->words);
+    free(filter);
+}
+
+void bloom_insert(BloomFilter *filter, long long key) {
+    unsigned long long h = bloom_hash(key);
+    unsigned int *block = filter->words + (size_t)((unsigned int)(h >> 32) & filter->block_mask) * 8;
+    for (int w = 0; w < 8; w++) block[w] |= 1U << (((unsigned int)h * bloom_salts[w]) >> 27);
+}
+
+int bloom_contains(const BloomFilter *filter, long long key) {
+    unsigned long long h = bloom_hash(key);
+    const unsigned int *block = filter->words + (size_t)((unsigned int)(h >> 32) & filter->block_mask) * 8;
+    unsigned int missing = 0;
+    for (int w = 0; w < 8; w++) missing |= ~block[w] & (1U << (((unsigned int)h * bloom_salts[w]) >> 27));
+    return missing == 0;
+}
+
+int bloom_select(const BloomFilter *filter, const long long *values, const int *in, int n, int *out) {
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        int row = in ? in[i] : i;
+        out[kept] = row;
+        kept += bloom_contains(filter, values[row]);
+    }
+    return kept;
+}
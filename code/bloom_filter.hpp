@@ -0,0 +1,28 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+// Blocked Bloom filter over int64 keys. A key picks one 256-bit block (eight
+// 32-bit words) and sets one bit in every word, so inserting or testing it
+// touches a single block. With at least BLOOM_BITS_PER_KEY bits per key the
+// false positive rate stays below 0.1%; there are no false negatives.
+
+#define BLOOM_BITS_PER_KEY 16
+
+typedef struct BloomFilter {
+    unsigned int *words;        // block_count × 8 words
+    unsigned int block_mask;    // block_count - 1 (a power of two)
+} BloomFilter;
+
+// Sized for keys insertions
+BloomFilter* bloom_create(int keys);
+void bloom_free(BloomFilter *filter);
+
+void bloom_insert(BloomFilter *filter, long long key);
+int bloom_contains(const BloomFilter *filter, long long key);
+
+// Writes the rows whose value may be in the filter to out and returns how many
+// there are. The rows tested are in[0 .. n), or 0 .. n - 1 when in is NULL;
+// out may be in.
+int bloom_select(const BloomFilter *filter, const long long *values, const int *in, int n, int *out);
+
+#endif
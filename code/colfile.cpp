@@ -0,0 +1,91 @@
+#include "colfile.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static uint64_t align_up(uint64_t offset) {
+    return (offset + COLFILE_ALIGNMENT - 1) & ~(uint64_t)(COLFILE_ALIGNMENT - 1);
+}
+
+uint64_t colfile_column_offset(uint32_t column_count, uint64_t row_count, uint32_t column) {
+    uint64_t data_start = align_up(sizeof(ColumnFileHeader) + column_count * sizeof(ColumnFileEntry));
+    return data_start + column * align_up(row_count * sizeof(long long));
+}
+
+uint64_t colfile_size(uint32_t column_count, uint64_t row_count) {
+    return colfile_column_offset(column_count, row_count, column_count);
+}
+
+ColumnFile* colfile_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ColumnFileHeader)) {
+        fprintf(stderr, "%s: not a column file\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+
+    const ColumnFileHeader *header = (const ColumnFileHeader *)mapping;
+    if (memcmp(header->magic, COLFILE_MAGIC, sizeof(header->magic)) != 0 || header->version != COLFILE_VERSION ||
+        colfile_size(header->column_count, header->row_count) > (uint64_t)st.st_size) {
+        fprintf(stderr, "%s: bad column file header\n", path);
+        munmap(mapping, st.st_size);
+        return NULL;
+    }
+
+    const ColumnFileEntry *entries = (const ColumnFileEntry *)(header + 1);
+    for (uint32_t c = 0; c < header->column_count; c++) {
+        if (entries[c].offset != colfile_column_offset(header->column_count, header->row_count, c)) {
+            fprintf(stderr, "%s: column %u is not where the layout puts it\n", path, c);
+            munmap(mapping, st.st_size);
+            return NULL;
+        }
+    }
+
+    // Scans read each column front to back
+    madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+
+    ColumnFile *file = (ColumnFile *)malloc(sizeof(ColumnFile));
+    file->mapping = mapping;
+    file->size = st.st_size;
+    file->header = header;
+    file->entries = entries;
+    return file;
+}
+
+void colfile_close(ColumnFile *file) {
+    if (!file) return;
+    munmap(file->mapping, file->size);
+    free(file);
+}
+
+const long long* colfile_column(const ColumnFile *file, uint32_t c) {
+    return (const long long *)((const char *)file->mapping + file->entries[c].offset);
+}
+
+long long string_code(const char *value) {
+    // FNV-1a
+    unsigned long long hash = 1469598103934665603ULL;
+    for (const unsigned char *p = (const unsigned char *)value; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    // Keep codes clear of COLFILE_NULL
+    return hash == (unsigned long long)COLFILE_NULL ? (long long)(hash + 1) : (long long)hash;
+}
@@ -0,0 +1,70 @@
+#ifndef COLFILE_H
+#define COLFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+
+// Columnar table file (.col):
+//
+//   ColumnFileHeader
+//   ColumnFileEntry[column_count]
+//   padding to COLFILE_ALIGNMENT
+//   column 0: row_count int64 values, padded to COLFILE_ALIGNMENT
+//   column 1: ...
+//
+// Every column is one contiguous, page-aligned array, so a mapped file is
+// scanned in place. Strings are stored as string_code() of their text and
+// NULL as COLFILE_NULL, which sorts below every value. All integers are
+// little-endian.
+
+#define COLFILE_MAGIC "QPCOL01"
+#define COLFILE_VERSION 1
+#define COLFILE_ALIGNMENT 4096
+#define COLFILE_NAME_LENGTH 48
+#define COLFILE_NULL LLONG_MIN
+
+typedef enum ColumnType {
+    COLUMN_INT64 = 1,
+    COLUMN_STRING = 2
+} ColumnType;
+
+typedef struct ColumnFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t column_count;
+    uint64_t row_count;
+    char table_name[COLFILE_NAME_LENGTH];
+} ColumnFileHeader;
+
+typedef struct ColumnFileEntry {
+    char name[COLFILE_NAME_LENGTH];
+    uint32_t type;              // ColumnType
+    uint32_t reserved;
+    uint64_t null_count;
+    uint64_t offset;            // File offset of the column's values
+} ColumnFileEntry;
+
+// An open, read-only mapping of a .col file
+typedef struct ColumnFile {
+    void *mapping;
+    size_t size;
+    const ColumnFileHeader *header;
+    const ColumnFileEntry *entries;
+} ColumnFile;
+
+// Layout shared by the reader and the writer
+uint64_t colfile_column_offset(uint32_t column_count, uint64_t row_count, uint32_t column);
+uint64_t colfile_size(uint32_t column_count, uint64_t row_count);
+
+// Maps a file and checks its header and layout; prints the reason and returns NULL on error
+ColumnFile* colfile_open(const char *path);
+void colfile_close(ColumnFile *file);
+
+// Values of column c, pointing into the mapping
+const long long* colfile_column(const ColumnFile *file, uint32_t c);
+
+// 64-bit code a string value is stored and compared as
+long long string_code(const char *value);
+
+#endif
@@ -0,0 +1,210 @@
+// csv2col: converts a CSV file with a header row into a .col columnar table.
+//
+//   csv2col <input.csv> <output.col> [table name]
+//
+// Columns whose non-empty fields all parse as integers become COLUMN_INT64,
+// the rest COLUMN_STRING; empty fields are stored as COLFILE_NULL. The input
+// is read twice (types and row count, then values) and the output is written
+// through a mapping, so neither side has to fit in memory.
+#include "colfile.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Fields of the current line, split in place
+typedef struct CsvRecord {
+    char **fields;
+    int count;
+    int capacity;
+} CsvRecord;
+
+// Splits line into fields, handling "quoted, fields" and "" escapes; quoted
+// fields may not span lines
+static void split_record(char *line, CsvRecord *record) {
+    record->count = 0;
+    char *p = line;
+    for (;;) {
+        if (record->count == record->capacity) {
+            record->capacity = record->capacity ? record->capacity * 2 : 16;
+            record->fields = (char **)realloc(record->fields, record->capacity * sizeof(char *));
+        }
+        char *out = p;
+        record->fields[record->count++] = out;
+        if (*p == '"') {
+            p++;
+            while (*p) {
+                if (*p == '"' && p[1] == '"') {
+                    *out++ = '"';
+                    p += 2;
+                } else if (*p == '"') {
+                    p++;
+                    break;
+                } else {
+                    *out++ = *p++;
+                }
+            }
+            while (*p && *p != ',') p++;
+        } else {
+            while (*p && *p != ',') *out++ = *p++;
+        }
+        int more = *p == ',';
+        *out = '\0';
+        if (!more) break;
+        p++;
+    }
+}
+
+// getline without the trailing newline; returns 0 at end of input
+static int read_record(FILE *file, char **line, size_t *capacity, CsvRecord *record) {
+    ssize_t length = getline(line, capacity, file);
+    if (length < 0) return 0;
+    while (length > 0 && ((*line)[length - 1] == '\n' || (*line)[length - 1] == '\r')) (*line)[--length] = '\0';
+    split_record(*line, record);
+    return 1;
+}
+
+static int parse_integer(const char *text, long long *value) {
+    char *end;
+    errno = 0;
+    *value = strtoll(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0 && *value != COLFILE_NULL;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3 || argc > 4) {
+        fprintf(stderr, "Usage: %s <input.csv> <output.col> [table name]\n", argv[0]);
+        return 1;
+    }
+    const char *input_path = argv[1], *output_path = argv[2];
+
+    FILE *input = fopen(input_path, "r");
+    if (!input) {
+        perror(input_path);
+        return 1;
+    }
+
+    char *line = NULL;
+    size_t line_capacity = 0;
+    CsvRecord record = {NULL, 0, 0};
+    if (!read_record(input, &line, &line_capacity, &record)) {
+        fprintf(stderr, "%s: no header row\n", input_path);
+        return 1;
+    }
+
+    uint32_t column_count = record.count;
+    ColumnFileEntry *entries = (ColumnFileEntry *)calloc(column_count, sizeof(ColumnFileEntry));
+    for (uint32_t c = 0; c < column_count; c++) {
+        if (strlen(record.fields[c]) >= COLFILE_NAME_LENGTH) {
+            fprintf(stderr, "%s: column name \"%s\" is too long\n", input_path, record.fields[c]);
+            return 1;
+        }
+        strcpy(entries[c].name, record.fields[c]);
+        entries[c].type = COLUMN_INT64;
+    }
+
+    // Pass 1: row count, column types and NULL counts
+    uint64_t row_count = 0;
+    while (read_record(input, &line, &line_capacity, &record)) {
+        if (record.count == 1 && record.fields[0][0] == '\0') continue;
+        if ((uint32_t)record.count != column_count) {
+            fprintf(stderr, "%s: row %llu has %d fields, expected %u\n", input_path,
+                    (unsigned long long)row_count + 1, record.count, column_count);
+            return 1;
+        }
+        for (uint32_t c = 0; c < column_count; c++) {
+            long long value;
+            if (record.fields[c][0] == '\0') {
+                entries[c].null_count++;
+            } else if (entries[c].type == COLUMN_INT64 && !parse_integer(record.fields[c], &value)) {
+                entries[c].type = COLUMN_STRING;
+            }
+        }
+        row_count++;
+    }
+
+    uint64_t size = colfile_size(column_count, row_count);
+    int fd = open(output_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, size) < 0) {
+        perror(output_path);
+        return 1;
+    }
+    char *mapping = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        perror(output_path);
+        return 1;
+    }
+
+    ColumnFileHeader *header = (ColumnFileHeader *)mapping;
+    memcpy(header->magic, COLFILE_MAGIC, sizeof(header->magic));
+    header->version = COLFILE_VERSION;
+    header->column_count = column_count;
+    header->row_count = row_count;
+    if (argc == 4) {
+        strncpy(header->table_name, argv[3], COLFILE_NAME_LENGTH - 1);
+    } else {
+        // Default table name: the input file name without directory or extension
+        const char *base = strrchr(input_path, '/') ? strrchr(input_path, '/') + 1 : input_path;
+        size_t length = strcspn(base, ".");
+        if (length >= COLFILE_NAME_LENGTH) length = COLFILE_NAME_LENGTH - 1;
+        memcpy(header->table_name, base, length);
+    }
+
+    char table_name[COLFILE_NAME_LENGTH];
+    memcpy(table_name, header->table_name, COLFILE_NAME_LENGTH);
+
+    long long **columns = (long long **)malloc(column_count * sizeof(long long *));
+    ColumnFileEntry *file_entries = (ColumnFileEntry *)(header + 1);
+    for (uint32_t c = 0; c < column_count; c++) {
+        entries[c].offset = colfile_column_offset(column_count, row_count, c);
+        file_entries[c] = entries[c];
+        columns[c] = (long long *)(mapping + entries[c].offset);
+    }
+
+    // Pass 2: values
+    rewind(input);
+    read_record(input, &line, &line_capacity, &record);
+    uint64_t row = 0;
+    while (row < row_count && read_record(input, &line, &line_capacity, &record)) {
+        if (record.count == 1 && record.fields[0][0] == '\0') continue;
+        for (uint32_t c = 0; c < column_count; c++) {
+            const char *field = record.fields[c];
+            long long value;
+            if (field[0] == '\0') {
+                value = COLFILE_NULL;
+            } else if (entries[c].type == COLUMN_STRING) {
+                value = string_code(field);
+            } else {
+                parse_integer(field, &value);
+            }
+            columns[c][row] = value;
+        }
+        row++;
+    }
+
+    int status = 0;
+    if (row != row_count) {
+        fprintf(stderr, "%s: changed while it was being converted\n", input_path);
+        status = 1;
+    }
+    if (msync(mapping, size, MS_SYNC) < 0) {
+        perror(output_path);
+        status = 1;
+    }
+    munmap(mapping, size);
+    close(fd);
+    fclose(input);
+
+    if (status == 0) {
+        printf("Wrote %s: table %s, %llu rows, %u columns\n", output_path, table_name,
+               (unsigned long long)row_count, column_count);
+    }
+    free(columns);
+    free(entries);
+    free(record.fields);
+    free(line);
+    return status;
+}
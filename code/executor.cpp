@@ -0,0 +1,1551 @@
+#include "executor.hpp"
+#include "optimizer.hpp"
+#include "stats.hpp"
+#include "simd_filter.hpp"
+#include "colfile.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
+#include "aggregate.hpp"
+#include "bloom_filter.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+
+// ---------------------------------------------------------------------------
+// Tables: mapped from <data dir>/<table>.col when present, else synthesized
+// ---------------------------------------------------------------------------
+
+static ColumnTable **exec_tables = NULL;
+static int exec_table_count = 0;
+static const char *exec_data_dir = NULL;
+
+void exec_set_data_dir(const char *dir) {
+    exec_data_dir = dir;
+}
+
+static unsigned long long next_random(unsigned long long *state) {
+    // xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+static double next_unit(unsigned long long *state) {
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Draws one value following the column's statistics: MCVs with their
+// frequencies, the rest from a random histogram bucket (equi-depth, so each is
+// equally likely) or uniformly from distinct_values evenly spaced values
+static long long generate_value(const ColumnStats *stats, int row, int row_count, unsigned long long *state) {
+    long long distinct = stats->distinct_values > 1 ? stats->distinct_values : 1;
+    if (stats->min_value == 0 && stats->max_value == 0) {
+        // Strings "<column>_<k>"; unique per row when the column is key-like
+        char text[96];
+        long long k = distinct >= row_count ? row % distinct : (long long)(next_random(state) % (unsigned long long)distinct);
+        snprintf(text, sizeof(text), "%s_%lld", symbol_name(stats->column_id), k);
+        return string_code(text);
+    }
+
+    double u = next_unit(state);
+    for (int i = 0; i < stats->mcv_count; i++) {
+        if (u < stats->mcv_frequencies[i]) return stats->mcv_values[i];
+        u -= stats->mcv_frequencies[i];
+    }
+
+    if (stats->histogram_buckets > 0) {
+        int bucket = (int)(next_random(state) % (unsigned long long)stats->histogram_buckets);
+        long long low = stats->histogram_bounds[bucket];
+        long long high = stats->histogram_bounds[bucket + 1];
+        return low + (long long)(next_unit(state) * (high - low));
+    }
+
+    long long range = (long long)stats->max_value - stats->min_value;
+    long long step = distinct > 1 && range / (distinct - 1) > 0 ? range / (distinct - 1) : 1;
+    // Key-like columns (one value per row) become a dense sequence so they stay unique
+    long long index = distinct >= row_count ? row : (long long)(next_random(state) % (unsigned long long)distinct);
+    return stats->min_value + index * step;
+}
+
+static ColumnTable* build_table(TableStats *stats) {
+    ColumnTable *table = (ColumnTable *)malloc(sizeof(ColumnTable));
+    table->table_id = stats->table_id;
+    table->row_count = stats->row_count;
+    table->column_count = stats->column_count;
+    table->column_ids = (Symbol *)malloc(stats->column_count * sizeof(Symbol));
+    table->columns = (long long **)malloc(stats->column_count * sizeof(long long *));
+    table->file = NULL;
+
+    for (int c = 0; c < stats->column_count; c++) {
+        ColumnStats *column = stats->columns[c];
+        unsigned long long state = 0x9E3779B97F4A7C15ULL ^ ((unsigned long long)column->table_id << 32) ^ column->column_id;
+        table->column_ids[c] = column->column_id;
+        table->columns[c] = (long long *)malloc((table->row_count ? table->row_count : 1) * sizeof(long long));
+        for (int row = 0; row < table->row_count; row++) {
+            table->columns[c][row] = generate_value(column, row, table->row_count, &state);
+        }
+    }
+    return table;
+}
+
+// Columns point straight into the mapped pages; nothing is read until scanned
+static ColumnTable* map_table(Symbol table_id) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s.col", exec_data_dir, symbol_name(table_id));
+    FILE *probe = fopen(path, "rb");
+    if (!probe) return NULL;
+    fclose(probe);
+
+    ColumnFile *file = colfile_open(path);
+    if (!file) return NULL;
+    const ColumnFileHeader *header = file->header;
+    if (header->row_count > INT_MAX || header->column_count > EXEC_MAX_COLUMNS) {
+        fprintf(stderr, "%s: %llu rows x %u columns is more than the executor handles\n", path,
+                (unsigned long long)header->row_count, header->column_count);
+        colfile_close(file);
+        return NULL;
+    }
+
+    ColumnTable *table = (ColumnTable *)malloc(sizeof(ColumnTable));
+    table->table_id = table_id;
+    table->row_count = (int)header->row_count;
+    table->column_count = header->column_count;
+    table->column_ids = (Symbol *)malloc(header->column_count * sizeof(Symbol));
+    table->columns = (long long **)malloc(header->column_count * sizeof(long long *));
+    table->file = file;
+    for (uint32_t c = 0; c < header->column_count; c++) {
+        char name[COLFILE_NAME_LENGTH + 1];
+        memcpy(name, file->entries[c].name, COLFILE_NAME_LENGTH);
+        name[COLFILE_NAME_LENGTH] = '\0';
+        table->column_ids[c] = intern(name);
+        // Operators never write through table columns
+        table->columns[c] = (long long *)colfile_column(file, c);
+    }
+    return table;
+}
+
+int exec_string_column(const ColumnTable *table, int c) {
+    if (table->file) return table->file->entries[c].type == COLUMN_STRING;
+    ColumnStats *stats = find_column_stats(table->table_id, table->column_ids[c]);
+    return stats && stats->min_value == 0 && stats->max_value == 0;
+}
+
+ColumnTable* exec_table(Symbol table_id) {
+    for (int i = 0; i < exec_table_count; i++) {
+        if (exec_tables[i]->table_id == table_id) return exec_tables[i];
+    }
+
+    ColumnTable *table = exec_data_dir ? map_table(table_id) : NULL;
+    if (!table) {
+        TableStats *stats = find_table_stats(table_id);
+        if (!stats) return NULL;
+        table = build_table(stats);
+    }
+    exec_tables = (ColumnTable **)realloc(exec_tables, (exec_table_count + 1) * sizeof(ColumnTable *));
+    exec_tables[exec_table_count++] = table;
+    return table;
+}
+
+void exec_free_tables() {
+    for (int i = 0; i < exec_table_count; i++) {
+        if (exec_tables[i]->file) {
+            colfile_close(exec_tables[i]->file);
+        } else {
+            for (int c = 0; c < exec_tables[i]->column_count; c++) free(exec_tables[i]->columns[c]);
+        }
+        free(exec_tables[i]->columns);
+        free(exec_tables[i]->column_ids);
+        free(exec_tables[i]);
+    }
+    free(exec_tables);
+    exec_tables = NULL;
+    exec_table_count = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Operators
+// ---------------------------------------------------------------------------
+
+// Open-addressing set of int64 values (IN subquery results, semi-join build sides)
+typedef struct ValueSet {
+    long long *values;
+    unsigned char *used;
+    int capacity;               // Power of two
+    int count;
+} ValueSet;
+
+// One join input materialized column by column. For hash joins the rows are
+// also grouped by radix partition: order lists row ids partition by partition
+// and keys holds their join keys in the same order.
+typedef struct JoinInput {
+    long long **rows;           // rows[c][i]
+    int width;
+    int row_count, row_capacity;
+    int key;                    // Join key column
+    long long *keys;
+    int *order;
+    int *offsets;               // Partition p is order[offsets[p] .. offsets[p + 1])
+} JoinInput;
+
+// Equi-joins are radix hash joins: both inputs are split on the low bits of
+// the key hash into partitions whose hash table fits in L2, then joined one
+// partition pair at a time through a flat open-addressing table built on the
+// input the optimizer expects to be smaller. Other joins are nested loops over
+// the materialized right input.
+typedef struct JoinState {
+    int equi;
+    CmpOp op;                   // Nested loop comparison (-1: cross product)
+    int built;
+    JoinInput inputs[MAX_CHILDREN];
+    int build;                  // Index of the build input (the other one probes)
+    int radix_bits;
+    int partitions;
+    long long *slot_keys;       // Open-addressing table for the current partition
+    int *slot_rows;             // Build row id per slot, -1 = empty
+    unsigned int slot_mask;
+    unsigned int slot_capacity;
+    int partition;              // Partition being joined
+    int partition_end;          // Partitions [partition, partition_end) are left to join
+    int table_ready;            // Its table has been built
+    int probe_pos;              // Position of the probe row within the probe input
+    int slot;                   // Slot to resume probing at (-1 = start a new probe row)
+    Batch *probe;               // Nested loop: left batch being probed ...
+    int match;                  // ... and next right row to test (-1 = start)
+    BloomFilter *bloom;         // Build keys, handed to the scan below the probe input
+} JoinState;
+
+// Groups of a γ: their key tuples and two accumulators per aggregate, stored
+// group by group in insertion order and found through an open-addressing
+// table of group ids
+typedef struct AggTable {
+    int key_count;
+    int value_count;            // Accumulators per group
+    int group_count, group_capacity;
+    long long *keys;            // keys[group * key_count + k]
+    long long *values;          // values[group * value_count + v]
+    int *slots;                 // Group id per slot, -1 = empty
+    unsigned int slot_mask;
+} AggTable;
+
+typedef struct Operator {
+    OpKind kind;
+    Node *node;
+    int clone;                              // A worker's copy: shares the template's IN set and join inputs
+    struct Operator *children[MAX_CHILDREN];
+    int width;                              // Output columns
+    Symbol tables[EXEC_MAX_COLUMNS];        // Output schema
+    Symbol columns[EXEC_MAX_COLUMNS];
+    Batch batch;                            // Output batch handed to the parent
+    long long *buffers;                     // Owned output storage (joins)
+    int *selection;                         // Owned selection vector (filters)
+    // Scan, with the Bloom filters of hash joins above it tested before any σ
+    ColumnTable *table;
+    int cursor, end;
+    int bloom_count;
+    const BloomFilter *blooms[EXEC_MAX_BLOOMS];
+    int bloom_columns[EXEC_MAX_BLOOMS];
+    Node *bloom_joins[EXEC_MAX_BLOOMS];     // ⨝ each filter came from
+    // Filter: a conjunction of column op constant terms, column op other_column,
+    // or column IN set. Stacked constant filters are folded into one operator.
+    // A semi-join is the IN filter with its set built from the right input.
+    int term_count;
+    int term_columns[EXEC_MAX_TERMS];
+    CmpOp term_ops[EXEC_MAX_TERMS];
+    long long term_values[EXEC_MAX_TERMS];
+    int filter_column, filter_other;
+    CmpOp filter_op;
+    ValueSet *in_set;
+    Node *fused[EXEC_MAX_TERMS];            // σ nodes folded into this one, top down
+    int fused_count;
+    // Project
+    int project_map[EXEC_MAX_COLUMNS];
+    // Join
+    JoinState *join;
+    // Aggregate: the keys come first in the output, then one column per aggregate.
+    // An aggregate whose input already holds partial results of it (a column
+    // named like the aggregate, or SUM and COUNT for an AVG) merges them.
+    int key_count;
+    int key_columns[EXEC_MAX_COLUMNS];
+    int agg_count;
+    AggFunc agg_funcs[EXEC_MAX_COLUMNS];
+    int agg_inputs[EXEC_MAX_COLUMNS];       // Input column, -1 for a COUNT of rows
+    int agg_counts[EXEC_MAX_COLUMNS];       // Merged AVG: input column of the partial counts
+    int agg_merge[EXEC_MAX_COLUMNS];
+    AggTable *groups;                       // Shared with the workers' copies, which emit it
+    // Measurements
+    long rows_out;
+    double elapsed_ms;
+    char error[160];                        // Why this operator or one below it cannot run, or ""
+} Operator;
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static unsigned int hash_value(long long value) {
+    unsigned long long h = (unsigned long long)value * 0x9E3779B97F4A7C15ULL;
+    return (unsigned int)(h >> 32);
+}
+
+static int find_column(const Operator *op, Symbol table, Symbol column) {
+    for (int c = 0; c < op->width; c++) {
+        if (op->columns[c] == column && (table == NO_SYMBOL || op->tables[c] == table)) return c;
+    }
+    return -1;
+}
+
+// Falls back to matching the column name alone, for aliases such as "e.name"
+static int resolve_column(const Operator *op, const ColumnRef *ref) {
+    int c = find_column(op, ref->table, ref->column);
+    return c >= 0 ? c : find_column(op, NO_SYMBOL, ref->column);
+}
+
+// "t.c" or "c"; an aggregate such as "COUNT(t.c)" names a single output column
+static ColumnRef column_ref(const char *name) {
+    ColumnRef ref = {NO_SYMBOL, NO_SYMBOL, NULL};
+    const char *dot = strchr(name, '.');
+    if (dot && !strchr(name, '(')) {
+        char table[256];
+        snprintf(table, sizeof(table), "%.*s", (int)(dot - name), name);
+        ref.table = lookup_symbol(table);
+        ref.column = lookup_symbol(dot + 1);
+    } else {
+        ref.column = lookup_symbol(name);
+    }
+    return ref;
+}
+
+// NULL is never added, so no value is IN a set because of a NULL
+static void value_set_add(ValueSet *set, long long value) {
+    if (value == COLFILE_NULL) return;
+    if ((set->count + 1) * 2 > set->capacity) {
+        ValueSet grown = {NULL, NULL, set->capacity ? set->capacity * 2 : 64, 0};
+        grown.values = (long long *)malloc(grown.capacity * sizeof(long long));
+        grown.used = (unsigned char *)calloc(grown.capacity, 1);
+        for (int i = 0; i < set->capacity; i++) {
+            if (set->used[i]) value_set_add(&grown, set->values[i]);
+        }
+        free(set->values);
+        free(set->used);
+        *set = grown;
+    }
+    unsigned int slot = hash_value(value) & (set->capacity - 1);
+    while (set->used[slot]) {
+        if (set->values[slot] == value) return;
+        slot = (slot + 1) & (set->capacity - 1);
+    }
+    set->used[slot] = 1;
+    set->values[slot] = value;
+    set->count++;
+}
+
+static int value_set_contains(const ValueSet *set, long long value) {
+    if (!set->capacity) return 0;
+    unsigned int slot = hash_value(value) & (set->capacity - 1);
+    while (set->used[slot]) {
+        if (set->values[slot] == value) return 1;
+        slot = (slot + 1) & (set->capacity - 1);
+    }
+    return 0;
+}
+
+static Operator* build_operator(Node *node);
+static Batch* operator_next(Operator *op);
+static void free_operator(Operator *op);
+
+// Runs an IN subquery to completion and keeps the distinct values of its first column
+static void set_error(Operator *op, const char *reason) {
+    snprintf(op->error, sizeof(op->error), "%s(%s): %s", op_symbol(op->kind),
+             op->node->arg1 ? op->node->arg1 : "", reason);
+}
+
+// Strings are stored as hash codes, which keep equality but not order
+static int string_at(const Operator *op, int c) {
+    ColumnTable *table = op->tables[c] != NO_SYMBOL ? exec_table(op->tables[c]) : NULL;
+    for (int i = 0; table && i < table->column_count; i++) {
+        if (table->column_ids[i] == op->columns[c]) return exec_string_column(table, i);
+    }
+    return 0;
+}
+
+// An error in the subquery's plan is passed on to parent
+static ValueSet* evaluate_subquery(Node *subquery, Operator *parent) {
+    ValueSet *set = (ValueSet *)calloc(1, sizeof(ValueSet));
+    Operator *op = build_operator(subquery);
+    if (!op) return set;
+    if (op->error[0]) {
+        memcpy(parent->error, op->error, sizeof(parent->error));
+        free_operator(op);
+        return set;
+    }
+    Batch *batch;
+    while (op->width > 0 && (batch = operator_next(op))) {
+        for (int i = 0; i < batch->selected; i++) {
+            int row = batch->selection ? batch->selection[i] : i;
+            value_set_add(set, batch->columns[0][row]);
+        }
+    }
+    free_operator(op);
+    return set;
+}
+
+static void copy_schema(Operator *to, const Operator *from, int offset) {
+    for (int c = 0; c < from->width && offset + c < EXEC_MAX_COLUMNS; c++) {
+        to->tables[offset + c] = from->tables[c];
+        to->columns[offset + c] = from->columns[c];
+    }
+}
+
+static void init_scan(Operator *op, Node *node) {
+    op->table = exec_table(node->table_id);
+    op->cursor = 0;
+    op->end = op->table ? op->table->row_count : 0;
+    op->width = op->table ? op->table->column_count : 0;
+    for (int c = 0; c < op->width && c < EXEC_MAX_COLUMNS; c++) {
+        op->tables[c] = node->table_id;
+        op->columns[c] = op->table->column_ids[c];
+    }
+    if (op->width > EXEC_MAX_COLUMNS) op->width = EXEC_MAX_COLUMNS;
+}
+
+static void init_filter(Operator *op, Node *node) {
+    Operator *input = op->children[0];
+    Predicate *pred = node->pred;
+    op->width = input->width;
+    copy_schema(op, input, 0);
+    op->selection = (int *)malloc(EXEC_BATCH_SIZE * sizeof(int));
+    op->filter_column = -1;
+    op->filter_other = -1;
+    if (!pred || pred->left.kind != OPERAND_COLUMN) {
+        set_error(op, "the predicate does not compare a column");
+        return;
+    }
+
+    int column = resolve_column(input, &pred->left.column);
+    if (column < 0) {
+        set_error(op, "the predicate's column is not in the input");
+        return;
+    }
+
+    int other = pred->right.kind == OPERAND_COLUMN ? resolve_column(input, &pred->right.column) : -1;
+    if ((pred->op == CMP_LT || pred->op == CMP_GT) &&
+        (string_at(input, column) || pred->right.kind == OPERAND_STRING || (other >= 0 && string_at(input, other)))) {
+        set_error(op, "strings only compare with =");
+        return;
+    }
+
+    switch (pred->right.kind) {
+        case OPERAND_INT:
+        case OPERAND_STRING:
+            op->term_columns[0] = column;
+            op->term_ops[0] = pred->op;
+            op->term_values[0] = pred->right.kind == OPERAND_INT ? pred->right.int_value : string_code(pred->right.str_value);
+            op->term_count = 1;
+            break;
+        case OPERAND_COLUMN:
+            if (other < 0) {
+                set_error(op, "the predicate's right column is not in the input");
+                break;
+            }
+            op->filter_column = column;
+            op->filter_other = other;
+            op->filter_op = pred->op;
+            break;
+        case OPERAND_SUBQUERY:
+            op->filter_column = column;
+            op->in_set = evaluate_subquery(pred->right.subquery, op);
+            break;
+    }
+}
+
+// A σ of constant terms directly above another one absorbs it, so the whole
+// conjunction is evaluated in one pass over each batch
+static void fuse_filters(Operator *op) {
+    Operator *child = op->children[0];
+    if (op->term_count == 0 || !child || child->kind != OP_SELECT || child->term_count == 0) return;
+    if (op->term_count + child->term_count > EXEC_MAX_TERMS ||
+        op->fused_count + 1 + child->fused_count > EXEC_MAX_TERMS) return;
+
+    // σ keeps its input's columns, so the child's term positions stay valid
+    for (int t = 0; t < child->term_count; t++) {
+        op->term_columns[op->term_count] = child->term_columns[t];
+        op->term_ops[op->term_count] = child->term_ops[t];
+        op->term_values[op->term_count] = child->term_values[t];
+        op->term_count++;
+    }
+    op->fused[op->fused_count++] = child->node;
+    for (int i = 0; i < child->fused_count; i++) op->fused[op->fused_count++] = child->fused[i];
+
+    op->children[0] = child->children[0];
+    child->children[0] = NULL;
+    free_operator(child);
+}
+
+// Splits a projection list ("t.a,b,COUNT(c)") and maps every item to its input
+// position; aggregates are columns of the γ below, named by their text
+static void init_project(Operator *op, Node *node) {
+    Operator *input = op->children[0];
+    op->width = 0;
+    if (!node->arg1) return;
+
+    char name[256];
+    for (const char *rest = node->arg1; (rest = next_list_item(rest, name, sizeof(name))); ) {
+        if (op->width == EXEC_MAX_COLUMNS) break;
+        ColumnRef ref = column_ref(name);
+        int c = ref.column != NO_SYMBOL ? resolve_column(input, &ref) : -1;
+        if (c >= 0) {
+            op->project_map[op->width] = c;
+            op->tables[op->width] = input->tables[c];
+            op->columns[op->width] = input->columns[c];
+            op->width++;
+        }
+    }
+}
+
+static void init_join(Operator *op, Node *node) {
+    Operator *left = op->children[0], *right = op->children[1];
+    JoinState *join = (JoinState *)calloc(1, sizeof(JoinState));
+    op->join = join;
+    join->op = (CmpOp)-1;
+    join->match = -1;
+    join->slot = -1;
+
+    op->width = left->width + right->width;
+    if (op->width > EXEC_MAX_COLUMNS) op->width = EXEC_MAX_COLUMNS;
+    copy_schema(op, left, 0);
+    copy_schema(op, right, left->width);
+    op->buffers = (long long *)malloc((op->width ? op->width : 1) * EXEC_BATCH_SIZE * sizeof(long long));
+    for (int c = 0; c < op->width; c++) op->batch.columns[c] = op->buffers + (size_t)c * EXEC_BATCH_SIZE;
+
+    Predicate *pred = node->pred;
+    if (!is_join_predicate(pred)) return;
+
+    // The predicate may name the inputs in either order. Exact table.column
+    // matches decide which; matching by name alone (for aliases) could pick a
+    // same-named column of the other table, so it is only tried after both.
+    const ColumnRef *a = &pred->left.column, *b = &pred->right.column;
+    int swapped = 0;
+    int l = find_column(left, a->table, a->column), r = find_column(right, b->table, b->column);
+    if (l < 0 || r < 0) {
+        l = find_column(left, b->table, b->column);
+        r = find_column(right, a->table, a->column);
+        swapped = 1;
+    }
+    if (l < 0 || r < 0) {
+        l = resolve_column(left, a);
+        r = resolve_column(right, b);
+        swapped = 0;
+    }
+    if (l < 0 || r < 0) {
+        l = resolve_column(left, b);
+        r = resolve_column(right, a);
+        swapped = 1;
+    }
+    if (l < 0 || r < 0) return;
+    CmpOp cmp = pred->op;
+    if (swapped) cmp = cmp == CMP_LT ? CMP_GT : (cmp == CMP_GT ? CMP_LT : cmp);
+    if ((cmp == CMP_LT || cmp == CMP_GT) && (string_at(left, l) || string_at(right, r))) {
+        set_error(op, "strings only compare with =");
+        return;
+    }
+
+    join->inputs[0].key = l;
+    join->inputs[1].key = r;
+    join->op = cmp;
+    join->equi = cmp == CMP_EQ;
+
+    // Build on the input with fewer estimated rows; ties keep the right input
+    join->build = estimate_cost(node->children[0]).result_size < estimate_cost(node->children[1]).result_size ? 0 : 1;
+}
+
+// ⋉ keeps the left rows whose key is among the distinct values of the first
+// column of its right input (the subquery plan), which is built before probing
+static void init_semijoin(Operator *op, Node *node) {
+    Operator *input = op->children[0];
+    Predicate *pred = node->pred;
+    op->width = input->width;
+    copy_schema(op, input, 0);
+    op->selection = (int *)malloc(EXEC_BATCH_SIZE * sizeof(int));
+    op->filter_column = -1;
+    op->filter_other = -1;
+    if (pred && pred->left.kind == OPERAND_COLUMN) op->filter_column = resolve_column(input, &pred->left.column);
+    if (op->filter_column < 0) set_error(op, "the predicate's column is not in the input");
+}
+
+// Output column of a partial aggregate in the input, e.g. "COUNT(t.c)"
+static int partial_column(const Operator *input, AggFunc func, const char *argument) {
+    char name[300];
+    snprintf(name, sizeof(name), "%s(%s)", agg_func_name(func), argument);
+    Symbol column = lookup_symbol(name);
+    return column != NO_SYMBOL ? find_column(input, NO_SYMBOL, column) : -1;
+}
+
+// γ: group keys, then aggregates, each resolved against the input. Columns the
+// input does not have are left out, as in a projection.
+static void init_aggregate(Operator *op, Node *node) {
+    Operator *input = op->children[0];
+    char item[256], argument[256];
+    op->width = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (const char *rest = node->arg1; (rest = next_list_item(rest, item, sizeof(item))); ) {
+            AggFunc func = parse_aggregate(item, argument, sizeof(argument));
+            if ((func == AGG_NONE) != (pass == 0) || op->width == EXEC_MAX_COLUMNS) continue;
+            if (func == AGG_NONE) {
+                ColumnRef ref = column_ref(item);
+                int c = ref.column != NO_SYMBOL ? resolve_column(input, &ref) : -1;
+                if (c < 0) continue;
+                op->key_columns[op->key_count++] = c;
+                op->tables[op->width] = input->tables[c];
+                op->columns[op->width++] = input->columns[c];
+                continue;
+            }
+
+            int a = op->agg_count;
+            int merged = partial_column(input, func, argument);
+            op->agg_counts[a] = -1;
+            op->agg_merge[a] = 0;
+            if (func == AGG_AVG) {
+                merged = partial_column(input, AGG_SUM, argument);
+                op->agg_counts[a] = partial_column(input, AGG_COUNT, argument);
+                if (op->agg_counts[a] < 0) merged = -1;
+            }
+            if (merged >= 0) {
+                op->agg_inputs[a] = merged;
+                op->agg_merge[a] = 1;
+            } else {
+                ColumnRef ref = column_ref(argument);
+                op->agg_inputs[a] = ref.column != NO_SYMBOL ? resolve_column(input, &ref) : -1;
+                if (op->agg_inputs[a] < 0 && func != AGG_COUNT) continue;
+            }
+            op->agg_funcs[a] = func;
+            op->agg_count++;
+            op->tables[op->width] = NO_SYMBOL;
+            op->columns[op->width++] = intern(item);
+        }
+    }
+    op->buffers = (long long *)malloc((op->width ? op->width : 1) * EXEC_BATCH_SIZE * sizeof(long long));
+    for (int c = 0; c < op->width; c++) op->batch.columns[c] = op->buffers + (size_t)c * EXEC_BATCH_SIZE;
+}
+
+static Operator* build_operator(Node *node) {
+    if (!node) return NULL;
+
+    Operator *op = (Operator *)calloc(1, sizeof(Operator));
+    op->kind = node->op;
+    op->node = node;
+    for (int i = 0; i < MAX_CHILDREN; i++) op->children[i] = build_operator(node->children[i]);
+
+    switch (node->op) {
+        case OP_TABLE:
+            init_scan(op, node);
+            break;
+        case OP_SELECT:
+            if (!op->children[0]) break;
+            init_filter(op, node);
+            fuse_filters(op);
+            break;
+        case OP_PROJECT:
+            if (!op->children[0]) break;
+            init_project(op, node);
+            break;
+        case OP_JOIN:
+            if (!op->children[0] || !op->children[1]) break;
+            init_join(op, node);
+            break;
+        case OP_SEMIJOIN:
+            if (!op->children[0] || !op->children[1]) break;
+            init_semijoin(op, node);
+            break;
+        case OP_AGGREGATE:
+            if (!op->children[0]) break;
+            init_aggregate(op, node);
+            break;
+    }
+    for (int i = 0; i < MAX_CHILDREN && !op->error[0]; i++) {
+        if (op->children[i] && op->children[i]->error[0]) memcpy(op->error, op->children[i]->error, sizeof(op->error));
+    }
+    return op;
+}
+
+static void free_operator(Operator *op) {
+    if (!op) return;
+    for (int i = 0; i < MAX_CHILDREN; i++) free_operator(op->children[i]);
+    if (op->in_set && !op->clone) {
+        free(op->in_set->values);
+        free(op->in_set->used);
+        free(op->in_set);
+    }
+    if (op->join) {
+        for (int i = 0; i < MAX_CHILDREN && !op->clone; i++) {
+            JoinInput *input = &op->join->inputs[i];
+            for (int c = 0; c < input->width; c++) free(input->rows[c]);
+            free(input->rows);
+            free(input->keys);
+            free(input->order);
+            free(input->offsets);
+        }
+        if (!op->clone) bloom_free(op->join->bloom);
+        free(op->join->slot_keys);
+        free(op->join->slot_rows);
+        free(op->join);
+    }
+    if (op->groups && !op->clone) {
+        free(op->groups->keys);
+        free(op->groups->values);
+        free(op->groups->slots);
+        free(op->groups);
+    }
+    free(op->buffers);
+    free(op->selection);
+    free(op);
+}
+
+static Batch* scan_next(Operator *op) {
+    while (op->cursor < op->end) {
+        int count = op->end - op->cursor;
+        if (count > EXEC_BATCH_SIZE) count = EXEC_BATCH_SIZE;
+
+        // Column vectors point into the table; nothing is copied
+        for (int c = 0; c < op->width; c++) op->batch.columns[c] = op->table->columns[c] + op->cursor;
+        op->batch.count = count;
+        op->batch.selection = NULL;
+        op->batch.selected = count;
+        op->cursor += count;
+        if (op->bloom_count == 0) return &op->batch;
+
+        int kept = count;
+        for (int b = 0; b < op->bloom_count && kept > 0; b++) {
+            kept = bloom_select(op->blooms[b], op->batch.columns[op->bloom_columns[b]], b ? op->selection : NULL,
+                                kept, op->selection);
+        }
+        if (kept == 0) continue;
+        op->batch.selection = op->selection;
+        op->batch.selected = kept;
+        return &op->batch;
+    }
+    return NULL;
+}
+
+// A comparison with NULL holds for no operator
+static int compare_values(long long left, CmpOp op, long long right) {
+    if (left == COLFILE_NULL || right == COLFILE_NULL) return 0;
+    switch (op) {
+        case CMP_EQ: return left == right;
+        case CMP_LT: return left < right;
+        case CMP_GT: return left > right;
+        case CMP_IN: return 0;
+    }
+    return 0;
+}
+
+static Batch* filter_next(Operator *op) {
+    Batch *input;
+    while ((input = operator_next(op->children[0]))) {
+        op->batch = *input;
+        int kept = 0;
+        if (op->term_count > 0) {
+            FilterTerm terms[EXEC_MAX_TERMS];
+            for (int t = 0; t < op->term_count; t++) {
+                terms[t].values = input->columns[op->term_columns[t]];
+                terms[t].op = op->term_ops[t];
+                terms[t].constant = op->term_values[t];
+            }
+            kept = input->selection
+                ? filter_conjunction_refine(terms, op->term_count, input->selection, input->selected, op->selection)
+                : filter_conjunction_select(terms, op->term_count, input->count, op->selection);
+        } else if (op->filter_column < 0) {
+            return &op->batch;
+        } else if (op->in_set) {
+            const long long *values = input->columns[op->filter_column];
+            for (int i = 0; i < input->selected; i++) {
+                int row = input->selection ? input->selection[i] : i;
+                op->selection[kept] = row;
+                kept += value_set_contains(op->in_set, values[row]);
+            }
+        } else {
+            const long long *values = input->columns[op->filter_column];
+            const long long *others = input->columns[op->filter_other];
+            for (int i = 0; i < input->selected; i++) {
+                int row = input->selection ? input->selection[i] : i;
+                op->selection[kept] = row;
+                kept += compare_values(values[row], op->filter_op, others[row]);
+            }
+        }
+
+        if (kept == 0) continue;
+        op->batch.selection = op->selection;
+        op->batch.selected = kept;
+        return &op->batch;
+    }
+    return NULL;
+}
+
+static Batch* project_next(Operator *op) {
+    Batch *input = operator_next(op->children[0]);
+    if (!input) return NULL;
+    op->batch.count = input->count;
+    op->batch.selection = input->selection;
+    op->batch.selected = input->selected;
+    for (int c = 0; c < op->width; c++) op->batch.columns[c] = input->columns[op->project_map[c]];
+    return &op->batch;
+}
+
+#define JOIN_PARTITION_ROWS 8192     // Build rows per partition: table and keys stay within L2
+#define JOIN_MAX_RADIX_BITS 12
+
+static long run_pipeline(Operator *top, JoinInput *sink, Operator *aggregate);
+
+static void init_input(JoinInput *input, int width) {
+    input->width = width;
+    input->row_count = 0;
+    input->row_capacity = EXEC_BATCH_SIZE;
+    input->rows = (long long **)malloc((width ? width : 1) * sizeof(long long *));
+    for (int c = 0; c < width; c++) input->rows[c] = (long long *)malloc(input->row_capacity * sizeof(long long));
+}
+
+static void append_batch(JoinInput *input, const Batch *batch) {
+    if (input->row_count + batch->selected > input->row_capacity) {
+        while (input->row_count + batch->selected > input->row_capacity) input->row_capacity *= 2;
+        for (int c = 0; c < input->width; c++) {
+            input->rows[c] = (long long *)realloc(input->rows[c], input->row_capacity * sizeof(long long));
+        }
+    }
+    for (int c = 0; c < input->width; c++) {
+        long long *to = input->rows[c] + input->row_count;
+        const long long *from = batch->columns[c];
+        for (int i = 0; i < batch->selected; i++) to[i] = from[batch->selection ? batch->selection[i] : i];
+    }
+    input->row_count += batch->selected;
+}
+
+static void materialize_input(Operator *child, JoinInput *input) {
+    init_input(input, child->width);
+    run_pipeline(child, input, NULL);
+}
+
+// Histogram of partition sizes, prefix sums, then one scatter pass. Rows with a
+// NULL key can match nothing and are left out.
+static void partition_input(JoinInput *input, int radix_bits) {
+    int partitions = 1 << radix_bits;
+    unsigned int mask = partitions - 1;
+    const long long *keys = input->rows[input->key];
+
+    input->offsets = (int *)calloc(partitions + 1, sizeof(int));
+    for (int i = 0; i < input->row_count; i++) {
+        if (keys[i] != COLFILE_NULL) input->offsets[(hash_value(keys[i]) & mask) + 1]++;
+    }
+    for (int p = 0; p < partitions; p++) input->offsets[p + 1] += input->offsets[p];
+
+    int *cursor = (int *)malloc(partitions * sizeof(int));
+    memcpy(cursor, input->offsets, partitions * sizeof(int));
+    input->keys = (long long *)malloc((input->row_count ? input->row_count : 1) * sizeof(long long));
+    input->order = (int *)malloc((input->row_count ? input->row_count : 1) * sizeof(int));
+    for (int i = 0; i < input->row_count; i++) {
+        if (keys[i] == COLFILE_NULL) continue;
+        int pos = cursor[hash_value(keys[i]) & mask]++;
+        input->keys[pos] = keys[i];
+        input->order[pos] = i;
+    }
+    free(cursor);
+}
+
+// Runs the subquery plan on every worker and hashes its distinct keys
+static void build_semijoin(Operator *op) {
+    ValueSet *set = (ValueSet *)calloc(1, sizeof(ValueSet));
+    Operator *subquery = op->children[1];
+    if (subquery->width > 0) {
+        JoinInput rows;
+        init_input(&rows, subquery->width);
+        run_pipeline(subquery, &rows, NULL);
+        for (int i = 0; i < rows.row_count; i++) value_set_add(set, rows.rows[0][i]);
+        for (int c = 0; c < rows.width; c++) free(rows.rows[c]);
+        free(rows.rows);
+    }
+    op->in_set = set;
+}
+
+// Follows a column of op's output down to the scan it is read from, through
+// operators that pass its values on unchanged; NULL when the column is
+// computed (an aggregate) or the scan's pipeline has already run
+static Operator* source_scan(Operator *op, int *column) {
+    while (op) {
+        switch (op->kind) {
+            case OP_TABLE:
+                return op;
+            case OP_SELECT:
+            case OP_SEMIJOIN:
+                op = op->children[0];
+                break;
+            case OP_PROJECT:
+                *column = op->project_map[*column];
+                op = op->children[0];
+                break;
+            case OP_JOIN:
+                if (!op->join || op->join->built || !op->children[0]) return NULL;
+                if (*column >= op->children[0]->width) {
+                    *column -= op->children[0]->width;
+                    op = op->children[1];
+                } else {
+                    op = op->children[0];
+                }
+                break;
+            case OP_AGGREGATE:
+                if (op->groups || *column >= op->key_count) return NULL;
+                *column = op->key_columns[*column];
+                op = op->children[0];
+                break;
+        }
+    }
+    return NULL;
+}
+
+// Sideways information passing: a Bloom filter of the build keys goes to the
+// scan the probe keys come from, before the probe input runs. Only inner joins
+// sit in between, so a row it drops could not have reached this join's output.
+static void push_bloom_filter(Operator *op) {
+    JoinState *join = op->join;
+    JoinInput *build = &join->inputs[join->build];
+    int probe = 1 - join->build;
+    int column = join->inputs[probe].key;
+    Operator *scan = source_scan(op->children[probe], &column);
+    if (!scan || scan->bloom_count == EXEC_MAX_BLOOMS) return;
+
+    join->bloom = bloom_create(build->row_count);
+    const long long *keys = build->rows[build->key];
+    for (int i = 0; i < build->row_count; i++) {
+        if (keys[i] != COLFILE_NULL) bloom_insert(join->bloom, keys[i]);
+    }
+    scan->blooms[scan->bloom_count] = join->bloom;
+    scan->bloom_columns[scan->bloom_count] = column;
+    scan->bloom_joins[scan->bloom_count] = op->node;
+    scan->bloom_count++;
+    if (!scan->selection) scan->selection = (int *)malloc(EXEC_BATCH_SIZE * sizeof(int));
+}
+
+static void build_join(Operator *op) {
+    JoinState *join = op->join;
+    join->built = 1;
+    if (!join->equi) {
+        materialize_input(op->children[1], &join->inputs[1]);
+        return;
+    }
+
+    // The build input runs first so that its filter can shrink the probe input
+    int probe = 1 - join->build;
+    materialize_input(op->children[join->build], &join->inputs[join->build]);
+    if (op->node->bloom_filter) push_bloom_filter(op);
+    materialize_input(op->children[probe], &join->inputs[probe]);
+
+    int build_rows = join->inputs[join->build].row_count;
+    while (join->radix_bits < JOIN_MAX_RADIX_BITS && (build_rows >> join->radix_bits) > JOIN_PARTITION_ROWS) {
+        join->radix_bits++;
+    }
+    join->partitions = 1 << join->radix_bits;
+    join->partition_end = join->partitions;
+    partition_input(&join->inputs[0], join->radix_bits);
+    partition_input(&join->inputs[1], join->radix_bits);
+
+    // One table sized for the largest build partition is reused by all of them
+    const int *offsets = join->inputs[join->build].offsets;
+    int largest = 0;
+    for (int p = 0; p < join->partitions; p++) {
+        if (offsets[p + 1] - offsets[p] > largest) largest = offsets[p + 1] - offsets[p];
+    }
+    unsigned int capacity = 16;
+    while (capacity < (unsigned int)largest * 2) capacity <<= 1;
+    join->slot_capacity = capacity;
+    join->slot_keys = (long long *)malloc(capacity * sizeof(long long));
+    join->slot_rows = (int *)malloc(capacity * sizeof(int));
+}
+
+// Table slots come from the hash bits above the ones that chose the partition
+static unsigned int join_slot(const JoinState *join, long long key) {
+    return (hash_value(key) >> join->radix_bits) & join->slot_mask;
+}
+
+static void build_partition_table(JoinState *join) {
+    const JoinInput *build = &join->inputs[join->build];
+    int begin = build->offsets[join->partition], end = build->offsets[join->partition + 1];
+
+    unsigned int capacity = 16;
+    while (capacity < (unsigned int)(end - begin) * 2) capacity <<= 1;
+    join->slot_mask = capacity - 1;
+    memset(join->slot_rows, -1, capacity * sizeof(int));
+
+    for (int pos = begin; pos < end; pos++) {
+        unsigned int slot = join_slot(join, build->keys[pos]);
+        while (join->slot_rows[slot] >= 0) slot = (slot + 1) & join->slot_mask;
+        join->slot_keys[slot] = build->keys[pos];
+        join->slot_rows[slot] = build->order[pos];
+    }
+}
+
+static void emit_join_row(Operator *op, int out, int left_row, int right_row) {
+    const JoinInput *left = &op->join->inputs[0], *right = &op->join->inputs[1];
+    int left_width = left->width < op->width ? left->width : op->width;
+    for (int c = 0; c < left_width; c++) op->batch.columns[c][out] = left->rows[c][left_row];
+    for (int c = left_width; c < op->width; c++) op->batch.columns[c][out] = right->rows[c - left_width][right_row];
+}
+
+// Joins the partition pairs in [partition, partition_end) and emits dense output batches. A probe row
+// with more matches than fit in one batch resumes at the slot where it stopped.
+static int hash_join_next(Operator *op) {
+    JoinState *join = op->join;
+    const JoinInput *probe = &join->inputs[1 - join->build];
+    int out = 0;
+
+    while (out < EXEC_BATCH_SIZE && join->partition < join->partition_end) {
+        if (!join->table_ready) {
+            build_partition_table(join);
+            join->table_ready = 1;
+            join->probe_pos = probe->offsets[join->partition];
+            join->slot = -1;
+        }
+        if (join->probe_pos >= probe->offsets[join->partition + 1]) {
+            join->partition++;
+            join->table_ready = 0;
+            continue;
+        }
+
+        long long key = probe->keys[join->probe_pos];
+        unsigned int slot = join->slot < 0 ? join_slot(join, key) : (unsigned int)join->slot;
+        while (join->slot_rows[slot] >= 0 && join->slot_keys[slot] != key) slot = (slot + 1) & join->slot_mask;
+        if (join->slot_rows[slot] < 0) {
+            join->probe_pos++;
+            join->slot = -1;
+            continue;
+        }
+
+        int probe_row = probe->order[join->probe_pos], build_row = join->slot_rows[slot];
+        if (join->build == 0) emit_join_row(op, out++, build_row, probe_row);
+        else emit_join_row(op, out++, probe_row, build_row);
+        join->slot = (slot + 1) & join->slot_mask;
+    }
+    return out;
+}
+
+// Streams left batches against the materialized right input
+static int nested_loop_join_next(Operator *op) {
+    JoinState *join = op->join;
+    Operator *left = op->children[0];
+    const JoinInput *right = &join->inputs[1];
+    int left_width = left->width < op->width ? left->width : op->width;
+    int out = 0;
+
+    while (out < EXEC_BATCH_SIZE) {
+        if (!join->probe || join->probe_pos >= join->probe->selected) {
+            join->probe = operator_next(left);
+            join->probe_pos = 0;
+            join->match = -1;
+            if (!join->probe) break;
+            continue;
+        }
+
+        Batch *probe = join->probe;
+        int row = probe->selection ? probe->selection[join->probe_pos] : join->probe_pos;
+        int candidate = join->match < 0 ? 0 : join->match;
+        if ((int)join->op >= 0) {
+            long long value = probe->columns[join->inputs[0].key][row];
+            const long long *keys = right->rows[right->key];
+            while (candidate < right->row_count && !compare_values(value, join->op, keys[candidate])) candidate++;
+        }
+        if (candidate >= right->row_count) {
+            join->probe_pos++;
+            join->match = -1;
+            continue;
+        }
+
+        for (int c = 0; c < left_width; c++) op->batch.columns[c][out] = probe->columns[c][row];
+        for (int c = left_width; c < op->width; c++) op->batch.columns[c][out] = right->rows[c - left_width][candidate];
+        out++;
+        join->match = candidate + 1;
+    }
+    return out;
+}
+
+static Batch* join_next(Operator *op) {
+    if (!op->join->built) build_join(op);
+    int out = op->join->equi ? hash_join_next(op) : nested_loop_join_next(op);
+    if (out == 0) return NULL;
+    op->batch.count = out;
+    op->batch.selection = NULL;
+    op->batch.selected = out;
+    return &op->batch;
+}
+
+static AggTable* new_agg_table(const Operator *op) {
+    AggTable *table = (AggTable *)calloc(1, sizeof(AggTable));
+    table->key_count = op->key_count;
+    table->value_count = 2 * op->agg_count;
+    return table;
+}
+
+static unsigned int hash_keys(const long long *keys, int count) {
+    unsigned long long h = 0;
+    for (int k = 0; k < count; k++) h = (h ^ (unsigned long long)keys[k]) * 0x9E3779B97F4A7C15ULL;
+    return (unsigned int)(h >> 32);
+}
+
+static void insert_slot(AggTable *table, int group) {
+    unsigned int slot = hash_keys(table->keys + (size_t)group * table->key_count, table->key_count) & table->slot_mask;
+    while (table->slots[slot] >= 0) slot = (slot + 1) & table->slot_mask;
+    table->slots[slot] = group;
+}
+
+// Group id of a key tuple, adding the group (with zeroed accumulators) if it is new
+static int find_group(AggTable *table, const long long *keys) {
+    int key_count = table->key_count;
+    if ((unsigned int)(table->group_count + 1) * 2 > (table->slots ? table->slot_mask + 1 : 0)) {
+        unsigned int capacity = table->slots ? (table->slot_mask + 1) * 2 : 64;
+        free(table->slots);
+        table->slots = (int *)malloc(capacity * sizeof(int));
+        memset(table->slots, 0xff, capacity * sizeof(int));
+        table->slot_mask = capacity - 1;
+        for (int g = 0; g < table->group_count; g++) insert_slot(table, g);
+    }
+
+    unsigned int slot = hash_keys(keys, key_count) & table->slot_mask;
+    while (table->slots[slot] >= 0) {
+        int group = table->slots[slot];
+        if (memcmp(table->keys + (size_t)group * key_count, keys, key_count * sizeof(long long)) == 0) return group;
+        slot = (slot + 1) & table->slot_mask;
+    }
+
+    if (table->group_count == table->group_capacity) {
+        table->group_capacity = table->group_capacity ? table->group_capacity * 2 : 64;
+        table->keys = (long long *)realloc(table->keys, (size_t)table->group_capacity * (key_count ? key_count : 1) * sizeof(long long));
+        table->values = (long long *)realloc(table->values, (size_t)table->group_capacity * (table->value_count ? table->value_count : 1) * sizeof(long long));
+    }
+    int group = table->group_count++;
+    memcpy(table->keys + (size_t)group * key_count, keys, key_count * sizeof(long long));
+    memset(table->values + (size_t)group * table->value_count, 0, table->value_count * sizeof(long long));
+    table->slots[slot] = group;
+    return group;
+}
+
+// Accumulators per aggregate: COUNT keeps [total, -], SUM and AVG [sum, values
+// seen], MAX and MIN [extreme, values seen]. Only non-NULL values get here.
+static void accumulate(AggFunc func, long long *pair, long long value, long long count) {
+    switch (func) {
+        case AGG_COUNT:
+            pair[0] += count;
+            break;
+        case AGG_SUM:
+            pair[0] += value;
+            pair[1] += count;
+            break;
+        case AGG_AVG:
+            pair[0] += value;
+            pair[1] += count;
+            break;
+        case AGG_MAX:
+            if (!pair[1] || value > pair[0]) pair[0] = value;
+            pair[1] += count;
+            break;
+        case AGG_MIN:
+            if (!pair[1] || value < pair[0]) pair[0] = value;
+            pair[1] += count;
+            break;
+        case AGG_NONE:
+            break;
+    }
+}
+
+// Folds a batch of γ's input into one worker's table
+static void aggregate_batch(const Operator *op, AggTable *table, const Batch *batch) {
+    long long keys[EXEC_MAX_COLUMNS];
+    for (int i = 0; i < batch->selected; i++) {
+        int row = batch->selection ? batch->selection[i] : i;
+        for (int k = 0; k < op->key_count; k++) keys[k] = batch->columns[op->key_columns[k]][row];
+        int group = find_group(table, keys);
+        long long *values = table->values + (size_t)group * table->value_count;
+        for (int a = 0; a < op->agg_count; a++) {
+            long long value = op->agg_inputs[a] >= 0 ? batch->columns[op->agg_inputs[a]][row] : 0;
+            // Aggregates skip NULLs, COUNT(*) has no input column and counts every row
+            if (value == COLFILE_NULL) continue;
+            // Merged partial counts add up; a partial MAX or MIN is one more value
+            long long count = 1;
+            if (op->agg_merge[a] && op->agg_funcs[a] == AGG_COUNT) count = value;
+            if (op->agg_merge[a] && op->agg_funcs[a] == AGG_AVG) count = batch->columns[op->agg_counts[a]][row];
+            accumulate(op->agg_funcs[a], values + 2 * a, value, count);
+        }
+    }
+}
+
+static void merge_agg_table(const Operator *op, AggTable *into, const AggTable *from) {
+    for (int g = 0; g < from->group_count; g++) {
+        int group = find_group(into, from->keys + (size_t)g * from->key_count);
+        long long *values = into->values + (size_t)group * into->value_count;
+        const long long *partial = from->values + (size_t)g * from->value_count;
+        for (int a = 0; a < op->agg_count; a++) {
+            const long long *pair = partial + 2 * a;
+            if (op->agg_funcs[a] == AGG_COUNT) {
+                accumulate(AGG_COUNT, values + 2 * a, 0, pair[0]);
+            } else if (pair[1]) {
+                accumulate(op->agg_funcs[a], values + 2 * a, pair[0], pair[1]);
+            }
+        }
+    }
+}
+
+// Runs the input pipeline with every worker aggregating into its own table,
+// then merges the tables. Without group keys there is always one group.
+static void build_aggregate(Operator *op) {
+    op->groups = new_agg_table(op);
+    if (op->children[0] && op->children[0]->width > 0) run_pipeline(op->children[0], NULL, op);
+    if (op->key_count == 0 && op->groups->group_count == 0) find_group(op->groups, NULL);
+    op->cursor = 0;
+    op->end = op->groups->group_count;
+}
+
+// Emits the groups in [cursor, end); an AVG is the integer quotient of its sum
+// and count. Aggregates other than COUNT are NULL over no values.
+static Batch* aggregate_next(Operator *op) {
+    if (op->cursor >= op->end) return NULL;
+    const AggTable *table = op->groups;
+    int count = op->end - op->cursor;
+    if (count > EXEC_BATCH_SIZE) count = EXEC_BATCH_SIZE;
+    for (int i = 0; i < count; i++) {
+        int group = op->cursor + i;
+        const long long *keys = table->keys + (size_t)group * table->key_count;
+        const long long *values = table->values + (size_t)group * table->value_count;
+        for (int k = 0; k < op->key_count; k++) op->batch.columns[k][i] = keys[k];
+        for (int a = 0; a < op->agg_count; a++) {
+            const long long *pair = values + 2 * a;
+            long long value = pair[0];
+            if (op->agg_funcs[a] != AGG_COUNT && !pair[1]) value = COLFILE_NULL;
+            else if (op->agg_funcs[a] == AGG_AVG) value = pair[0] / pair[1];
+            op->batch.columns[op->key_count + a][i] = value;
+        }
+    }
+    op->batch.count = count;
+    op->batch.selection = NULL;
+    op->batch.selected = count;
+    op->cursor += count;
+    return &op->batch;
+}
+
+static Batch* operator_next(Operator *op) {
+    double start = now_ms();
+    Batch *batch = NULL;
+    switch (op->kind) {
+        case OP_TABLE:
+            batch = scan_next(op);
+            break;
+        case OP_SELECT:
+            if (op->children[0]) batch = filter_next(op);
+            break;
+        case OP_PROJECT:
+            if (op->children[0]) batch = project_next(op);
+            break;
+        case OP_JOIN:
+            if (op->join) batch = join_next(op);
+            break;
+        case OP_SEMIJOIN:
+            // Workers' copies share the template's set and have no right input
+            if (!op->in_set && op->children[1]) build_semijoin(op);
+            if (op->in_set) batch = filter_next(op);
+            break;
+        case OP_AGGREGATE:
+            if (!op->groups) build_aggregate(op);
+            batch = aggregate_next(op);
+            break;
+    }
+    if (batch) op->rows_out += batch->selected;
+    op->elapsed_ms += now_ms() - start;
+    return batch;
+}
+
+// ---------------------------------------------------------------------------
+// Pipelines
+// ---------------------------------------------------------------------------
+
+// A pipeline is a chain of streaming operators (σ, π, ⋉ probe, nested loop probe) over a
+// source that splits into morsels: a scan (row ranges), a radix hash join
+// whose inputs are built (partitions) or a γ whose groups are built (group
+// ranges). Each worker runs its own copy of the chain on the morsels it takes;
+// the template tree keeps the shared state and collects the measurements. Join
+// inputs, semi-join subqueries and γ inputs are pipeline breakers: the
+// pipelines feeding them run to completion before the consumer's own pipeline
+// starts.
+
+#define EXEC_MORSEL_ROWS (16 * EXEC_BATCH_SIZE)
+
+static Operator* pipeline_source(Operator *op) {
+    while (op) {
+        switch (op->kind) {
+            case OP_TABLE:
+            case OP_AGGREGATE:
+                return op;
+            case OP_JOIN:
+                if (!op->join) return NULL;
+                if (op->join->equi) return op;
+                op = op->children[0];
+                break;
+            case OP_SELECT:
+            case OP_PROJECT:
+            case OP_SEMIJOIN:
+                op = op->children[0];
+                break;
+        }
+    }
+    return NULL;
+}
+
+// Builds every join input (and semi-join set, and γ) the pipeline reads from
+static void prepare_pipeline(Operator *op) {
+    while (op && op->kind != OP_TABLE) {
+        if (op->kind == OP_AGGREGATE) {
+            if (!op->groups) {
+                double start = now_ms();
+                build_aggregate(op);
+                op->elapsed_ms += now_ms() - start;
+            }
+            return;
+        }
+        if (op->kind == OP_SEMIJOIN && op->children[1] && !op->in_set) {
+            double start = now_ms();
+            build_semijoin(op);
+            op->elapsed_ms += now_ms() - start;
+        }
+        if (op->kind == OP_JOIN) {
+            if (!op->join) return;
+            if (!op->join->built) {
+                double start = now_ms();
+                build_join(op);
+                op->elapsed_ms += now_ms() - start;
+            }
+            if (op->join->equi) return;
+        }
+        op = op->children[0];
+    }
+}
+
+static int morsel_count(const Operator *source) {
+    if (!source) return 0;
+    if (source->kind == OP_TABLE || source->kind == OP_AGGREGATE) {
+        return (source->end - source->cursor + EXEC_MORSEL_ROWS - 1) / EXEC_MORSEL_ROWS;
+    }
+    return source->join->partitions;
+}
+
+// A worker's copy of the chain from op down to the pipeline source
+static Operator* clone_chain(const Operator *op) {
+    Operator *copy = (Operator *)malloc(sizeof(Operator));
+    *copy = *op;
+    copy->clone = 1;
+    copy->children[0] = copy->children[1] = NULL;
+    copy->buffers = NULL;
+    copy->selection = NULL;
+    copy->join = NULL;
+    copy->rows_out = 0;
+    copy->elapsed_ms = 0.0;
+
+    switch (op->kind) {
+        case OP_TABLE:
+            if (op->bloom_count) copy->selection = (int *)malloc(EXEC_BATCH_SIZE * sizeof(int));
+            break;
+        case OP_SELECT:
+        case OP_SEMIJOIN:
+            copy->selection = (int *)malloc(EXEC_BATCH_SIZE * sizeof(int));
+            copy->children[0] = clone_chain(op->children[0]);
+            break;
+        case OP_PROJECT:
+            copy->children[0] = clone_chain(op->children[0]);
+            break;
+        case OP_AGGREGATE:
+            copy->buffers = (long long *)malloc((op->width ? op->width : 1) * EXEC_BATCH_SIZE * sizeof(long long));
+            for (int c = 0; c < op->width; c++) copy->batch.columns[c] = copy->buffers + (size_t)c * EXEC_BATCH_SIZE;
+            break;
+        case OP_JOIN: {
+            JoinState *join = (JoinState *)malloc(sizeof(JoinState));
+            *join = *op->join;
+            copy->join = join;
+            copy->buffers = (long long *)malloc((op->width ? op->width : 1) * EXEC_BATCH_SIZE * sizeof(long long));
+            for (int c = 0; c < op->width; c++) copy->batch.columns[c] = copy->buffers + (size_t)c * EXEC_BATCH_SIZE;
+            if (join->equi) {
+                join->slot_keys = (long long *)malloc(join->slot_capacity * sizeof(long long));
+                join->slot_rows = (int *)malloc(join->slot_capacity * sizeof(int));
+            } else {
+                join->slot_keys = NULL;
+                join->slot_rows = NULL;
+                join->probe = NULL;
+                join->probe_pos = 0;
+                join->match = -1;
+                copy->children[0] = clone_chain(op->children[0]);
+            }
+            break;
+        }
+    }
+    return copy;
+}
+
+// Adds a worker's row counts and times to the template chain
+static void add_measurements(Operator *into, const Operator *from) {
+    for (; into && from; into = into->children[0], from = from->children[0]) {
+        into->rows_out += from->rows_out;
+        into->elapsed_ms += from->elapsed_ms;
+    }
+}
+
+typedef struct PipelineRun {
+    Operator *top;
+    Operator **chains;          // Per worker, cloned on its first morsel
+    JoinInput *parts;           // Per worker output when materializing
+    Operator *aggregate;        // γ consuming the output, if any ...
+    AggTable **tables;          // ... and the per worker partial aggregates
+    long *rows;                 // Per worker
+} PipelineRun;
+
+static void run_morsel(void *context, int worker, int morsel) {
+    PipelineRun *run = (PipelineRun *)context;
+    if (!run->chains[worker]) run->chains[worker] = clone_chain(run->top);
+    Operator *chain = run->chains[worker];
+    Operator *source = pipeline_source(chain);
+    const Operator *shared = pipeline_source(run->top);
+
+    if (source->kind == OP_TABLE || source->kind == OP_AGGREGATE) {
+        source->cursor = shared->cursor + morsel * EXEC_MORSEL_ROWS;
+        source->end = source->cursor + EXEC_MORSEL_ROWS < shared->end ? source->cursor + EXEC_MORSEL_ROWS : shared->end;
+    } else {
+        source->join->partition = morsel;
+        source->join->partition_end = morsel + 1;
+        source->join->table_ready = 0;
+    }
+
+    Batch *batch;
+    while ((batch = operator_next(chain))) {
+        run->rows[worker] += batch->selected;
+        if (run->parts) append_batch(&run->parts[worker], batch);
+        if (run->aggregate) {
+            if (!run->tables[worker]) run->tables[worker] = new_agg_table(run->aggregate);
+            aggregate_batch(run->aggregate, run->tables[worker], batch);
+        }
+    }
+}
+
+// Runs the pipeline producing top's output on every worker and returns its row
+// count; with a sink (initialized to top's width), the rows are collected
+// there, and with an aggregate they are folded into its groups
+static long run_pipeline(Operator *top, JoinInput *sink, Operator *aggregate) {
+    prepare_pipeline(top);
+    int morsels = morsel_count(pipeline_source(top));
+    int threads = scheduler_threads();
+
+    PipelineRun run;
+    run.top = top;
+    run.chains = (Operator **)calloc(threads, sizeof(Operator *));
+    run.rows = (long *)calloc(threads, sizeof(long));
+    run.parts = NULL;
+    run.aggregate = aggregate;
+    run.tables = aggregate ? (AggTable **)calloc(threads, sizeof(AggTable *)) : NULL;
+    if (sink) {
+        run.parts = (JoinInput *)calloc(threads, sizeof(JoinInput));
+        for (int w = 0; w < threads; w++) init_input(&run.parts[w], sink->width);
+    }
+
+    scheduler_run(morsels, run_morsel, &run);
+
+    long rows = 0;
+    for (int w = 0; w < threads; w++) {
+        rows += run.rows[w];
+        if (run.chains[w]) {
+            add_measurements(top, run.chains[w]);
+            free_operator(run.chains[w]);
+        }
+    }
+
+    if (aggregate) {
+        for (int w = 0; w < threads; w++) {
+            AggTable *table = run.tables[w];
+            if (!table) continue;
+            merge_agg_table(aggregate, aggregate->groups, table);
+            free(table->keys);
+            free(table->values);
+            free(table->slots);
+            free(table);
+        }
+        free(run.tables);
+    }
+
+    if (sink) {
+        // Concatenate the workers' parts; their order does not matter to joins
+        if (sink->row_capacity < rows) {
+            sink->row_capacity = rows > 0 ? (int)rows : 1;
+            for (int c = 0; c < sink->width; c++) {
+                sink->rows[c] = (long long *)realloc(sink->rows[c], sink->row_capacity * sizeof(long long));
+            }
+        }
+        for (int w = 0; w < threads; w++) {
+            JoinInput *part = &run.parts[w];
+            for (int c = 0; c < sink->width; c++) {
+                memcpy(sink->rows[c] + sink->row_count, part->rows[c], part->row_count * sizeof(long long));
+                free(part->rows[c]);
+            }
+            free(part->rows);
+            sink->row_count += part->row_count;
+        }
+        free(run.parts);
+    }
+    free(run.chains);
+    free(run.rows);
+    return rows;
+}
+
+static void print_operator_report(Operator *op, int depth) {
+    if (!op) return;
+    for (int i = 0; i < depth; i++) printf("  ");
+    CostMetrics estimate = estimate_cost(op->node);
+    printf("%s(%s) [est rows=%d, actual rows=%ld, time=%.3f ms]\n",
+           op_symbol(op->kind), op->node->arg1 ? op->node->arg1 : "",
+           estimate.result_size, op->rows_out, op->elapsed_ms);
+    for (int f = 0; f < op->fused_count; f++) {
+        for (int i = 0; i < depth + 1 + f; i++) printf("  ");
+        printf("%s(%s) [est rows=%d, fused into the σ above]\n", op_symbol(OP_SELECT),
+               op->fused[f]->arg1 ? op->fused[f]->arg1 : "", estimate_cost(op->fused[f]).result_size);
+    }
+    for (int b = 0; b < op->bloom_count; b++) {
+        for (int i = 0; i < depth + 1; i++) printf("  ");
+        printf("bloom(%s) [from the build input of %s(%s)]\n", symbol_name(op->columns[op->bloom_columns[b]]),
+               op_symbol(OP_JOIN), op->bloom_joins[b]->arg1 ? op->bloom_joins[b]->arg1 : "");
+    }
+    for (int i = 0; i < MAX_CHILDREN; i++) print_operator_report(op->children[i], depth + 1 + op->fused_count);
+}
+
+ExecResult execute_plan(Node *plan, int report) {
+    ExecResult result = {0, 0.0, 0};
+    if (!plan) return result;
+    if (stats_table_count() == 0) init_stats();
+
+    double traced = trace_begin();
+    double start = now_ms();
+    Operator *root_op = build_operator(plan);
+    if (root_op->error[0]) {
+        fprintf(stderr, "Cannot execute %s\n", root_op->error);
+        result.failed = 1;
+        free_operator(root_op);
+        trace_end(TRACE_EXECUTE, traced);
+        return result;
+    }
+    result.rows = run_pipeline(root_op, NULL, NULL);
+    result.elapsed_ms = now_ms() - start;
+    trace_end(TRACE_EXECUTE, traced);
+
+    if (report) {
+        if (scheduler_threads() > 1) {
+            printf("\nExecution on %d threads (estimated vs actual rows, inclusive time summed over threads):\n",
+                   scheduler_threads());
+        } else {
+            printf("\nExecution (estimated vs actual rows, inclusive time):\n");
+        }
+        print_operator_report(root_op, 0);
+        printf("Result: %ld rows in %.3f ms\n", result.rows, result.elapsed_ms);
+    }
+    free_operator(root_op);
+    return result;
+}
@@ -0,0 +1,58 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "parser.hpp"
+#include "colfile.hpp"
+
+#define EXEC_BATCH_SIZE 1024
+#define EXEC_MAX_COLUMNS 64
+#define EXEC_MAX_TERMS 8         // Constant comparisons one σ operator evaluates together
+#define EXEC_MAX_BLOOMS 4        // Join Bloom filters one scan tests
+
+// Columnar table. Every column is stored as int64; string columns hold
+// string_code() values.
+typedef struct ColumnTable {
+    Symbol table_id;
+    int row_count;
+    int column_count;
+    Symbol *column_ids;
+    long long **columns;        // columns[c][row]
+    ColumnFile *file;           // Mapping the columns point into, or NULL when synthesized
+} ColumnTable;
+
+// Up to EXEC_BATCH_SIZE rows flowing between operators. Column vectors may
+// point straight into table storage; the selection vector lists the rows
+// that are still active so filters never have to move data.
+typedef struct Batch {
+    int count;                  // Rows addressed by the column vectors
+    int *selection;             // Active row indexes, or NULL when all count rows are active
+    int selected;               // Number of active rows
+    long long *columns[EXEC_MAX_COLUMNS];
+} Batch;
+
+typedef struct ExecResult {
+    long rows;                  // Rows produced by the plan root
+    double elapsed_ms;
+    int failed;                 // The plan could not run; the reason went to stderr
+} ExecResult;
+
+// Runs a plan returned by optimize_query() over the tables exec_table()
+// provides. With report set, prints estimated next to
+// actual row counts and the time spent in every operator. A plan referring to
+// columns its inputs lack is not run.
+ExecResult execute_plan(Node *plan, int report);
+
+// Directory searched for <table>.col files; tables without one are synthesized
+void exec_set_data_dir(const char *dir);
+
+// Columnar table on first use: the mapped .col file from the data directory if
+// there is one, otherwise generated from the table's statistics (row count,
+// ranges, histograms, MCVs); NULL if unknown
+ColumnTable* exec_table(Symbol table_id);
+
+// Whether column c holds string_code() values: the file's column type, or for
+// a synthesized table min = max = 0 in the statistics
+int exec_string_column(const ColumnTable *table, int c);
+void exec_free_tables();
+
+#endif
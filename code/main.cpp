@@ -4,45 +4,21 @@
 #include "parser.hpp"
 #include "parser.tab.h"
 #include "optimizer.hpp"
+#include "arena.hpp"
+#include "stats.hpp"
+#include "plan_cache.hpp"
+#include "executor.hpp"
+#include "analyze.hpp"
+#include "scheduler.hpp"
+#include "server.hpp"
+#include "trace.hpp"
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
 
-extern void yy_scan_string(const char *str);
-
-Node *root = NULL;
-
-Node *new_node(char *op, char *arg1, char *arg2) {
-    Node *n =(Node*) malloc(sizeof(Node));
-    n->operation = op ? strdup(op) : NULL;
-    n->arg1 = arg1 ? strdup(arg1) : NULL;
-    n->arg2 = arg2 ? strdup(arg2) : NULL;
-    n->child = NULL;
-    n->next = NULL;
-    return n;
-}
-void print_tree(Node *node, int depth) {
-    if (!node) return;
-    
-    // Print indentation
-    for (int i = 0; i < depth; i++) printf("  ");
-    
-    // Print current node
-    if (node->arg1 && node->arg2)
-        printf("%s(%s AS %s)\n", node->operation, node->arg1, node->arg2);
-    else if (node->arg1)
-        printf("%s(%s)\n", node->operation, node->arg1);
-    else
-        printf("%s\n", node->operation);
-    
-    // Recursively print all children (assuming child is the left subtree)
-    if (node->child) {
-        print_tree(node->child, depth + 1);
-    }
-    
-    // Print siblings (assuming next is for additional children or nodes at the same level)
-    if (node->next) {
-        print_tree(node->next, depth + 1);  // Indent siblings as children
-    }
-}
-int main() {
+// Parse and optimize the first line of query.sql, printing every step
+static int run_single_query(int execute) {
     FILE *file = fopen("query.sql", "r");
     if (!file) {
         perror("Failed to open query.sql");
@@ -58,26 +34,307 @@ int main() {
             line[read - 1] = '\0';
         }
         printf("Parsing query: %s\n", line);
-        yy_scan_string(line);
     } else {
         printf("No query found in query.sql\n");
         free(line);
         fclose(file);
         return 1;
     }
-
-    free(line);
     fclose(file);
-    yyparse();
     
+    // AST, candidate plans and all their strings live until the query is done
+    Arena query_arena;
+    arena_init(&query_arena, ARENA_DEFAULT_BLOCK_SIZE);
+    set_node_arena(&query_arena);
+    
+    trace_query_begin(line);
+    ParseContext parse;
+    init_parse_context(&parse, &query_arena);
+    Node *root = parse_query(line, &parse);
+    free(line);
+    if (parse.error_line) fprintf(stderr, "Error at line %d: %s\n", parse.error_line, parse.error);
+    
+    int status = 0;
     if (root) {
         printf("\nOriginal Abstract Syntax Tree:\n");
         print_tree(root, 0);
         
         // Optimize the query
         root = optimize_query(root);
+        if (execute && execute_plan(root, 1).failed) status = 2;
     } else {
         printf("No AST generated.\n");
     }
-    return 0;
-}
\ No newline at end of file
+    trace_query_end();
+    
+    arena_destroy(&query_arena);
+    exec_free_tables();
+    free_stats();
+    return status;
+}
+
+// Read a whole file ("-" for stdin) into one NUL-terminated buffer
+static char* read_input(const char *path) {
+    FILE *file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return NULL;
+    }
+
+    size_t capacity = 64 * 1024, length = 0, got;
+    char *text = (char *)malloc(capacity);
+    while ((got = fread(text + length, 1, capacity - length - 1, file)) > 0) {
+        length += got;
+        if (capacity - length == 1) {
+            capacity *= 2;
+            text = (char *)realloc(text, capacity);
+        }
+    }
+    text[length] = '\0';
+    if (file != stdin) fclose(file);
+    return text;
+}
+
+// Find the end of the statement starting at `text`: the first ';' outside a
+// string literal. Returns a pointer just past it, or past the last character.
+static char* statement_end(char *text) {
+    char quote = 0;
+    for (char *p = text; *p; p++) {
+        if (quote) {
+            if (*p == quote || *p == '\n') quote = 0;
+        } else if (*p == '\'' || *p == '"') {
+            quote = *p;
+        } else if (*p == ';') {
+            return p + 1;
+        }
+    }
+    return text + strlen(text);
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of an already sorted sample
+static double percentile(const double *sorted, int count, double p) {
+    if (count == 0) return 0.0;
+    int rank = (int)ceil(p / 100.0 * count);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+// Latencies of one phase, one sample per query
+typedef struct LatencySamples {
+    double *values;
+    int count;
+    int capacity;
+} LatencySamples;
+
+static void record_sample(LatencySamples *samples, double ms) {
+    if (samples->count == samples->capacity) {
+        samples->capacity = samples->capacity ? samples->capacity * 2 : 1024;
+        samples->values = (double *)realloc(samples->values, samples->capacity * sizeof(double));
+    }
+    samples->values[samples->count++] = ms;
+}
+
+static void print_latency(const char *phase, LatencySamples *samples) {
+    int count = samples->count;
+    qsort(samples->values, count, sizeof(double), compare_doubles);
+    printf("%-9s | %-10.4f | %-10.4f | %-10.4f | %.4f\n", phase,
+           percentile(samples->values, count, 50), percentile(samples->values, count, 90),
+           percentile(samples->values, count, 99), count ? samples->values[count - 1] : 0.0);
+    free(samples->values);
+}
+
+typedef struct BatchOptions {
+    int verbose;            // Print every plan as in single query mode
+    int use_plan_cache;     // Reuse plans for statements that differ only in literals
+    int execute;            // Run each chosen plan on the in-memory tables
+} BatchOptions;
+
+// Parse and optimize every statement of a file with statistics loaded once and
+// one arena recycled between statements, then report throughput and latencies.
+// Statements that differ only in literals reuse plans from the plan cache.
+static int run_batch(const char *path, BatchOptions options) {
+    char *text = read_input(path);
+    if (!text) return 1;
+
+    optimizer_verbose = options.verbose;
+    init_stats();
+    if (options.use_plan_cache) plan_cache_init(PLAN_CACHE_DEFAULT_BUDGET);
+
+    Arena query_arena;
+    arena_init(&query_arena, ARENA_DEFAULT_BLOCK_SIZE);
+    set_node_arena(&query_arena);
+
+    int queries = 0, failed = 0, exec_failed = 0;
+    long rows = 0;
+    LatencySamples parse_ms = {NULL, 0, 0}, optimize_ms = {NULL, 0, 0};
+    LatencySamples execute_ms = {NULL, 0, 0}, total_ms = {NULL, 0, 0};
+
+    double batch_start = now_ms();
+    char *stmt = text;
+    while (*stmt) {
+        char *end = statement_end(stmt);
+        char saved = *end;
+        *end = '\0';
+
+        while (isspace((unsigned char)*stmt)) stmt++;
+        if (*stmt) {
+            if (options.verbose) printf("Parsing query: %s\n", stmt);
+
+            trace_query_begin(stmt);
+            double start = now_ms();
+            ParseContext parse;
+            init_parse_context(&parse, &query_arena);
+            Node *root = parse_query(stmt, &parse);
+            double parsed = now_ms();
+            if (parse.error_line) fprintf(stderr, "Error at line %d: %s\n", parse.error_line, parse.error);
+
+            if (root) {
+                if (options.verbose) {
+                    printf("\nOriginal Abstract Syntax Tree:\n");
+                    print_tree(root, 0);
+                }
+                Node *plan = options.use_plan_cache ? optimize_query_cached(root) : optimize_query(root);
+                double optimized = now_ms();
+                double executed = optimized;
+                if (options.execute) {
+                    ExecResult result = execute_plan(plan, options.verbose);
+                    rows += result.rows;
+                    exec_failed += result.failed;
+                    executed = now_ms();
+                    record_sample(&execute_ms, executed - optimized);
+                }
+
+                record_sample(&parse_ms, parsed - start);
+                record_sample(&optimize_ms, optimized - parsed);
+                record_sample(&total_ms, executed - start);
+                queries++;
+            } else {
+                failed++;
+            }
+            trace_query_end();
+            arena_reset(&query_arena);
+        }
+
+        *end = saved;
+        stmt = end;
+    }
+    double elapsed = now_ms() - batch_start;
+
+    printf("\nBatch Summary:\n");
+    printf("Queries optimized: %d (%d failed to parse)\n", queries, failed);
+    if (options.execute) printf("Rows produced: %ld\n", rows);
+    if (exec_failed) printf("Queries that failed to execute: %d\n", exec_failed);
+    printf("Elapsed: %.1f ms, throughput: %.1f queries/s\n",
+           elapsed, elapsed > 0 ? queries * 1000.0 / elapsed : 0.0);
+    printf("Phase     | p50 (ms)   | p90 (ms)   | p99 (ms)   | max (ms)\n");
+    printf("----------|------------|------------|------------|-----------\n");
+    print_latency("Parse", &parse_ms);
+    print_latency("Optimize", &optimize_ms);
+    if (options.execute) print_latency("Execute", &execute_ms);
+    print_latency("Total", &total_ms);
+    if (options.use_plan_cache) {
+        PlanCacheStats cache = plan_cache_stats();
+        printf("Plan cache: %ld hits, %ld misses, %ld evictions, %ld plans in %zu of %zu bytes\n",
+               cache.hits, cache.misses, cache.evictions, cache.entries, cache.bytes_used, cache.budget);
+        plan_cache_destroy();
+    }
+
+    arena_destroy(&query_arena);
+    exec_free_tables();
+    free_stats();
+    free(text);
+    return failed || exec_failed ? 2 : 0;
+}
+
+// ANALYZE every table file in data_dir and save the statistics for later runs
+static int run_analyze(const char *data_dir, int threads) {
+    if (!data_dir) {
+        fprintf(stderr, "--analyze needs --data <dir>\n");
+        return 1;
+    }
+    init_stats();
+    int analyzed = analyze_data_dir(data_dir, threads);
+    int saved = analyzed > 0 ? save_stats(stats_file()) : 0;
+    if (analyzed > 0 && saved >= 0) printf("Saved statistics for %d tables to %s\n", saved, stats_file());
+    exec_free_tables();
+    free_stats();
+    return analyzed > 0 && saved >= 0 ? 0 : 1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-x]\n", program);
+    fprintf(stderr, "              optimize the first query in query.sql\n");
+    fprintf(stderr, "       %s --batch <file|-> [-v] [-x] [--no-plan-cache]\n", program);
+    fprintf(stderr, "              optimize every statement of a file (or stdin)\n");
+    fprintf(stderr, "       -x, --execute   also run the chosen plan on in-memory tables\n");
+    fprintf(stderr, "       %s --serve <socket|-> [--threads <n>] [--no-plan-cache]\n", program);
+    fprintf(stderr, "              answer one SQL statement per line with its plan as JSON\n");
+    fprintf(stderr, "       %s --analyze --data <dir> [--threads <n>]\n", program);
+    fprintf(stderr, "              compute statistics for every <dir>/<table>.col and save them\n");
+    fprintf(stderr, "       --data <dir>    execute over <dir>/<table>.col files (see csv2col)\n");
+    fprintf(stderr, "       --stats <file>  statistics file to load and save (default %s)\n", STATS_DEFAULT_FILE);
+    fprintf(stderr, "       --threads <n>   worker threads for ANALYZE, execution and --serve (default: one per CPU)\n");
+    fprintf(stderr, "       --trace <file|-> [--trace-format json|chrome]\n");
+    fprintf(stderr, "                       write per-query phase timings and optimizer counters (- = stderr)\n");
+}
+
+int main(int argc, char **argv) {
+    const char *batch_path = NULL, *data_dir = NULL, *socket_path = NULL, *trace_path = NULL;
+    TraceFormat trace_format = TRACE_JSON;
+    BatchOptions options = {0, 1, 0};
+    int analyze = 0;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--batch") == 0 || strcmp(argv[i], "-b") == 0) && i + 1 < argc) {
+            batch_path = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+            options.verbose = 1;
+        } else if (strcmp(argv[i], "--no-plan-cache") == 0) {
+            options.use_plan_cache = 0;
+        } else if (strcmp(argv[i], "--execute") == 0 || strcmp(argv[i], "-x") == 0) {
+            options.execute = 1;
+        } else if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            data_dir = argv[++i];
+            exec_set_data_dir(data_dir);
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            set_stats_file(argv[++i]);
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--analyze") == 0) {
+            analyze = 1;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--trace-format") == 0 && i + 1 < argc &&
+                   (strcmp(argv[i + 1], "json") == 0 || strcmp(argv[i + 1], "chrome") == 0)) {
+            trace_format = strcmp(argv[++i], "chrome") == 0 ? TRACE_CHROME : TRACE_JSON;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (trace_path && trace_open(trace_path, trace_format) < 0) return 1;
+    scheduler_set_threads(threads);
+    int status;
+    if (analyze) status = run_analyze(data_dir, threads);
+    else if (socket_path) status = run_server(socket_path, threads, options.use_plan_cache);
+    else if (batch_path) status = run_batch(batch_path, options);
+    else status = run_single_query(options.execute);
+    scheduler_shutdown();
+    trace_close();
+    return status;
+}
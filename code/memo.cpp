@@ -0,0 +1,764 @@
+#include "memo.hpp"
+#include "optimizer.hpp"
+#include "stats.hpp"
+#include "arena.hpp"
+#include "trace.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+
+#define MEMO_MAX_RELATIONS 64
+#define MEMO_MAX_PREDICATES 64
+#define MEMO_COLUMN_WORDS 8                             // Column sets cover up to 512 columns
+#define MEMO_MAX_COLUMNS (MEMO_COLUMN_WORDS * 64)
+#define MEMO_HASH_BUCKETS 1024
+#define MEMO_NEW_ROOT -2                                // copy_in() target that creates the root group
+
+typedef unsigned long long Bits;
+
+typedef struct ColumnSet {
+    Bits words[MEMO_COLUMN_WORDS];
+} ColumnSet;
+
+typedef struct MemoExpr {
+    Node *node;                 // Operator and arguments; its children are ignored, except a ⋉'s subquery plan
+    int group;
+    int children[2];            // Input groups, -1 when absent
+    int relation;               // OP_TABLE: index into Memo.relations
+    int predicate;              // OP_SELECT / OP_JOIN / OP_SEMIJOIN: index into Memo.predicates
+    ColumnSet columns;          // OP_PROJECT: columns kept (or read by aggregates)
+    int known;                  // OP_PROJECT: every item was mapped to a column
+    int commuted;               // Join commutativity already applied
+    struct MemoExpr *matched[2]; // Last expression of each input group the rules have seen
+    struct MemoExpr *next;      // Next expression of the same group
+} MemoExpr;
+
+enum { GROUP_NEW, GROUP_SEARCHING, GROUP_DONE };
+
+typedef struct MemoGroup {
+    Bits relations;             // Base relations below
+    Bits predicates;            // Predicates applied below
+    ColumnSet columns;          // Columns produced
+    int root;                   // The query result; kept out of the hash so it is never shared
+    int narrowed;               // Some input was projected, so columns may be missing
+    int next_in_bucket;
+    MemoExpr *first;
+    MemoExpr *last;
+    int state;
+    int depth;                  // Position on the search path while GROUP_SEARCHING
+    Node *best;                 // Cheapest plan, once searched
+} MemoGroup;
+
+typedef struct MemoRelation {
+    Node *leaf;
+    Symbol table_id;
+    Symbol alias;
+    int first_column;           // Its columns in Memo.columns
+    int column_count;
+} MemoRelation;
+
+typedef struct MemoColumn {
+    int relation;
+    Symbol column;
+    const char *name;           // "table.column", as the executor resolves it
+} MemoColumn;
+
+typedef struct MemoPredicate {
+    Predicate *pred;
+    Bits relations;             // All ones when a reference cannot be placed
+    ColumnSet columns;
+    int columns_known;
+} MemoPredicate;
+
+typedef struct Memo {
+    MemoRules rules;
+    MemoStats *stats;
+    Arena *arena;
+    int relation_count;
+    MemoRelation relations[MEMO_MAX_RELATIONS];
+    int column_count;
+    MemoColumn columns[MEMO_MAX_COLUMNS];
+    int predicate_count;
+    MemoPredicate predicates[MEMO_MAX_PREDICATES];
+    int project_columns;        // Every relation has statistics, so projections can be narrowed
+    int ambiguous;              // Two leaves share table and alias; seeds cannot be mapped
+    MemoGroup *groups;
+    int group_count;
+    int group_capacity;
+    MemoExpr **exprs;           // Every expression in creation order
+    int expr_count;
+    int expr_capacity;
+    int buckets[MEMO_HASH_BUCKETS];
+} Memo;
+
+// ---------------------------------------------------------------------------
+// Column sets
+// ---------------------------------------------------------------------------
+
+static void set_add(ColumnSet *set, int column) {
+    set->words[column / 64] |= 1ULL << (column % 64);
+}
+
+static int set_has(const ColumnSet *set, int column) {
+    return (set->words[column / 64] >> (column % 64)) & 1;
+}
+
+static void set_union(ColumnSet *result, const ColumnSet *a, const ColumnSet *b) {
+    for (int w = 0; w < MEMO_COLUMN_WORDS; w++) result->words[w] = a->words[w] | b->words[w];
+}
+
+static void set_intersect(ColumnSet *result, const ColumnSet *a, const ColumnSet *b) {
+    for (int w = 0; w < MEMO_COLUMN_WORDS; w++) result->words[w] = a->words[w] & b->words[w];
+}
+
+static int set_equal(const ColumnSet *a, const ColumnSet *b) {
+    return memcmp(a->words, b->words, sizeof(a->words)) == 0;
+}
+
+static int set_subset(const ColumnSet *a, const ColumnSet *b) {
+    for (int w = 0; w < MEMO_COLUMN_WORDS; w++) {
+        if (a->words[w] & ~b->words[w]) return 0;
+    }
+    return 1;
+}
+
+static int set_empty(const ColumnSet *set) {
+    for (int w = 0; w < MEMO_COLUMN_WORDS; w++) {
+        if (set->words[w]) return 0;
+    }
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Relations, columns and predicates of the query
+// ---------------------------------------------------------------------------
+
+static int find_relation(Memo *memo, Symbol table) {
+    if (table == NO_SYMBOL) return -1;
+    for (int r = 0; r < memo->relation_count; r++) {
+        if (memo->relations[r].table_id == table || memo->relations[r].alias == table) return r;
+    }
+    return -1;
+}
+
+static int find_column(Memo *memo, int relation, Symbol column) {
+    MemoRelation *rel = &memo->relations[relation];
+    for (int c = rel->first_column; c < rel->first_column + rel->column_count; c++) {
+        if (memo->columns[c].column == column) return c;
+    }
+    return -1;
+}
+
+static int find_predicate(Memo *memo, const Predicate *pred) {
+    for (int p = 0; p < memo->predicate_count; p++) {
+        if (memo->predicates[p].pred == pred) return p;
+    }
+    return -1;
+}
+
+// Leaves by identity for the query itself, by table and alias for the seeds (which are copies)
+static int find_leaf(Memo *memo, Node *node) {
+    for (int r = 0; r < memo->relation_count; r++) {
+        if (memo->relations[r].leaf == node) return r;
+    }
+    if (memo->ambiguous) return -1;
+    Symbol alias = node->arg2 ? lookup_symbol(node->arg2) : NO_SYMBOL;
+    for (int r = 0; r < memo->relation_count; r++) {
+        if (memo->relations[r].table_id == node->table_id && memo->relations[r].alias == alias) return r;
+    }
+    return -1;
+}
+
+static void add_relation(Memo *memo, Node *leaf) {
+    MemoRelation *rel = &memo->relations[memo->relation_count];
+    rel->leaf = leaf;
+    rel->table_id = leaf->table_id;
+    rel->alias = leaf->arg2 ? intern(leaf->arg2) : NO_SYMBOL;
+    rel->first_column = memo->column_count;
+    rel->column_count = 0;
+    for (int r = 0; r < memo->relation_count; r++) {
+        if (memo->relations[r].table_id == rel->table_id && memo->relations[r].alias == rel->alias) memo->ambiguous = 1;
+    }
+    memo->relation_count++;
+
+    TableStats *stats = find_table_stats(leaf->table_id);
+    if (!stats || memo->column_count + stats->column_count > MEMO_MAX_COLUMNS) {
+        memo->project_columns = 0;
+        return;
+    }
+    for (int c = 0; c < stats->column_count; c++) {
+        MemoColumn *column = &memo->columns[memo->column_count++];
+        column->relation = memo->relation_count - 1;
+        column->column = stats->columns[c]->column_id;
+        column->name = stats->columns[c]->qualified_name;
+    }
+    rel->column_count = stats->column_count;
+}
+
+// Records the base relations and predicates of the plan; 0 if there are too many
+static int collect_inputs(Memo *memo, Node *node) {
+    if (!node) return 1;
+    if (node->op == OP_TABLE) {
+        if (memo->relation_count == MEMO_MAX_RELATIONS) return 0;
+        add_relation(memo, node);
+        return 1;
+    }
+    if ((node->op == OP_SELECT || node->op == OP_JOIN || node->op == OP_SEMIJOIN) && node->pred &&
+        find_predicate(memo, node->pred) < 0) {
+        if (memo->predicate_count == MEMO_MAX_PREDICATES) return 0;
+        memo->predicates[memo->predicate_count++].pred = node->pred;
+    }
+    // A ⋉ filters its left input; the subquery plan on its right is fixed
+    if (node->op == OP_SEMIJOIN) return collect_inputs(memo, node->children[0]);
+    return collect_inputs(memo, node->children[0]) && collect_inputs(memo, node->children[1]);
+}
+
+static void resolve_operand(Memo *memo, const Operand *operand, MemoPredicate *p) {
+    if (operand->kind != OPERAND_COLUMN) return;
+    int relation = find_relation(memo, operand->column.table);
+    if (relation < 0) {
+        p->relations = ~0ULL;
+        p->columns_known = 0;
+        return;
+    }
+    p->relations |= 1ULL << relation;
+    int column = find_column(memo, relation, operand->column.column);
+    if (column < 0) p->columns_known = 0;
+    else set_add(&p->columns, column);
+}
+
+static void resolve_predicates(Memo *memo) {
+    for (int i = 0; i < memo->predicate_count; i++) {
+        MemoPredicate *p = &memo->predicates[i];
+        p->columns_known = 1;
+        resolve_operand(memo, &p->pred->left, p);
+        resolve_operand(memo, &p->pred->right, p);
+    }
+}
+
+// Columns a projection list reads: "t.c", "c" (if only one relation has it),
+// or the argument of an aggregate such as "COUNT(t.c)". 0 if an item cannot be placed.
+static int map_projection(Memo *memo, const char *list, ColumnSet *columns) {
+    memset(columns, 0, sizeof(ColumnSet));
+    if (!list || !memo->project_columns) return 0;
+    const char *item = list;
+    while (*item) {
+        const char *end = strchr(item, ',');
+        size_t length = end ? (size_t)(end - item) : strlen(item);
+        char name[256];
+        if (length >= sizeof(name)) return 0;
+        memcpy(name, item, length);
+        name[length] = '\0';
+        item += length + (end ? 1 : 0);
+
+        char *start = name;
+        char *open = strchr(name, '(');
+        if (open) {
+            start = open + 1;
+            char *close = strchr(start, ')');
+            if (close) *close = '\0';
+        }
+        while (isspace(*start)) start++;
+        char *last = start + strlen(start);
+        while (last > start && isspace(last[-1])) *--last = '\0';
+        if (*start == '\0' || strcmp(start, "*") == 0) continue;
+
+        int column = -1;
+        char *dot = strchr(start, '.');
+        if (dot) {
+            *dot = '\0';
+            int relation = find_relation(memo, lookup_symbol(start));
+            Symbol id = lookup_symbol(dot + 1);
+            if (relation >= 0 && id != NO_SYMBOL) column = find_column(memo, relation, id);
+        } else {
+            Symbol id = lookup_symbol(start);
+            for (int r = 0; r < memo->relation_count && id != NO_SYMBOL; r++) {
+                int found = find_column(memo, r, id);
+                if (found < 0) continue;
+                if (column >= 0) return 0;
+                column = found;
+            }
+        }
+        if (column < 0) return 0;
+        set_add(columns, column);
+    }
+    return 1;
+}
+
+static void relation_columns(Memo *memo, int relation, ColumnSet *columns) {
+    memset(columns, 0, sizeof(ColumnSet));
+    MemoRelation *rel = &memo->relations[relation];
+    for (int c = rel->first_column; c < rel->first_column + rel->column_count; c++) set_add(columns, c);
+}
+
+// A π node keeping exactly the given columns
+static Node* projection_node(Memo *memo, const ColumnSet *columns) {
+    size_t length = 1;
+    for (int c = 0; c < memo->column_count; c++) {
+        if (set_has(columns, c)) length += strlen(memo->columns[c].name) + 1;
+    }
+    char *list = (char *)arena_alloc(memo->arena, length);
+    char *out = list;
+    for (int c = 0; c < memo->column_count; c++) {
+        if (!set_has(columns, c)) continue;
+        if (out != list) *out++ = ',';
+        size_t n = strlen(memo->columns[c].name);
+        memcpy(out, memo->columns[c].name, n);
+        out += n;
+    }
+    *out = '\0';
+    Node *node = new_node(OP_PROJECT, NULL, NULL);
+    node->arg1 = list;
+    return node;
+}
+
+// ---------------------------------------------------------------------------
+// Groups and expressions
+// ---------------------------------------------------------------------------
+
+static unsigned int group_hash(Bits relations, Bits predicates, const ColumnSet *columns) {
+    Bits h = relations * 0x9E3779B97F4A7C15ULL ^ predicates * 0xC2B2AE3D27D4EB4FULL;
+    for (int w = 0; w < MEMO_COLUMN_WORDS; w++) h = (h ^ columns->words[w]) * 0x100000001B3ULL;
+    return (unsigned int)(h >> 32) & (MEMO_HASH_BUCKETS - 1);
+}
+
+static int add_group(Memo *memo, Bits relations, Bits predicates, const ColumnSet *columns, int narrowed, int root) {
+    if (memo->group_count == memo->group_capacity) {
+        memo->group_capacity = memo->group_capacity ? memo->group_capacity * 2 : 64;
+        memo->groups = (MemoGroup *)realloc(memo->groups, memo->group_capacity * sizeof(MemoGroup));
+    }
+    int id = memo->group_count++;
+    MemoGroup *group = &memo->groups[id];
+    memset(group, 0, sizeof(MemoGroup));
+    group->relations = relations;
+    group->predicates = predicates;
+    group->columns = *columns;
+    group->narrowed = narrowed;
+    group->root = root;
+    group->next_in_bucket = -1;
+    if (!root) {
+        unsigned int bucket = group_hash(relations, predicates, columns);
+        group->next_in_bucket = memo->buckets[bucket];
+        memo->buckets[bucket] = id;
+    }
+    memo->stats->groups++;
+    TRACE_COUNT(TRACE_MEMO_GROUPS);
+    return id;
+}
+
+// The group for a logical result, created on first use
+static int find_group(Memo *memo, Bits relations, Bits predicates, const ColumnSet *columns, int narrowed) {
+    unsigned int bucket = group_hash(relations, predicates, columns);
+    for (int id = memo->buckets[bucket]; id >= 0; id = memo->groups[id].next_in_bucket) {
+        MemoGroup *group = &memo->groups[id];
+        if (group->relations == relations && group->predicates == predicates && set_equal(&group->columns, columns)) {
+            return id;
+        }
+    }
+    return add_group(memo, relations, predicates, columns, narrowed, 0);
+}
+
+// Adds an expression to a group unless the group already has it. A NULL π
+// node is built from the columns. Returns NULL for duplicates and once the
+// memo is full.
+static MemoExpr* add_expr(Memo *memo, int group, OpKind op, Node *node, int left, int right, int relation,
+                          int predicate, const ColumnSet *columns, int known) {
+    for (MemoExpr *e = memo->groups[group].first; e; e = e->next) {
+        if (e->node->op == op && e->children[0] == left && e->children[1] == right && e->relation == relation &&
+            e->predicate == predicate && (op != OP_PROJECT || set_equal(&e->columns, columns))) {
+            return NULL;
+        }
+    }
+    if (memo->expr_count >= MEMO_MAX_EXPRESSIONS) {
+        memo->stats->truncated = 1;
+        return NULL;
+    }
+
+    MemoExpr *e = (MemoExpr *)arena_alloc(memo->arena, sizeof(MemoExpr));
+    memset(e, 0, sizeof(MemoExpr));
+    e->node = node ? node : projection_node(memo, columns);
+    e->group = group;
+    e->children[0] = left;
+    e->children[1] = right;
+    e->relation = relation;
+    e->predicate = predicate;
+    if (columns) e->columns = *columns;
+    e->known = known;
+
+    MemoGroup *g = &memo->groups[group];
+    if (g->last) g->last->next = e;
+    else g->first = e;
+    g->last = e;
+
+    if (memo->expr_count == memo->expr_capacity) {
+        memo->expr_capacity = memo->expr_capacity ? memo->expr_capacity * 2 : 256;
+        memo->exprs = (MemoExpr **)realloc(memo->exprs, memo->expr_capacity * sizeof(MemoExpr *));
+    }
+    memo->exprs[memo->expr_count++] = e;
+    memo->stats->expressions++;
+    TRACE_COUNT(TRACE_MEMO_EXPRESSIONS);
+    return e;
+}
+
+// Adds a plan to the memo, each node as an expression of its group; returns the
+// group of node, or -1 if the plan has inputs the memo does not know
+static int copy_in(Memo *memo, Node *node, int target) {
+    int left = -1, right = -1;
+    if (node->children[0] && (left = copy_in(memo, node->children[0], -1)) < 0) return -1;
+    if (node->children[1] && node->op != OP_SEMIJOIN && (right = copy_in(memo, node->children[1], -1)) < 0) return -1;
+
+    Bits relations = 0, predicates = 0;
+    ColumnSet columns;
+    memset(&columns, 0, sizeof(columns));
+    int narrowed = 0, relation = -1, predicate = -1, known = 0;
+    if (left >= 0) {
+        MemoGroup *input = &memo->groups[left];
+        relations = input->relations;
+        predicates = input->predicates;
+        columns = input->columns;
+        narrowed = input->narrowed;
+    }
+    if (right >= 0) {
+        MemoGroup *input = &memo->groups[right];
+        relations |= input->relations;
+        predicates |= input->predicates;
+        set_union(&columns, &columns, &input->columns);
+        narrowed |= input->narrowed;
+    }
+
+    switch (node->op) {
+        case OP_TABLE:
+            relation = find_leaf(memo, node);
+            if (relation < 0) return -1;
+            relations = 1ULL << relation;
+            relation_columns(memo, relation, &columns);
+            break;
+        case OP_SELECT:
+        case OP_JOIN:
+        case OP_SEMIJOIN:
+            if (left < 0 || (node->op == OP_JOIN && right < 0) || !node->pred) return -1;
+            predicate = find_predicate(memo, node->pred);
+            if (predicate < 0) return -1;
+            predicates |= 1ULL << predicate;
+            break;
+        case OP_PROJECT: {
+            if (left < 0) return -1;
+            ColumnSet kept;
+            known = map_projection(memo, node->arg1, &kept);
+            if (target == -1) {
+                // Only the root π can keep items the memo cannot map
+                if (!known) return -1;
+                if (set_equal(&kept, &columns)) return left;
+                narrowed = 1;
+            }
+            if (known) columns = kept;
+            break;
+        }
+        case OP_AGGREGATE:
+            // Plans are searched below a γ, never across it
+            return -1;
+    }
+
+    int group = target;
+    if (target == MEMO_NEW_ROOT) group = add_group(memo, relations, predicates, &columns, narrowed, 1);
+    else if (target < 0) group = find_group(memo, relations, predicates, &columns, narrowed);
+    add_expr(memo, group, node->op, node, left, right, relation, predicate, &columns, known);
+    return group;
+}
+
+// ---------------------------------------------------------------------------
+// Rules
+// ---------------------------------------------------------------------------
+
+// The next expression of input k that e's rules have not been matched against
+static MemoExpr* next_unmatched(Memo *memo, MemoExpr *e, int k) {
+    MemoExpr *seen = e->matched[k];
+    MemoExpr *x = seen ? seen->next : memo->groups[e->children[k]].first;
+    if (x) e->matched[k] = x;
+    return x;
+}
+
+static int can_filter(Memo *memo, const MemoPredicate *p, int input) {
+    MemoGroup *group = &memo->groups[input];
+    if ((p->relations & ~group->relations) != 0) return 0;
+    return !group->narrowed || (p->columns_known && set_subset(&p->columns, &group->columns));
+}
+
+// The group σp(input) (or ⋉p), with that expression in it
+static int filter_group(Memo *memo, MemoExpr *selection, int input) {
+    // Copied out: find_group may add a group and move memo->groups
+    MemoGroup in = memo->groups[input];
+    int group = find_group(memo, in.relations, in.predicates | (1ULL << selection->predicate), &in.columns,
+                           in.narrowed);
+    add_expr(memo, group, selection->node->op, selection->node, input, -1, -1, selection->predicate, NULL, 0);
+    return group;
+}
+
+// The group πc(input) for c = columns ∩ input's columns, or input itself when that keeps everything (or nothing)
+static int narrow_group(Memo *memo, int input, const ColumnSet *columns) {
+    MemoGroup in = memo->groups[input];
+    ColumnSet kept;
+    set_intersect(&kept, columns, &in.columns);
+    if (set_empty(&kept) || set_equal(&kept, &in.columns)) return input;
+    int group = find_group(memo, in.relations, in.predicates, &kept, 1);
+    add_expr(memo, group, OP_PROJECT, NULL, input, -1, -1, -1, &kept, 1);
+    return group;
+}
+
+static void count_rewrite(MemoExpr *added, int *counter, TraceCounter trace) {
+    if (!added) return;
+    (*counter)++;
+    TRACE_COUNT(trace);
+}
+
+// σp (or ⋉p) over x: pushed into the join input holding p's relations, or swapped with a σ, ⋉ or π below
+static void selection_rules(Memo *memo, MemoExpr *e, MemoExpr *x) {
+    MemoPredicate *p = &memo->predicates[e->predicate];
+    MemoExpr *added = NULL;
+    switch (x->node->op) {
+        case OP_JOIN:
+            for (int k = 0; k < 2 && !added; k++) {
+                if (!can_filter(memo, p, x->children[k])) continue;
+                int filtered = filter_group(memo, e, x->children[k]);
+                added = add_expr(memo, e->group, OP_JOIN, x->node, k == 0 ? filtered : x->children[0],
+                                 k == 1 ? filtered : x->children[1], -1, x->predicate, NULL, 0);
+            }
+            break;
+        case OP_SELECT:
+        case OP_SEMIJOIN: {
+            int filtered = filter_group(memo, e, x->children[0]);
+            added = add_expr(memo, e->group, x->node->op, x->node, filtered, -1, -1, x->predicate, NULL, 0);
+            break;
+        }
+        case OP_PROJECT: {
+            int filtered = filter_group(memo, e, x->children[0]);
+            added = add_expr(memo, e->group, OP_PROJECT, x->node, filtered, -1, -1, -1, &x->columns, x->known);
+            break;
+        }
+        case OP_TABLE:
+        case OP_AGGREGATE:
+            break;
+    }
+    count_rewrite(added, &memo->stats->selection_rewrites, TRACE_SELECTIONS_PUSHED);
+}
+
+// πc over x: narrows the inputs of a σ, ⋉ or ⨝ below to c plus the predicate's
+// columns, or merges with a π below
+static void projection_rules(Memo *memo, MemoExpr *e, MemoExpr *x) {
+    MemoExpr *added = NULL;
+    switch (x->node->op) {
+        case OP_SELECT:
+        case OP_SEMIJOIN:
+        case OP_JOIN: {
+            MemoPredicate *p = &memo->predicates[x->predicate];
+            if (!p->columns_known) break;
+            ColumnSet needed;
+            set_union(&needed, &e->columns, &p->columns);
+            int left = narrow_group(memo, x->children[0], &needed);
+            int right = x->children[1] >= 0 ? narrow_group(memo, x->children[1], &needed) : -1;
+            if (left == x->children[0] && right == x->children[1]) break;
+
+            Bits relations = memo->groups[left].relations;
+            Bits predicates = memo->groups[left].predicates | (1ULL << x->predicate);
+            ColumnSet columns = memo->groups[left].columns;
+            if (right >= 0) {
+                relations |= memo->groups[right].relations;
+                predicates |= memo->groups[right].predicates;
+                set_union(&columns, &columns, &memo->groups[right].columns);
+            }
+            int below = find_group(memo, relations, predicates, &columns, 1);
+            add_expr(memo, below, x->node->op, x->node, left, right, -1, x->predicate, NULL, 0);
+            if (below != e->group) {
+                added = add_expr(memo, e->group, OP_PROJECT, e->node, below, -1, -1, -1, &e->columns, e->known);
+            }
+            break;
+        }
+        case OP_PROJECT:
+            if (x->children[0] != e->group) {
+                added = add_expr(memo, e->group, OP_PROJECT, e->node, x->children[0], -1, -1, -1, &e->columns,
+                                 e->known);
+            }
+            break;
+        case OP_TABLE:
+        case OP_AGGREGATE:
+            break;
+    }
+    count_rewrite(added, &memo->stats->projection_rewrites, TRACE_PROJECTIONS_PUSHED);
+}
+
+// ⨝p(x, B) with x = ⨝q(X, Y) → ⨝q(X, ⨝p(Y, B)) when p only needs Y and B
+static void join_rules(Memo *memo, MemoExpr *e, MemoExpr *x) {
+    if (x->node->op != OP_JOIN) return;
+    MemoPredicate *p = &memo->predicates[e->predicate];
+    MemoGroup y = memo->groups[x->children[1]];
+    MemoGroup b = memo->groups[e->children[1]];
+    if ((p->relations & ~(y.relations | b.relations)) != 0) return;
+
+    ColumnSet columns;
+    set_union(&columns, &y.columns, &b.columns);
+    int inner = find_group(memo, y.relations | b.relations, y.predicates | b.predicates | (1ULL << e->predicate),
+                           &columns, y.narrowed | b.narrowed);
+    add_expr(memo, inner, OP_JOIN, e->node, x->children[1], e->children[1], -1, e->predicate, NULL, 0);
+    MemoExpr *added = add_expr(memo, e->group, OP_JOIN, x->node, x->children[0], inner, -1, x->predicate, NULL, 0);
+    count_rewrite(added, &memo->stats->join_rewrites, TRACE_JOIN_REWRITES);
+}
+
+// Matches e's rules against the input expressions it has not seen yet; 0 if there were none
+static int apply_rules(Memo *memo, MemoExpr *e) {
+    int progress = 0;
+    MemoExpr *x;
+    switch (e->node->op) {
+        case OP_SELECT:
+        case OP_SEMIJOIN:
+            if (!memo->rules.selection_pushdown) break;
+            while ((x = next_unmatched(memo, e, 0))) {
+                selection_rules(memo, e, x);
+                progress = 1;
+            }
+            break;
+        case OP_PROJECT:
+            if (!memo->rules.projection_pushdown || !memo->project_columns || !e->known) break;
+            while ((x = next_unmatched(memo, e, 0))) {
+                projection_rules(memo, e, x);
+                progress = 1;
+            }
+            break;
+        case OP_JOIN:
+            if (!memo->rules.join_reordering || memo->relation_count > MEMO_MAX_JOIN_RELATIONS) break;
+            if (!e->commuted) {
+                e->commuted = 1;
+                progress = 1;
+                MemoExpr *added = add_expr(memo, e->group, OP_JOIN, e->node, e->children[1], e->children[0], -1,
+                                           e->predicate, NULL, 0);
+                count_rewrite(added, &memo->stats->join_rewrites, TRACE_JOIN_REWRITES);
+            }
+            while ((x = next_unmatched(memo, e, 0))) {
+                join_rules(memo, e, x);
+                progress = 1;
+            }
+            break;
+        case OP_TABLE:
+        case OP_AGGREGATE:
+            break;
+    }
+    return progress;
+}
+
+// Applies rules until no expression has unseen inputs (or the memo is full)
+static void explore(Memo *memo) {
+    int progress = 1;
+    while (progress && !memo->stats->truncated) {
+        progress = 0;
+        for (int i = 0; i < memo->expr_count; i++) {
+            if (apply_rules(memo, memo->exprs[i])) progress = 1;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Search
+// ---------------------------------------------------------------------------
+
+// Cheapest plan for a group, built from the cheapest plans of its inputs.
+// Every operator costs at least its inputs (π at least 0.9 of its input), so an
+// expression whose inputs already cost as much as the best plan is skipped.
+// An input still being searched closes a cycle and is skipped too. *reached
+// gets the shallowest depth such a cycle went back to; a group that skipped
+// one of its ancestors has only a partial answer, so it is not marked done and
+// is searched again when reached outside that cycle.
+static Node* best_plan(Memo *memo, int id, int depth, int *reached) {
+    MemoGroup *group = &memo->groups[id];
+    if (group->state == GROUP_DONE) return group->best;
+    if (group->state == GROUP_SEARCHING) {
+        if (group->depth < *reached) *reached = group->depth;
+        return NULL;
+    }
+    group->state = GROUP_SEARCHING;
+    group->depth = depth;
+    int cycle = INT_MAX;
+
+    Node *best = NULL;
+    double best_cost = 0.0;
+    for (MemoExpr *e = group->first; e; e = e->next) {
+        Node *inputs[2] = {NULL, NULL};
+        double bound = 0.0;
+        int usable = 1;
+        for (int k = 0; k < 2 && usable; k++) {
+            if (e->children[k] < 0) continue;
+            inputs[k] = best_plan(memo, e->children[k], depth + 1, &cycle);
+            if (!inputs[k]) usable = 0;
+        }
+        if (!usable) continue;
+        if (e->node->op == OP_SEMIJOIN) inputs[1] = e->node->children[1];
+        // πc(πd(Y)) reads the same as πc(Y)
+        if (e->node->op == OP_PROJECT && inputs[0]->op == OP_PROJECT) inputs[0] = inputs[0]->children[0];
+        for (int k = 0; k < 2; k++) {
+            if (inputs[k]) bound += inputs[k]->total_cost;
+        }
+        if (e->node->op == OP_PROJECT) bound *= 0.9;
+        if (best && bound >= best_cost) {
+            memo->stats->pruned++;
+            TRACE_COUNT(TRACE_PLANS_PRUNED);
+            continue;
+        }
+
+        Node *plan = (Node *)arena_alloc(memo->arena, sizeof(Node));
+        *plan = *e->node;
+        plan->children[0] = inputs[0];
+        plan->children[1] = inputs[1];
+        plan->cost_valid = 0;
+        double cost = calculate_total_plan_cost(plan);
+        memo->stats->costed++;
+        TRACE_COUNT(TRACE_PLANS_CONSIDERED);
+        if (!best || cost < best_cost) {
+            best = plan;
+            best_cost = cost;
+        }
+    }
+
+    group = &memo->groups[id];
+    if (cycle < depth) {
+        group->state = GROUP_NEW;
+        if (cycle < *reached) *reached = cycle;
+        return best;
+    }
+    group->best = best;
+    group->state = GROUP_DONE;
+    return best;
+}
+
+Node* memo_optimize(Node *root, Node **seeds, int seed_count, MemoRules rules, MemoStats *stats) {
+    memset(stats, 0, sizeof(MemoStats));
+    if (!root) return NULL;
+
+    Memo *memo = (Memo *)calloc(1, sizeof(Memo));
+    memo->rules = rules;
+    memo->stats = stats;
+    memo->arena = get_node_arena();
+    memo->project_columns = 1;
+    for (int b = 0; b < MEMO_HASH_BUCKETS; b++) memo->buckets[b] = -1;
+
+    Node *best = NULL;
+    if (collect_inputs(memo, root)) {
+        resolve_predicates(memo);
+        int group = copy_in(memo, root, MEMO_NEW_ROOT);
+        if (group >= 0) {
+            for (int s = 0; s < seed_count; s++) {
+                if (seeds[s]) copy_in(memo, seeds[s], group);
+            }
+            double traced = trace_begin();
+            explore(memo);
+            trace_end(TRACE_EXPLORE, traced);
+            traced = trace_begin();
+            int reached = INT_MAX;
+            best = best_plan(memo, group, 0, &reached);
+            trace_end(TRACE_SEARCH, traced);
+        }
+    }
+
+    free(memo->groups);
+    free(memo->exprs);
+    free(memo);
+    return best;
+}
@@ -0,0 +1,49 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include "parser.hpp"
+
+// Cost-based plan search over a memo of equivalence groups. A group holds
+// every expression found for one logical result: the same base relations with
+// the same predicates applied, producing the same columns. Rewrites are
+// transformation rules that add expressions to groups:
+//
+//   σ pushdown      σp(A ⨝ B) → σp(A) ⨝ B, and σ past σ and π
+//   π pushdown      πc(A ⨝ B) → πc(πc'(A) ⨝ πc''(B)), πc(σp(A)) → πc(σp(πc'(A))), πc(πd(A)) → πc(A)
+//   join rules      A ⨝ B → B ⨝ A, (A ⨝ B) ⨝ C → A ⨝ (B ⨝ C)
+//
+// so any combination of them can be chosen. A ⋉ from an unnested IN subquery
+// moves like a σ over its left input, keeping its subquery plan as it is.
+// Each group is costed once with estimate_cost()/calculate_total_plan_cost(),
+// keeping its cheapest expression; an expression is dropped as soon as its
+// inputs alone cost more than the best one found so far.
+
+typedef struct MemoRules {
+    int selection_pushdown;
+    int projection_pushdown;
+    int join_reordering;
+} MemoRules;
+
+typedef struct MemoStats {
+    int groups;
+    int expressions;
+    int costed;                 // Expressions whose cost was computed
+    int pruned;                 // Expressions dropped by their inputs' cost
+    int selection_rewrites;
+    int projection_rewrites;
+    int join_rewrites;
+    int truncated;              // Exploration stopped at MEMO_MAX_EXPRESSIONS
+} MemoStats;
+
+// Join rules only run for queries of at most this many relations; larger join
+// orders come from the seeds
+#define MEMO_MAX_JOIN_RELATIONS 8
+#define MEMO_MAX_EXPRESSIONS 4096
+
+// Returns the cheapest plan for the bound query root, built in the current node
+// arena. Seeds are equivalent plans (e.g. from reorder_joins()) added to the
+// memo before exploring. Returns NULL when the query exceeds the memo's limits
+// (64 relations, 64 predicates).
+Node* memo_optimize(Node *root, Node **seeds, int seed_count, MemoRules rules, MemoStats *stats);
+
+#endif
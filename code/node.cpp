@@ -0,0 +1,50 @@
+#include "parser.hpp"
+#include "arena.hpp"
+#include <stdio.h>
+
+Node *new_node(OpKind op, char *arg1, char *arg2) {
+    Arena *arena = get_node_arena();
+    Node *n = (Node*) arena_alloc(arena, sizeof(Node));
+    n->op = op;
+    n->arg1 = arena_strdup(arena, arg1);
+    n->arg2 = arena_strdup(arena, arg2);
+    n->table_id = (op == OP_TABLE) ? intern(arg1) : NO_SYMBOL;
+    n->pred = NULL;
+    n->bloom_filter = 0;
+    n->children[0] = NULL;
+    n->children[1] = NULL;
+    n->cost_valid = 0;
+    return n;
+}
+
+const char *op_symbol(OpKind op) {
+    switch (op) {
+        case OP_PROJECT: return "π";
+        case OP_SELECT:  return "σ";
+        case OP_JOIN:    return "⨝";
+        case OP_TABLE:   return "table";
+        case OP_SEMIJOIN: return "⋉";
+        case OP_AGGREGATE: return "γ";
+    }
+    return "?";
+}
+
+void print_tree(Node *node, int depth) {
+    if (!node) return;
+    
+    // Print indentation
+    for (int i = 0; i < depth; i++) printf("  ");
+    
+    // Print current node
+    if (node->arg1 && node->arg2)
+        printf("%s(%s AS %s)\n", op_symbol(node->op), node->arg1, node->arg2);
+    else if (node->arg1)
+        printf("%s(%s)\n", op_symbol(node->op), node->arg1);
+    else
+        printf("%s\n", op_symbol(node->op));
+    
+    // Recursively print all children (a join's right input follows its left input)
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        print_tree(node->children[i], depth + 1);
+    }
+}
@@ -0,0 +1,6 @@
+SELECT staff.id FROM staff WHERE staff.salary < 150;
+SELECT staff.id FROM staff WHERE staff.salary > 0;
+SELECT staff.id FROM staff JOIN teams ON staff.team = teams.team;
+SELECT staff.id FROM staff WHERE staff.team IN (SELECT teams.team FROM teams WHERE teams.budget < 2000);
+SELECT staff.id FROM staff JOIN teams ON staff.salary < teams.budget;
+SELECT staff.id FROM staff WHERE staff.name = 'bob';
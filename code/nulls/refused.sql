@@ -0,0 +1,3 @@
+SELECT staff.id FROM staff WHERE staff.name < 'bob';
+SELECT staff.id FROM staff WHERE staff.name > 5;
+SELECT staff.id FROM staff JOIN teams ON staff.name < teams.team;
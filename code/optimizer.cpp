@@ -1,35 +1,38 @@
 #include "optimizer.hpp"
 #include "stats.hpp"
+#include "arena.hpp"
+#include "trace.hpp"
+#include "memo.hpp"
+#include "aggregate.hpp"
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 
 // Flag to enable/disable optimizations
 int enable_selection_pushdown = 1;
 int enable_projection_pushdown = 1;
+int enable_join_reordering = 1;
+int enable_eager_aggregation = 1;
+int enable_bloom_filters = 1;
 
 int debugkaru = 0;
 
+// Print candidate plans and the cost comparison; batch mode turns this off
+int optimizer_verbose = 1;
+
+// Copies the plan structure into the query arena; strings are immutable and shared
 Node* duplicate_node(Node *node) {
     if (!node) return NULL;
-    Node *new_ = new_node(node->operation, node->arg1, node->arg2);
-    new_->child = duplicate_node(node->child);
-    new_->next = duplicate_node(node->next);
+    Node *new_ = (Node*) arena_alloc(get_node_arena(), sizeof(Node));
+    *new_ = *node;
+    new_->children[0] = duplicate_node(node->children[0]);
+    new_->children[1] = duplicate_node(node->children[1]);
     return new_;
 }
 
-void free_node(Node *node) {
-    if (!node) return;
-    free_node(node->child);
-    free_node(node->next);
-    if (node->operation) free(node->operation);
-    if (node->arg1) free(node->arg1);
-    if (node->arg2) free(node->arg2);
-    free(node);
-}
-
 void extract_table_column(const char *expr, char **table, char **column) {
     char *expr_copy = strdup(expr);
     char *start = expr_copy;
@@ -51,219 +54,271 @@ void extract_table_column(const char *expr, char **table, char **column) {
     free(expr_copy);
 }
 
+// Non-blank items of a comma separated list; called for every π and ⨝ costed, so it does not copy
 static int count_columns(const char *columns) {
     if (!columns) return 0;
-    int count = 0;
-    char *copy = strdup(columns);
-    char *token = strtok(copy, ",");
-    while (token) {
-        while (*token == ' ') token++;
-        char *end = token + strlen(token) - 1;
-        while (end > token && isspace(*end)) *end-- = '\0';
-        if (*token != '\0') {
-            count++;
+    int count = 0, blank = 1;
+    for (const char *p = columns; ; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!blank) count++;
+            if (*p == '\0') break;
+            blank = 1;
+        } else if (!isspace((unsigned char)*p)) {
+            blank = 0;
         }
-        token = strtok(NULL, ",");
     }
-    free(copy);
     return count;
 }
 
-static int count_required_columns(Node *node) {
-    Node *current = node;
-    while (current) {
-        if (current->operation && strcmp(current->operation, "π") == 0) {
-            return count_columns(current->arg1);
-        }
-        current = current->next;
+static Node* new_predicate_node(OpKind op, Predicate *pred) {
+    Node *node = new_node(op, NULL, NULL);
+    node->arg1 = (char *)pred->text;
+    node->pred = pred;
+    return node;
+}
+
+static Node* find_table_with_column(Node *node, Symbol column) {
+    if (!node) return NULL;
+    if (node->op == OP_TABLE) {
+        return find_column_stats(node->table_id, column) ? node : NULL;
     }
-    
-    if (node->child) {
-        CostMetrics child = estimate_cost(node->child);
-        return child.num_columns;
+    Node *found = find_table_with_column(node->children[0], column);
+    if (found || node->op == OP_SEMIJOIN) return found;
+    return find_table_with_column(node->children[1], column);
+}
+
+static void bind_column(ColumnRef *ref, Node *scope, Node *fallback) {
+    if (ref->table == NO_SYMBOL) {
+        Node *table = find_table_with_column(scope, ref->column);
+        if (!table && fallback != scope) table = find_table_with_column(fallback, ref->column);
+        if (table) ref->table = table->table_id;
     }
-    
-    return 4;
+    ref->stats = find_column_stats(ref->table, ref->column);
 }
 
-void extract_condition_components(const char *condition, char **table, char **column, char **op, int *value) {
-    char condition_copy[100];
-    strcpy(condition_copy, condition);
-    
-    char *token = strtok(condition_copy, " ");
-    if (token) {
-        extract_table_column(token, table, &token);
-        *column = strdup(token);
-        free(token);
-        token = strtok(NULL, " ");
-        if (token) {
-            *op = strdup(token);
-            token = strtok(NULL, " ");
-            if (token) {
-                *value = atoi(token);
-            } else {
-                *value = 0;
-            }
-        } else {
-            *op = NULL;
-            *value = 0;
+static void bind_predicate(Predicate *pred, Node *node) {
+    Node *left_scope = node->op == OP_JOIN ? node->children[0] : node;
+    Node *right_scope = node->op == OP_JOIN ? node->children[1] : node;
+    if (pred->left.kind == OPERAND_COLUMN) bind_column(&pred->left.column, left_scope, node);
+    if (pred->right.kind == OPERAND_COLUMN) bind_column(&pred->right.column, right_scope, node);
+    if (pred->right.kind == OPERAND_SUBQUERY) bind_predicates(pred->right.subquery);
+}
+
+// Table (or alias) named by a column reference is somewhere in the subtree
+static int subtree_has_relation(Node *node, Symbol table) {
+    if (!node || table == NO_SYMBOL) return 0;
+    if (node->op == OP_TABLE) {
+        return node->table_id == table || (node->arg2 && lookup_symbol(node->arg2) == table);
+    }
+    // A semi-join's subquery tables are not visible above it
+    if (node->op == OP_SEMIJOIN) return subtree_has_relation(node->children[0], table);
+    return subtree_has_relation(node->children[0], table) || subtree_has_relation(node->children[1], table);
+}
+
+// The conjunct a ⨝ joins on: the first column = column comparison between its two inputs
+static Predicate* join_conjunct(Node *join) {
+    Predicate *fallback = NULL;
+    for (Predicate *pred = join->pred; pred; pred = pred->next) {
+        if (!is_join_predicate(pred)) continue;
+        Symbol left = pred->left.column.table, right = pred->right.column.table;
+        if ((subtree_has_relation(join->children[0], left) && subtree_has_relation(join->children[1], right)) ||
+            (subtree_has_relation(join->children[0], right) && subtree_has_relation(join->children[1], left))) {
+            return pred;
         }
-    } else {
-        *table = *column = *op = NULL;
-        *value = 0;
+        if (!fallback) fallback = pred;
     }
+    return fallback ? fallback : join->pred;
 }
 
-int can_push_to_table(const char *condition, const char *table_name, Node *context) {
-    char *table = NULL, *column = NULL, *op = NULL;
-    int value = 0;
-    extract_condition_components(condition, &table, &column, &op, &value);
+// Rewrites an AND chain into one node per conjunct, in place so that parents
+// keep their pointers: σ(p ∧ q) becomes σp(σq(...)), and ⨝(p ∧ j) becomes
+// σp(⨝j(...)) around the conjunct it joins on. The conjuncts themselves are
+// reused, so plan cache parameters still find their predicates.
+static void split_conjunction(Node *node) {
+    if (node->op == OP_JOIN) {
+        Predicate *join_on = join_conjunct(node);
+        Predicate **link = &node->pred;
+        while (*link != join_on) link = &(*link)->next;
+        *link = join_on->next;
+        join_on->next = NULL;
 
-    int result = 0;
-    if (table && strcmp(table, table_name) == 0 && get_column_stats(table_name, column)) {
-        result = 1;
-    } else if (column) {
-        ColumnStats *stats = get_column_stats(table_name, column);
-        if (stats) result = 1;
+        Node *join = new_predicate_node(OP_JOIN, join_on);
+        join->children[0] = node->children[0];
+        join->children[1] = node->children[1];
+        node->op = OP_SELECT;
+        node->children[0] = join;
+        node->children[1] = NULL;
     }
-    
-    if (table) free(table);
-    if (column) free(column);
-    if (op) free(op);
-    return result;
+
+    Node *input = node->children[0];
+    Node *above = node;
+    Predicate *rest = node->pred->next;
+    node->pred->next = NULL;
+    node->arg1 = (char *)node->pred->text;
+    node->cost_valid = 0;
+    while (rest) {
+        Predicate *next = rest->next;
+        rest->next = NULL;
+        Node *selection = new_predicate_node(OP_SELECT, rest);
+        above->children[0] = selection;
+        above = selection;
+        rest = next;
+    }
+    above->children[0] = input;
 }
 
-void parse_join_condition(const char *condition, char **left_table, char **left_col, 
-                         char **right_table, char **right_col) {
-    char condition_copy[100];
-    strcpy(condition_copy, condition);
+// Qualifies column references that were written without a table name with the
+// table below the predicate that has such a column, resolves every reference
+// to its catalog handle, and splits AND conditions into single comparisons.
+// Done once per query; plan copies share the bound predicates.
+void bind_predicates(Node *node) {
+    if (!node) return;
     
-    char *left_side = strtok(condition_copy, "=");
-    char *right_side = strtok(NULL, "=");
+    for (Predicate *pred = node->pred; pred; pred = pred->next) bind_predicate(pred, node);
     
-    if (left_side && right_side) {
-        char *left_clean = left_side;
-        char *right_clean = right_side;
-        while (isspace(*left_clean)) left_clean++;
-        while (isspace(*right_clean)) right_clean++;
-        char *left_end = left_clean + strlen(left_clean) - 1;
-        char *right_end = right_clean + strlen(right_clean) - 1;
-        while (left_end > left_clean && isspace(*left_end)) *left_end-- = '\0';
-        while (right_end > right_clean && isspace(*right_end)) *right_end-- = '\0';
-        
-        extract_table_column(left_clean, left_table, left_col);
-        extract_table_column(right_clean, right_table, right_col);
-    } else {
-        *left_table = *left_col = *right_table = *right_col = NULL;
-    }
+    bind_predicates(node->children[0]);
+    bind_predicates(node->children[1]);
+    if (node->pred && node->pred->next) split_conjunction(node);
 }
 
+// Conjuncts are taken to be independent, so an AND chain multiplies their selectivities
 static double get_condition_selectivity(Node *node) {
-    if (!node || !node->arg1) return 0.05; // Default selectivity
-    
-    char *table = NULL, *column = NULL, *op = NULL;
-    int value = 0;
-    extract_condition_components(node->arg1, &table, &column, &op, &value);
-    
-    double selectivity = 0.05;
-    if (table && column && op) {
-        selectivity = calculate_condition_selectivity(table, column, op, value);
-    } else if (column && op) {
-        Node *current = node->child;
-        while (current) {
-            if (current->operation && strcmp(current->operation, "table") == 0) {
-                if (get_column_stats(current->arg1, column)) {
-                    selectivity = calculate_condition_selectivity(current->arg1, column, op, value);
-                    break;
-                }
-            }
-            current = current->child ? current->child : current->next;
-        }
+    if (!node || !node->pred) return 0.05; // Default selectivity
+    double selectivity = 1.0;
+    for (const Predicate *pred = node->pred; pred; pred = pred->next) {
+        selectivity *= calculate_predicate_selectivity(pred);
     }
-    
-    if (table) free(table);
-    if (column) free(column);
-    if (op) free(op);
-    
     return selectivity;
 }
 
 static double get_join_selectivity(Node *node) {
-    if (!node || !node->arg1) return 0.05; // Default selectivity
-    
-    char *left_table = NULL, *left_col = NULL;
-    char *right_table = NULL, *right_col = NULL;
-    parse_join_condition(node->arg1, &left_table, &left_col, &right_table, &right_col);
-    
-    double selectivity = 0.05;
-    if (left_table && right_table && left_col && right_col) {
-        selectivity = calculate_join_selectivity(left_table, left_col, right_table, right_col);
+    return get_condition_selectivity(node);
+}
+
+// Statistics of a column ("t.c", "alias.c" or "c") read from the plan's tables
+static ColumnStats* named_column_stats(Node *plan, const char *name) {
+    if (strchr(name, '(')) return NULL;
+    char *table = NULL, *column = NULL;
+    extract_table_column(name, &table, &column);
+
+    ColumnStats *stats = NULL;
+    Symbol column_id = lookup_symbol(column);
+    if (table) {
+        Symbol table_id = lookup_symbol(table);
+        stats = find_column_stats(table_id, column_id);
+        if (!stats) {
+            // An alias: the table it names below
+            Node *leaf = find_table_with_column(plan, column_id);
+            if (leaf && leaf->arg2 && strcmp(leaf->arg2, table) == 0) stats = find_column_stats(leaf->table_id, column_id);
+        }
+    } else if (column_id != NO_SYMBOL) {
+        Node *leaf = find_table_with_column(plan, column_id);
+        if (leaf) stats = find_column_stats(leaf->table_id, column_id);
     }
-    
-    if (left_table) free(left_table);
-    if (left_col) free(left_col);
-    if (right_table) free(right_table);
-    if (right_col) free(right_col);
-    
-    return selectivity;
+    free(table);
+    free(column);
+    return stats;
 }
 
-double calculate_total_plan_cost(Node *node) {
-    if (!node) return 0.0;
-    
-    CostMetrics current = estimate_cost(node);
-    
-    if (strcmp(node->operation, "table") == 0) {
+// Statistics of the column a subquery plan returns, if it is a plain table column
+static ColumnStats* output_column_stats(Node *plan) {
+    if (!plan || plan->op != OP_PROJECT || !plan->arg1) return NULL;
+    char first[256];
+    if (!next_list_item(plan->arg1, first, sizeof(first))) return NULL;
+    return named_column_stats(plan, first);
+}
+
+// Groups a γ produces: the product of its keys' distinct counts, at most one
+// per input row. Keys without statistics leave every row its own group.
+static int estimate_groups(Node *node, int input_rows) {
+    char item[256], argument[256];
+    double groups = 1.0;
+    for (const char *rest = node->arg1; (rest = next_list_item(rest, item, sizeof(item))); ) {
+        if (parse_aggregate(item, argument, sizeof(argument)) != AGG_NONE) continue;
+        ColumnStats *stats = named_column_stats(node->children[0], item);
+        groups *= stats && stats->distinct_values > 0 ? stats->distinct_values : (double)input_rows;
+        if (groups >= input_rows) break;
+    }
+    if (groups > input_rows) groups = input_rows;
+    return groups < 1.0 ? 1 : (int)groups;
+}
+
+// column IN (subquery) as a semi-join: the subquery returns at most its row
+// count of distinct values, each matching the column like a join would
+static double get_semijoin_selectivity(Node *node, int subquery_rows) {
+    Predicate *pred = node->pred;
+    if (!pred || pred->left.kind != OPERAND_COLUMN) return 0.05;
+    ColumnStats *left = pred->left.column.stats;
+    ColumnStats *right = output_column_stats(node->children[1]);
+    if (!left || !right) return calculate_predicate_selectivity(pred);
+    double values = subquery_rows < right->distinct_values ? subquery_rows : right->distinct_values;
+    return column_semijoin_selectivity(left, right, values);
+}
+
+// Cumulative cost of the subtree rooted at node; children come from their cached annotations
+static double compute_total_cost(Node *node, CostMetrics current) {
+    if (node->op == OP_TABLE) {
         return current.cost;
     }
     
-    if (strcmp(node->operation, "σ") == 0) {
-        double child_cost = calculate_total_plan_cost(node->child);
+    if (node->op == OP_SELECT) {
+        double child_cost = calculate_total_plan_cost(node->children[0]);
         double selectivity = get_condition_selectivity(node);
         return child_cost * (1.0 + selectivity);
     }
     
-    if (strcmp(node->operation, "⨝") == 0) {
-        if (!node->child || !node->next) return current.cost;
+    if (node->op == OP_JOIN) {
+        if (!node->children[0] || !node->children[1]) return current.cost;
         
-        double left_cost = calculate_total_plan_cost(node->child);
-        double right_cost = calculate_total_plan_cost(node->next);
+        double left_cost = calculate_total_plan_cost(node->children[0]);
+        double right_cost = calculate_total_plan_cost(node->children[1]);
         double selectivity = get_join_selectivity(node);
         
         return left_cost + right_cost + (current.result_size * current.num_columns * 0.1);
     }
     
-    if (strcmp(node->operation, "π") == 0) {
-        double child_cost = calculate_total_plan_cost(node->child);
-        double column_ratio = (double)current.num_columns / (child_cost > 0 ? estimate_cost(node->child).num_columns : 1);
+    if (node->op == OP_SEMIJOIN) {
+        // A join whose build side is the subquery's distinct values
+        double left_cost = calculate_total_plan_cost(node->children[0]);
+        double right_cost = calculate_total_plan_cost(node->children[1]);
+        return left_cost + right_cost + (current.result_size * current.num_columns * 0.1);
+    }
+    
+    if (node->op == OP_AGGREGATE) {
+        // One hash table update per input row
+        double child_cost = calculate_total_plan_cost(node->children[0]);
+        CostMetrics child = estimate_cost(node->children[0]);
+        return child_cost + (child.result_size * current.num_columns * 0.1);
+    }
+    
+    if (node->op == OP_PROJECT) {
+        double child_cost = calculate_total_plan_cost(node->children[0]);
+        double column_ratio = (double)current.num_columns / (child_cost > 0 ? estimate_cost(node->children[0]).num_columns : 1);
         return child_cost * (0.9 + (0.1 * column_ratio));
     }
     
     double cost = current.cost;
-    if (node->child) {
-        cost += calculate_total_plan_cost(node->child);
+    if (node->children[0]) {
+        cost += calculate_total_plan_cost(node->children[0]);
     }
-    if (node->next) {
-        cost += calculate_total_plan_cost(node->next);
+    if (node->children[1]) {
+        cost += calculate_total_plan_cost(node->children[1]);
     }
     
-    if (debugkaru) printf("[DEBUG] Total cost for node %s: %.1f\n", node->operation, cost);
+    if (debugkaru) printf("[DEBUG] Total cost for node %s: %.1f\n", op_symbol(node->op), cost);
     
     return cost;
 }
 
-CostMetrics estimate_cost(Node *node) {
+// Estimate for a single node; children come from their cached annotations
+static CostMetrics compute_node_cost(Node *node) {
     CostMetrics metrics = {0, 0, 0.0};
-    if (!node) {
-        if (debugkaru) printf("[DEBUG] estimate_cost: NULL node, returning {0, 0, 0.0}\n");
-        return metrics;
-    }
 
     if (debugkaru) printf("[DEBUG] estimate_cost: node=%s, arg1=%s\n", 
-                         node->operation, node->arg1 ? node->arg1 : "NULL");
+                         op_symbol(node->op), node->arg1 ? node->arg1 : "NULL");
 
-    if (strcmp(node->operation, "table") == 0) {
-        TableStats *stats = get_table_stats(node->arg1);
+    if (node->op == OP_TABLE) {
+        TableStats *stats = find_table_stats(node->table_id);
         metrics.result_size = stats ? stats->row_count : 1000;
         metrics.num_columns = stats ? stats->column_count : 4;
         metrics.cost = metrics.result_size * metrics.num_columns;
@@ -272,8 +327,8 @@ CostMetrics estimate_cost(Node *node) {
         return metrics;
     }
 
-    if (strcmp(node->operation, "σ") == 0) {
-        CostMetrics child = estimate_cost(node->child);
+    if (node->op == OP_SELECT) {
+        CostMetrics child = estimate_cost(node->children[0]);
         double selectivity = get_condition_selectivity(node);
         
         metrics.result_size = (int)(child.result_size * selectivity);
@@ -287,38 +342,47 @@ CostMetrics estimate_cost(Node *node) {
         return metrics;
     }
 
-    if (strcmp(node->operation, "⨝") == 0) {
-        if (!node->child || !node->next) {
+    if (node->op == OP_JOIN) {
+        if (!node->children[0] || !node->children[1]) {
             if (debugkaru) printf("[DEBUG] Join %s: missing children, returning {0, 0, 0.0}\n",
                                  node->arg1 ? node->arg1 : "NULL");
             return metrics;
         }
         
-        CostMetrics left = estimate_cost(node->child);
-        CostMetrics right = estimate_cost(node->next);
+        CostMetrics left = estimate_cost(node->children[0]);
+        CostMetrics right = estimate_cost(node->children[1]);
         double selectivity = get_join_selectivity(node);
         
-        metrics.result_size = (int)(left.result_size * right.result_size * selectivity);
+        double rows = (double)left.result_size * right.result_size * selectivity;
+        metrics.result_size = rows > INT_MAX ? INT_MAX : (int)rows;
         if (metrics.result_size == 0 && left.result_size > 0 && right.result_size > 0) {
             metrics.result_size = (int)(fmin(left.result_size, right.result_size));
         }
         metrics.num_columns = left.num_columns + right.num_columns;
-        Node *parent = node;
-        while (parent->next) {
-            parent = parent->next;
-            if (parent->operation && strcmp(parent->operation, "π") == 0) {
-                metrics.num_columns = count_columns(parent->arg1);
-                break;
-            }
-        }
         metrics.cost = metrics.result_size * metrics.num_columns;
         if (debugkaru) printf("[DEBUG] Join %s: selectivity=%.4f, rows=%d, cols=%d, cost=%.1f\n",
                              node->arg1, selectivity, metrics.result_size, metrics.num_columns, metrics.cost);
         return metrics;
     }
 
-    if (strcmp(node->operation, "π") == 0) {
-        CostMetrics child = estimate_cost(node->child);
+    if (node->op == OP_SEMIJOIN) {
+        CostMetrics left = estimate_cost(node->children[0]);
+        CostMetrics right = estimate_cost(node->children[1]);
+        double selectivity = get_semijoin_selectivity(node, right.result_size);
+        
+        metrics.result_size = (int)(left.result_size * selectivity);
+        if (metrics.result_size == 0 && left.result_size > 0 && right.result_size > 0) {
+            metrics.result_size = 1;
+        }
+        metrics.num_columns = left.num_columns;
+        metrics.cost = metrics.result_size * metrics.num_columns;
+        if (debugkaru) printf("[DEBUG] Semi-join %s: selectivity=%.4f, rows=%d, cols=%d, cost=%.1f\n",
+                             node->arg1, selectivity, metrics.result_size, metrics.num_columns, metrics.cost);
+        return metrics;
+    }
+
+    if (node->op == OP_PROJECT) {
+        CostMetrics child = estimate_cost(node->children[0]);
         metrics.result_size = child.result_size;
         metrics.num_columns = count_columns(node->arg1);
         metrics.cost = metrics.result_size * metrics.num_columns;
@@ -327,61 +391,133 @@ CostMetrics estimate_cost(Node *node) {
         return metrics;
     }
 
-    if (debugkaru) printf("[DEBUG] Unknown node %s: returning {0, 0, 0.0}\n", node->operation);
+    if (node->op == OP_AGGREGATE) {
+        CostMetrics child = estimate_cost(node->children[0]);
+        metrics.result_size = estimate_groups(node, child.result_size);
+        metrics.num_columns = count_columns(node->arg1);
+        metrics.cost = metrics.result_size * metrics.num_columns;
+        if (debugkaru) printf("[DEBUG] Aggregate %s: rows=%d, cols=%d, cost=%.1f\n",
+                             node->arg1, metrics.result_size, metrics.num_columns, metrics.cost);
+        return metrics;
+    }
+
+    if (debugkaru) printf("[DEBUG] Unknown node %s: returning {0, 0, 0.0}\n", op_symbol(node->op));
     return metrics;
 }
 
-Node* push_down_selections(Node *node) {
-    if (!node) return NULL;
-    if (debugkaru) printf("Pushing down selections...%s\n", node->operation ? node->operation : "NULL");
+// Fills in the cached CostMetrics and cumulative cost of every stale node in one
+// bottom-up pass. A valid node always has valid children, so clean subtrees are skipped.
+void annotate_costs(Node *node) {
+    if (!node || node->cost_valid) return;
+    annotate_costs(node->children[0]);
+    annotate_costs(node->children[1]);
     
-    if (node->operation && strcmp(node->operation, "σ") == 0) {
-        Node *child = node->child;
-        if (!child) return node;
-        
-        if (child->operation && strcmp(child->operation, "⨝") == 0) {
-            Node *left_table = child->child;
-            Node *right_table = child->next;
-            
-            if (left_table && right_table) {
-                if (can_push_to_table(node->arg1, left_table->arg1, node)) {
-                    if (debugkaru) printf("Pushing condition '%s' down to table '%s'\n", node->arg1, left_table->arg1);
-                    
-                    Node *new_selection = new_node("σ", strdup(node->arg1), NULL);
-                    new_selection->child = left_table;
-                    
-                    child->child = new_selection;
-                    child->next = right_table;
-                    
-                    node->child = NULL;
-                    free(node->operation);
-                    free(node->arg1);
-                    free(node);
-                    
-                    return child;
-                } else if (can_push_to_table(node->arg1, right_table->arg1, node)) {
-                    if (debugkaru) printf("Pushing condition '%s' down to table '%s'\n", node->arg1, right_table->arg1);
-                    
-                    Node *new_selection = new_node("σ", strdup(node->arg1), NULL);
-                    new_selection->child = right_table;
-                    
-                    child->child = left_table;
-                    child->next = new_selection;
-                    
-                    node->child = NULL;
-                    free(node->operation);
-                    free(node->arg1);
-                    free(node);
-                    
-                    return child;
-                }
-            }
+    CostMetrics metrics = compute_node_cost(node);
+    TRACE_COUNT(TRACE_NODE_COSTS);
+    node->est_rows = metrics.result_size;
+    node->est_columns = metrics.num_columns;
+    node->est_cost = metrics.cost;
+    node->total_cost = compute_total_cost(node, metrics);
+    node->cost_valid = 1;
+}
+
+// Drops cached costs for a whole subtree (e.g. after statistics change)
+void invalidate_costs(Node *node) {
+    if (!node) return;
+    node->cost_valid = 0;
+    invalidate_costs(node->children[0]);
+    invalidate_costs(node->children[1]);
+}
+
+// Rewrites call this on the way back up so that a changed subtree also stales its ancestors
+static void propagate_invalidation(Node *node) {
+    if ((node->children[0] && !node->children[0]->cost_valid) || (node->children[1] && !node->children[1]->cost_valid)) {
+        node->cost_valid = 0;
+    }
+}
+
+CostMetrics estimate_cost(Node *node) {
+    CostMetrics metrics = {0, 0, 0.0};
+    if (!node) {
+        if (debugkaru) printf("[DEBUG] estimate_cost: NULL node, returning {0, 0, 0.0}\n");
+        return metrics;
+    }
+    TRACE_COUNT(TRACE_COST_CALLS);
+    double traced = trace_begin();
+    annotate_costs(node);
+    trace_end(TRACE_COSTING, traced);
+    metrics.result_size = node->est_rows;
+    metrics.num_columns = node->est_columns;
+    metrics.cost = node->est_cost;
+    return metrics;
+}
+
+double calculate_total_plan_cost(Node *node) {
+    if (!node) return 0.0;
+    TRACE_COUNT(TRACE_COST_CALLS);
+    double traced = trace_begin();
+    annotate_costs(node);
+    trace_end(TRACE_COSTING, traced);
+    return node->total_cost;
+}
+
+// Every table the predicate reads is inside the subtree
+static int predicate_within(const Predicate *pred, Node *node) {
+    int columns = 0;
+    if (pred->left.kind == OPERAND_COLUMN) {
+        if (!subtree_has_relation(node, pred->left.column.table)) return 0;
+        columns++;
+    }
+    if (pred->right.kind == OPERAND_COLUMN) {
+        if (!subtree_has_relation(node, pred->right.column.table)) return 0;
+        columns++;
+    }
+    return columns > 0;
+}
+
+// Moves a σ (or ⋉) down through joins, and past other σs and ⋉s in the way,
+// to the lowest input that still has every table its predicate reads. Returns
+// the subtree that now takes the σ's place.
+static Node* sink_selection(Node *selection) {
+    Node *input = selection->children[0];
+    if (!input) return selection;
+    
+    if (input->op == OP_JOIN && input->children[0] && input->children[1]) {
+        for (int side = 0; side < 2; side++) {
+            if (!predicate_within(selection->pred, input->children[side])) continue;
+            if (debugkaru) printf("Pushing condition '%s' below join '%s'\n", selection->arg1, input->arg1);
+            selection->children[0] = input->children[side];
+            selection->cost_valid = 0;
+            input->children[side] = sink_selection(selection);
+            input->cost_valid = 0;
+            TRACE_COUNT(TRACE_SELECTIONS_PUSHED);
+            return input;
+        }
+    } else if (input->op == OP_SELECT || input->op == OP_SEMIJOIN) {
+        // Only worth passing the σ below if it then goes under a join
+        selection->children[0] = input->children[0];
+        Node *sunk = sink_selection(selection);
+        if (sunk != selection) {
+            input->children[0] = sunk;
+            input->cost_valid = 0;
+            return input;
         }
+        selection->children[0] = input;
     }
+    return selection;
+}
+
+Node* push_down_selections(Node *node) {
+    if (!node) return NULL;
+    if (debugkaru) printf("Pushing down selections...%s\n", op_symbol(node->op));
     
-    if (node->child) node->child = push_down_selections(node->child);
-    if (node->next) node->next = push_down_selections(node->next);
+    // Bottom up, so that the σs below are already as low as they go. A ⋉'s
+    // subquery plan is already optimized on its own.
+    if (node->children[0]) node->children[0] = push_down_selections(node->children[0]);
+    if (node->children[1] && node->op != OP_SEMIJOIN) node->children[1] = push_down_selections(node->children[1]);
+    propagate_invalidation(node);
     
+    if ((node->op == OP_SELECT || node->op == OP_SEMIJOIN) && node->pred) return sink_selection(node);
     return node;
 }
 
@@ -389,7 +525,8 @@ static int is_column_in_projection(const char *column, const char *projection_li
     if (!column || !projection_list) return 0;
     
     char *copy = strdup(projection_list);
-    char *token = strtok(copy, ",");
+    char *saveptr;
+    char *token = strtok_r(copy, ",", &saveptr);
     while (token) {
         while (*token == ' ') token++;
         char *end = token + strlen(token) - 1;
@@ -399,7 +536,7 @@ static int is_column_in_projection(const char *column, const char *projection_li
             free(copy);
             return 1;
         }
-        token = strtok(NULL, ",");
+        token = strtok_r(NULL, ",", &saveptr);
     }
     free(copy);
     return 0;
@@ -408,16 +545,15 @@ static int is_column_in_projection(const char *column, const char *projection_li
 static Node* create_restricted_projection(Node *node, const char *projection_list) {
     if (!node || !projection_list) return node;
     
-    if (strcmp(node->operation, "table") == 0) {
-        TableStats *stats = get_table_stats(node->arg1);
+    if (node->op == OP_TABLE) {
+        TableStats *stats = find_table_stats(node->table_id);
         if (!stats) return node;
         
         char restricted_columns[1024] = "";
         int first = 1;
         
         for (int i = 0; i < stats->column_count; i++) {
-            char full_col[256];
-            sprintf(full_col, "%s.%s", node->arg1, stats->column_names[i]);
+            const char *full_col = stats->columns[i]->qualified_name;
             
             if (is_column_in_projection(full_col, projection_list) ||
                 is_column_in_projection(stats->column_names[i], projection_list)) {
@@ -428,8 +564,8 @@ static Node* create_restricted_projection(Node *node, const char *projection_lis
         }
         
         if (strlen(restricted_columns) > 0) {
-            Node *proj = new_node("π", strdup(restricted_columns), NULL);
-            proj->child = node;
+            Node *proj = new_node(OP_PROJECT, restricted_columns, NULL);
+            proj->children[0] = node;
             return proj;
         }
     }
@@ -444,52 +580,57 @@ Node* push_down_projections(Node *node) {
     }
     
     if (debugkaru) printf("\n[DEBUG] ENTER push_down_projections for node type: %s, arg1: %s\n", 
-           node->operation ? node->operation : "NULL", 
+           op_symbol(node->op), 
            node->arg1 ? node->arg1 : "NULL");
     
-    if (node->operation && strcmp(node->operation, "π") == 0) {
+    if (node->op == OP_PROJECT) {
         if (debugkaru) printf("\n[DEBUG] Found projection node with columns: %s\n", node->arg1);
         
-        Node *child = node->child;
+        Node *child = node->children[0];
         if (!child) {
             if (debugkaru) printf("\n[DEBUG] Projection has no child, returning node\n");
             return node;
         }
         
-        if (debugkaru) printf("\n[DEBUG] Child operation: %s\n", child->operation ? child->operation : "NULL");
+        if (debugkaru) printf("\n[DEBUG] Child operation: %s\n", op_symbol(child->op));
         
-        if (child->operation && strcmp(child->operation, "σ") == 0) {
+        if (child->op == OP_SELECT) {
             if (debugkaru) printf("\n[DEBUG] Case 1: Push projection through selection\n");
             
-            Node *new_projection = new_node("π", strdup(node->arg1), NULL);
-            new_projection->child = child->child;
-            child->child = new_projection;
+            Node *new_projection = new_node(OP_PROJECT, node->arg1, NULL);
+            new_projection->children[0] = child->children[0];
+            child->children[0] = new_projection;
             
+            TRACE_COUNT(TRACE_PROJECTIONS_PUSHED);
             Node *result = child;
-            node->child = NULL;
-            free(node->operation);
-            free(node->arg1);
-            free(node);
-            
-            result->child = push_down_projections(result->child);
+            result->children[0] = push_down_projections(result->children[0]);
+            result->cost_valid = 0;
             return result;
         }
-        else if (child->operation && strcmp(child->operation, "⨝") == 0) {
+        else if (child->op == OP_JOIN) {
             if (debugkaru) printf("\n[DEBUG] Case 2: Push projection through join\n");
             
-            Node *left_table = child->child;
-            Node *right_table = child->next;
+            Node *left_table = child->children[0];
+            Node *right_table = child->children[1];
             
             if (!left_table || !right_table) {
                 if (debugkaru) printf("\n[DEBUG] Missing tables, returning original node\n");
                 return node;
             }
             
+            if (left_table->op != OP_TABLE || right_table->op != OP_TABLE) {
+                if (debugkaru) printf("\n[DEBUG] Join inputs are not base tables, skipping\n");
+                node->children[0] = push_down_projections(child);
+                propagate_invalidation(node);
+                return node;
+            }
+            
             char *columns = strdup(node->arg1);
             char *column_list[100];
             int column_count = 0;
             
-            char *token = strtok(columns, ",");
+            char *saveptr;
+            char *token = strtok_r(columns, ",", &saveptr);
             while (token) {
                 while (*token == ' ') token++;
                 char *end = token + strlen(token) - 1;
@@ -498,14 +639,9 @@ Node* push_down_projections(Node *node) {
                     column_list[column_count] = strdup(token);
                     column_count++;
                 }
-                token = strtok(NULL, ",");
+                token = strtok_r(NULL, ",", &saveptr);
             }
             
-            char *left_table_name = NULL, *left_col = NULL;
-            char *right_table_name = NULL, *right_col = NULL;
-            parse_join_condition(child->arg1, &left_table_name, &left_col, 
-                               &right_table_name, &right_col);
-            
             char left_columns[512] = "";
             char right_columns[512] = "";
             int left_has_columns = 0;
@@ -516,12 +652,13 @@ Node* push_down_projections(Node *node) {
                 extract_table_column(column_list[i], &table, &column);
                 
                 if (table) {
-                    if (strcmp(table, left_table->arg1) == 0) {
+                    Symbol table_id = lookup_symbol(table);
+                    if (table_id == left_table->table_id) {
                         if (left_has_columns) strcat(left_columns, ",");
                         strcat(left_columns, column_list[i]);
                         left_has_columns = 1;
                     }
-                    else if (strcmp(table, right_table->arg1) == 0) {
+                    else if (table_id == right_table->table_id) {
                         if (right_has_columns) strcat(right_columns, ",");
                         strcat(right_columns, column_list[i]);
                         right_has_columns = 1;
@@ -532,66 +669,369 @@ Node* push_down_projections(Node *node) {
                 if (column) free(column);
             }
             
-            if (left_table_name && left_col) {
-                char full_col[100];
-                sprintf(full_col, "%s.%s", left_table_name, left_col);
-                if (!strstr(left_columns, full_col)) {
-                    if (left_has_columns) strcat(left_columns, ",");
-                    strcat(left_columns, full_col);
-                    left_has_columns = 1;
-                }
-            }
-            
-            if (right_table_name && right_col) {
-                char full_col[100];
-                sprintf(full_col, "%s.%s", right_table_name, right_col);
-                if (!strstr(right_columns, full_col)) {
-                    if (right_has_columns) strcat(right_columns, ",");
-                    strcat(right_columns, full_col);
-                    right_has_columns = 1;
+            // Both join columns must survive on whichever side their table is
+            if (is_join_predicate(child->pred)) {
+                const ColumnRef *join_columns[2] = {&child->pred->left.column, &child->pred->right.column};
+                for (int i = 0; i < 2; i++) {
+                    const ColumnRef *ref = join_columns[i];
+                    if (ref->table == NO_SYMBOL) continue;
+                    char full_col[256];
+                    snprintf(full_col, sizeof(full_col), "%s.%s", symbol_name(ref->table), symbol_name(ref->column));
+                    if (ref->table == left_table->table_id && !strstr(left_columns, full_col)) {
+                        if (left_has_columns) strcat(left_columns, ",");
+                        strcat(left_columns, full_col);
+                        left_has_columns = 1;
+                    } else if (ref->table == right_table->table_id && !strstr(right_columns, full_col)) {
+                        if (right_has_columns) strcat(right_columns, ",");
+                        strcat(right_columns, full_col);
+                        right_has_columns = 1;
+                    }
                 }
             }
             
-            Node *new_left_table = new_node("table", strdup(left_table->arg1), NULL);
-            Node *new_right_table = new_node("table", strdup(right_table->arg1), NULL);
+            Node *new_left_table = new_node(OP_TABLE, left_table->arg1, NULL);
+            Node *new_right_table = new_node(OP_TABLE, right_table->arg1, NULL);
             
-            Node *left_projection = left_has_columns ? new_node("π", strdup(left_columns), NULL) : new_left_table;
-            if (left_has_columns) left_projection->child = new_left_table;
+            Node *left_projection = left_has_columns ? new_node(OP_PROJECT, left_columns, NULL) : new_left_table;
+            if (left_has_columns) left_projection->children[0] = new_left_table;
             
-            Node *right_projection = right_has_columns ? new_node("π", strdup(right_columns), NULL) : new_right_table;
-            if (right_has_columns) right_projection->child = new_right_table;
+            Node *right_projection = right_has_columns ? new_node(OP_PROJECT, right_columns, NULL) : new_right_table;
+            if (right_has_columns) right_projection->children[0] = new_right_table;
             
-            Node *new_join = new_node("⨝", strdup(child->arg1), NULL);
-            new_join->child = left_projection;
-            new_join->next = right_projection;
+            Node *new_join = new_predicate_node(OP_JOIN, child->pred);
+            new_join->children[0] = left_projection;
+            new_join->children[1] = right_projection;
             
-            Node *top_projection = new_node("π", strdup(node->arg1), NULL);
-            top_projection->child = new_join;
+            Node *top_projection = new_node(OP_PROJECT, node->arg1, NULL);
+            top_projection->children[0] = new_join;
             
             for (int i = 0; i < column_count; i++) {
                 free(column_list[i]);
             }
             free(columns);
-            if (left_table_name) free(left_table_name);
-            if (left_col) free(left_col); 
-            if (right_table_name) free(right_table_name);
-            if (right_col) free(right_col);
-            
-            node->child = NULL;
-            free(node->operation);
-            free(node->arg1);
-            free(node);
+            TRACE_COUNT(TRACE_PROJECTIONS_PUSHED);
             
             return top_projection;
         }
     }
     
-    if (node->child) node->child = push_down_projections(node->child);
-    if (node->next) node->next = push_down_projections(node->next);
+    if (node->children[0]) node->children[0] = push_down_projections(node->children[0]);
+    if (node->children[1]) node->children[1] = push_down_projections(node->children[1]);
+    propagate_invalidation(node);
     
     return node;
 }
 
+// Join reordering: bushy dynamic programming over connected subsets of the join graph
+#define MAX_JOIN_RELATIONS 64
+#define MAX_DP_RELATIONS 14
+
+typedef struct JoinEdge {
+    Node *join;         // Original ⨝ node carrying the condition
+    Predicate *pred;
+    int left;           // Index of the relation holding the left column
+    int right;          // Index of the relation holding the right column
+    double selectivity;
+} JoinEdge;
+
+typedef struct JoinGraph {
+    int relation_count;
+    Node *relations[MAX_JOIN_RELATIONS];
+    int edge_count;
+    JoinEdge edges[MAX_JOIN_RELATIONS];
+} JoinGraph;
+
+static int subtree_has_table(Node *node, Symbol table_id) {
+    if (!node) return 0;
+    if (node->op == OP_TABLE && node->table_id == table_id) {
+        return 1;
+    }
+    if (node->op == OP_SEMIJOIN) return subtree_has_table(node->children[0], table_id);
+    return subtree_has_table(node->children[0], table_id) || subtree_has_table(node->children[1], table_id);
+}
+
+static const char* first_table_name(Node *node) {
+    if (!node) return NULL;
+    if (node->op == OP_TABLE) return symbol_name(node->table_id);
+    const char *name = first_table_name(node->children[0]);
+    return name ? name : first_table_name(node->children[1]);
+}
+
+static int find_relation(JoinGraph *graph, Symbol table_id) {
+    if (table_id == NO_SYMBOL) return -1;
+    for (int i = 0; i < graph->relation_count; i++) {
+        if (subtree_has_table(graph->relations[i], table_id)) return i;
+    }
+    return -1;
+}
+
+// Splits a tree of ⨝ nodes into its base relations and join predicates
+static int collect_join_graph(Node *node, JoinGraph *graph) {
+    if (node->op == OP_JOIN && node->children[0] && node->children[1]) {
+        if (graph->edge_count >= MAX_JOIN_RELATIONS) return 0;
+        JoinEdge *edge = &graph->edges[graph->edge_count++];
+        memset(edge, 0, sizeof(JoinEdge));
+        edge->join = node;
+        return collect_join_graph(node->children[0], graph) && collect_join_graph(node->children[1], graph);
+    }
+    if (graph->relation_count >= MAX_JOIN_RELATIONS) return 0;
+    graph->relations[graph->relation_count++] = node;
+    return 1;
+}
+
+// Maps every join predicate onto the pair of relations it connects
+static int resolve_join_edges(JoinGraph *graph) {
+    for (int i = 0; i < graph->edge_count; i++) {
+        JoinEdge *edge = &graph->edges[i];
+        edge->pred = edge->join->pred;
+        if (!is_join_predicate(edge->pred)) return 0;
+
+        edge->left = find_relation(graph, edge->pred->left.column.table);
+        edge->right = find_relation(graph, edge->pred->right.column.table);
+        if (edge->left < 0 || edge->right < 0 || edge->left == edge->right) return 0;
+        edge->selectivity = get_join_selectivity(edge->join);
+    }
+    return 1;
+}
+
+static int edge_crosses(JoinEdge *edge, unsigned long long left, unsigned long long right) {
+    unsigned long long l = 1ULL << edge->left;
+    unsigned long long r = 1ULL << edge->right;
+    return ((l & left) && (r & right)) || ((l & right) && (r & left));
+}
+
+static JoinOrderNode* new_join_order_leaf(Node *relation, int index) {
+    JoinOrderNode *leaf = (JoinOrderNode *)calloc(1, sizeof(JoinOrderNode));
+    const char *name = first_table_name(relation);
+    CostMetrics metrics = estimate_cost(relation);
+    leaf->left_table = name ? strdup(name) : NULL;
+    leaf->relation = relation;
+    leaf->relations = 1ULL << index;
+    leaf->result_size = metrics.result_size;
+    leaf->num_columns = metrics.num_columns;
+    leaf->cost = calculate_total_plan_cost(relation);
+    return leaf;
+}
+
+// Joins two disjoint subplans, costed like calculate_total_plan_cost does for ⨝.
+// Returns NULL when no predicate connects them (cross products are never considered).
+static JoinOrderNode* new_join_order_pair(JoinGraph *graph, JoinOrderNode *left, JoinOrderNode *right) {
+    JoinEdge *first = NULL;
+    double selectivity = 1.0;
+    for (int i = 0; i < graph->edge_count; i++) {
+        JoinEdge *edge = &graph->edges[i];
+        if (!edge_crosses(edge, left->relations, right->relations)) continue;
+        if (!first) first = edge;
+        selectivity *= edge->selectivity;
+    }
+    if (!first) return NULL;
+    TRACE_COUNT(TRACE_JOIN_PAIRS);
+
+    double rows = (double)left->result_size * right->result_size * selectivity;
+    int result_size = rows > INT_MAX ? INT_MAX : (int)rows;
+    if (result_size == 0 && left->result_size > 0 && right->result_size > 0) {
+        result_size = (int)(fmin(left->result_size, right->result_size));
+    }
+
+    JoinOrderNode *pair = (JoinOrderNode *)calloc(1, sizeof(JoinOrderNode));
+    pair->left_table = strdup(symbol_name(first->pred->left.column.table));
+    pair->right_table = strdup(symbol_name(first->pred->right.column.table));
+    pair->join_condition = strdup(first->pred->text);
+    pair->left = left;
+    pair->right = right;
+    pair->relations = left->relations | right->relations;
+    pair->result_size = result_size;
+    pair->num_columns = left->num_columns + right->num_columns;
+    pair->cost = left->cost + right->cost + ((double)result_size * pair->num_columns * 0.1);
+    return pair;
+}
+
+static void free_join_order_node(JoinOrderNode *order) {
+    if (order->left_table) free(order->left_table);
+    if (order->right_table) free(order->right_table);
+    if (order->join_condition) free(order->join_condition);
+    free(order);
+}
+
+void free_join_order(JoinOrderNode *order) {
+    if (!order) return;
+    free_join_order(order->left);
+    free_join_order(order->right);
+    free_join_order_node(order);
+}
+
+static JoinOrderNode* copy_join_order(JoinOrderNode *order) {
+    if (!order) return NULL;
+    JoinOrderNode *copy = (JoinOrderNode *)malloc(sizeof(JoinOrderNode));
+    *copy = *order;
+    copy->left_table = order->left_table ? strdup(order->left_table) : NULL;
+    copy->right_table = order->right_table ? strdup(order->right_table) : NULL;
+    copy->join_condition = order->join_condition ? strdup(order->join_condition) : NULL;
+    copy->left = copy_join_order(order->left);
+    copy->right = copy_join_order(order->right);
+    return copy;
+}
+
+// Exhaustive bushy enumeration; memo[mask] holds the cheapest plan joining exactly
+// the relations in mask, and is only populated for connected subsets.
+static JoinOrderNode* dp_join_order(JoinGraph *graph) {
+    int n = graph->relation_count;
+    unsigned long long full = (1ULL << n) - 1;
+    JoinOrderNode **memo = (JoinOrderNode **)calloc(full + 1, sizeof(JoinOrderNode *));
+
+    for (int i = 0; i < n; i++) {
+        memo[1ULL << i] = new_join_order_leaf(graph->relations[i], i);
+    }
+
+    for (unsigned long long mask = 1; mask <= full; mask++) {
+        if ((mask & (mask - 1)) == 0) continue;
+        unsigned long long lowest = mask & (~mask + 1);
+        // Only submasks containing the lowest relation, so each unordered pair is visited once
+        for (unsigned long long sub = (mask - 1) & mask; sub > 0; sub = (sub - 1) & mask) {
+            if (!(sub & lowest)) continue;
+            unsigned long long rest = mask ^ sub;
+            if (!memo[sub] || !memo[rest]) continue;
+
+            JoinOrderNode *candidate = new_join_order_pair(graph, memo[sub], memo[rest]);
+            if (!candidate) continue;
+            if (!memo[mask] || candidate->cost < memo[mask]->cost) {
+                if (memo[mask]) free_join_order_node(memo[mask]);
+                memo[mask] = candidate;
+            } else {
+                free_join_order_node(candidate);
+            }
+        }
+    }
+
+    JoinOrderNode *best = copy_join_order(memo[full]);
+    for (unsigned long long mask = 1; mask <= full; mask++) {
+        if (memo[mask]) free_join_order_node(memo[mask]);
+    }
+    free(memo);
+    return best;
+}
+
+// Greedy fallback for graphs too large to enumerate: repeatedly join the
+// connected pair with the smallest intermediate result.
+static JoinOrderNode* greedy_join_order(JoinGraph *graph) {
+    int count = graph->relation_count;
+    JoinOrderNode *parts[MAX_JOIN_RELATIONS];
+    for (int i = 0; i < count; i++) {
+        parts[i] = new_join_order_leaf(graph->relations[i], i);
+    }
+
+    while (count > 1) {
+        JoinOrderNode *best = NULL;
+        int best_i = -1, best_j = -1;
+        for (int i = 0; i < count; i++) {
+            for (int j = i + 1; j < count; j++) {
+                JoinOrderNode *candidate = new_join_order_pair(graph, parts[i], parts[j]);
+                if (!candidate) continue;
+                if (!best || candidate->result_size < best->result_size ||
+                    (candidate->result_size == best->result_size && candidate->cost < best->cost)) {
+                    if (best) free_join_order_node(best);
+                    best = candidate;
+                    best_i = i;
+                    best_j = j;
+                } else {
+                    free_join_order_node(candidate);
+                }
+            }
+        }
+        if (!best) {
+            for (int i = 0; i < count; i++) free_join_order(parts[i]);
+            return NULL;
+        }
+        parts[best_i] = best;
+        parts[best_j] = parts[--count];
+    }
+    return parts[0];
+}
+
+static JoinOrderNode* optimal_join_order(JoinGraph *graph) {
+    if (graph->relation_count <= MAX_DP_RELATIONS) {
+        return dp_join_order(graph);
+    }
+    if (debugkaru) printf("[DEBUG] %d relations exceed DP limit, using greedy join ordering\n",
+                         graph->relation_count);
+    return greedy_join_order(graph);
+}
+
+JoinOrderNode* find_optimal_join_order(Node *join_node) {
+    if (!join_node || join_node->op != OP_JOIN) return NULL;
+
+    JoinGraph graph;
+    graph.relation_count = 0;
+    graph.edge_count = 0;
+    JoinOrderNode *order = NULL;
+    if (collect_join_graph(join_node, &graph) && resolve_join_edges(&graph)) {
+        order = optimal_join_order(&graph);
+    }
+    return order;
+}
+
+static Node* build_join_tree(JoinGraph *graph, JoinOrderNode *order) {
+    if (!order->left || !order->right) return order->relation;
+
+    // The first predicate between the two sides becomes the join condition; any
+    // further ones (cyclic join graphs) become filters above it
+    Node *left = build_join_tree(graph, order->left);
+    Node *right = build_join_tree(graph, order->right);
+    Node *result = NULL;
+    for (int i = 0; i < graph->edge_count; i++) {
+        JoinEdge *edge = &graph->edges[i];
+        if (!edge_crosses(edge, order->left->relations, order->right->relations)) continue;
+        if (!result) {
+            result = new_predicate_node(OP_JOIN, edge->pred);
+            result->children[0] = left;
+            result->children[1] = right;
+        } else {
+            Node *filter = new_predicate_node(OP_SELECT, edge->pred);
+            filter->children[0] = result;
+            result = filter;
+        }
+    }
+    return result;
+}
+
+Node* reorder_joins(Node *node) {
+    if (!node) return NULL;
+
+    if (node->op != OP_JOIN || !node->children[0] || !node->children[1]) {
+        node->children[0] = reorder_joins(node->children[0]);
+        if (node->op != OP_SEMIJOIN) node->children[1] = reorder_joins(node->children[1]);
+        propagate_invalidation(node);
+        return node;
+    }
+
+    JoinGraph graph;
+    graph.relation_count = 0;
+    graph.edge_count = 0;
+    if (!collect_join_graph(node, &graph)) {
+        return node;
+    }
+    for (int i = 0; i < graph.relation_count; i++) {
+        graph.relations[i] = reorder_joins(graph.relations[i]);
+    }
+
+    // With two inputs the only alternative is the mirrored join, which costs the same
+    if (graph.relation_count < 3 || !resolve_join_edges(&graph)) {
+        return node;
+    }
+
+    JoinOrderNode *order = optimal_join_order(&graph);
+    if (!order) {
+        if (debugkaru) printf("[DEBUG] Join graph is not connected, keeping written join order\n");
+        return node;
+    }
+
+    if (debugkaru) printf("[DEBUG] Reordered %d relations, estimated cost %.1f\n",
+                         graph.relation_count, order->cost);
+    Node *result = build_join_tree(&graph, order);
+    free_join_order(order);
+    return result;
+}
+
 static int get_table_columns(const char *table_name) {
     TableStats *stats = get_table_stats(table_name);
     return stats ? stats->column_count : 4;
@@ -604,35 +1044,28 @@ void print_execution_plan_recursive(Node *node, int depth) {
     
     CostMetrics metrics = estimate_cost(node);
     
-    if (strcmp(node->operation, "table") == 0) {
-        printf("table(%s) [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->arg1, metrics.result_size, metrics.num_columns, metrics.cost);
-    }
-    else if (strcmp(node->operation, "σ") == 0) {
-        printf("σ(%s) [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->arg1, metrics.result_size, metrics.num_columns, metrics.cost);
-    }
-    else if (strcmp(node->operation, "⨝") == 0) {
-        printf("⨝(%s) [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->arg1, metrics.result_size, metrics.num_columns, metrics.cost);
-    }
-    else if (strcmp(node->operation, "π") == 0) {
-        printf("π(%s) [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->arg1, metrics.result_size, metrics.num_columns, metrics.cost);
-    }
-    else {
-        printf("%s %s %s [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->operation, 
-               node->arg1 ? node->arg1 : "", 
-               node->arg2 ? node->arg2 : "", 
-               metrics.result_size, metrics.num_columns, metrics.cost);
+    switch (node->op) {
+        case OP_TABLE:
+        case OP_SELECT:
+        case OP_JOIN:
+        case OP_PROJECT:
+        case OP_SEMIJOIN:
+        case OP_AGGREGATE:
+            printf("%s(%s) [rows=%d, cols=%d, cost=%.1f%s]\n", 
+                   op_symbol(node->op), node->arg1, metrics.result_size, metrics.num_columns, metrics.cost,
+                   node->bloom_filter ? ", bloom filter" : "");
+            break;
+        default:
+            printf("%s %s %s [rows=%d, cols=%d, cost=%.1f]\n", 
+                   op_symbol(node->op), 
+                   node->arg1 ? node->arg1 : "", 
+                   node->arg2 ? node->arg2 : "", 
+                   metrics.result_size, metrics.num_columns, metrics.cost);
+            break;
     }
     
-    print_execution_plan_recursive(node->child, depth + 1);
-    if (node->operation && strcmp(node->operation, "⨝") == 0) {
-        print_execution_plan_recursive(node->next, depth + 1);
-    } else {
-        print_execution_plan_recursive(node->next, depth);
+    for (int i = 0; i < MAX_CHILDREN; i++) {
+        print_execution_plan_recursive(node->children[i], depth + 1);
     }
 }
 
@@ -641,185 +1074,268 @@ void print_execution_plan(Node *node, const char *title) {
     print_execution_plan_recursive(node, 0);
 }
 
+static Node* search_aggregate_plan(Node *root, MemoStats *memo, const char **best_plan_name);
 
-// Add a structure to store node costs for breakup
-struct NodeCost {
-    char operation[10];
-    char* description;
-    double node_cost; // Cost from estimate_cost
-    double cumulative_cost; // Cost from calculate_total_plan_cost
-};
-
-// Modify print_execution_plan_recursive to collect costs
-void print_execution_plan_recursive(Node *node, int depth, NodeCost *cost_breakup, int *cost_index) {
-    if (!node) return;
-    
-    for (int i = 0; i < depth; i++) printf("  ");
-    
-    CostMetrics metrics = estimate_cost(node);
-    double node_cost = metrics.cost;
-    double cumulative_cost = calculate_total_plan_cost(node);
-    
-    // Store cost for breakup
-    if (*cost_index < 100) { // Prevent buffer overflow
-        snprintf(cost_breakup[*cost_index].operation, 10, "%s", node->operation);
-        cost_breakup[*cost_index].description = node->arg1 ? strdup(node->arg1) : strdup("none");
-        cost_breakup[*cost_index].node_cost = node_cost;
-        cost_breakup[*cost_index].cumulative_cost = cumulative_cost;
-        (*cost_index)++;
+// Explores the rewrites of a bound plan in the memo and returns the cheapest
+// plan found, naming where it came from
+static Node* search_plan(Node *root, MemoStats *memo, const char **best_plan_name) {
+    if (root->op == OP_AGGREGATE || (root->op == OP_PROJECT && root->children[0] &&
+                                     root->children[0]->op == OP_AGGREGATE)) {
+        return search_aggregate_plan(root, memo, best_plan_name);
     }
     
-    if (strcmp(node->operation, "table") == 0) {
-        printf("table(%s) [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->arg1, metrics.result_size, metrics.num_columns, metrics.cost);
-    }
-    else if (strcmp(node->operation, "σ") == 0) {
-        printf("σ(%s) [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->arg1, metrics.result_size, metrics.num_columns, metrics.cost);
-    }
-    else if (strcmp(node->operation, "⨝") == 0) {
-        printf("⨝(%s) [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->arg1, metrics.result_size, metrics.num_columns, metrics.cost);
-    }
-    else if (strcmp(node->operation, "π") == 0) {
-        printf("π(%s) [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->arg1, metrics.result_size, metrics.num_columns, metrics.cost);
-    }
-    else {
-        printf("%s %s %s [rows=%d, cols=%d, cost=%.1f]\n", 
-               node->operation, 
-               node->arg1 ? node->arg1 : "", 
-               node->arg2 ? node->arg2 : "", 
-               metrics.result_size, metrics.num_columns, metrics.cost);
+    // The memo's join rules only cover queries of up to MEMO_MAX_JOIN_RELATIONS
+    // relations; the join order for larger ones comes from the DP/greedy search,
+    // run once over the plan with its selections pushed down to the tables
+    Node *seeds[1];
+    int seed_count = 0;
+    if (enable_join_reordering) {
+        Node *seed = duplicate_node(root);
+        if (enable_selection_pushdown) {
+            double traced = trace_begin();
+            seed = push_down_selections(seed);
+            trace_end(TRACE_SELECTION_PUSHDOWN, traced);
+        }
+        double traced = trace_begin();
+        seeds[seed_count++] = reorder_joins(seed);
+        trace_end(TRACE_JOIN_ORDER, traced);
     }
     
-    print_execution_plan_recursive(node->child, depth + 1, cost_breakup, cost_index);
-    if (node->operation && strcmp(node->operation, "⨝") == 0) {
-        print_execution_plan_recursive(node->next, depth + 1, cost_breakup, cost_index);
-    } else {
-        print_execution_plan_recursive(node->next, depth, cost_breakup, cost_index);
+    MemoRules rules = {enable_selection_pushdown, enable_projection_pushdown, enable_join_reordering};
+    Node *best_plan = memo_optimize(root, seeds, seed_count, rules, memo);
+    *best_plan_name = "Memo";
+    if (!best_plan) {
+        // Beyond the memo's limits: the cheaper of the written plan and the seeds
+        best_plan = root;
+        *best_plan_name = "Original";
+        for (int i = 0; i < seed_count; i++) {
+            TRACE_COUNT(TRACE_PLANS_CONSIDERED);
+            if (calculate_total_plan_cost(seeds[i]) < calculate_total_plan_cost(best_plan)) {
+                best_plan = seeds[i];
+                *best_plan_name = "Join Reorder";
+            }
+        }
     }
+    return best_plan;
 }
 
-// Modify print_execution_plan to initialize cost collection
-void print_execution_plan(Node *node, const char *title, NodeCost *cost_breakup, int *cost_index) {
-    printf("--- %s ---\n", title);
-    *cost_index = 0; // Reset cost index
-    print_execution_plan_recursive(node, 0, cost_breakup, cost_index);
+// The column ("t.c", "alias.c" or "c") comes from a table in the subtree
+static int column_within(Node *node, const char *name) {
+    char *table = NULL, *column = NULL;
+    extract_table_column(name, &table, &column);
+    Symbol column_id = lookup_symbol(column);
+    int within = table ? subtree_has_relation(node, lookup_symbol(table))
+                       : column_id != NO_SYMBOL && find_table_with_column(node, column_id) != NULL;
+    free(table);
+    free(column);
+    return within;
 }
 
-// Add a function to print cost breakup
-void print_cost_breakup(const char *plan_name, NodeCost *cost_breakup, int cost_count, double total_cost) {
-    printf("\nCost Breakup for %s Plan:\n", plan_name);
-    printf("Node Type | Description                              | Node Cost | Cumulative Cost\n");
-    printf("----------|------------------------------------------|-----------|----------------\n");
-    for (int i = 0; i < cost_count; i++) {
-        printf("%-9s | %-40s | %-9.1f | %-14.1f\n", 
-               cost_breakup[i].operation, cost_breakup[i].description, 
-               cost_breakup[i].node_cost, cost_breakup[i].cumulative_cost);
+// list with item appended unless it is already there, in the node arena
+static const char* append_item(const char *list, const char *item) {
+    char existing[256];
+    for (const char *rest = list; (rest = next_list_item(rest, existing, sizeof(existing))); ) {
+        if (strcmp(existing, item) == 0) return list;
     }
-    printf("----------|------------------------------------------|-----------|----------------\n");
-    printf("Total     |                                          |           | %.1f\n", total_cost);
-    printf("Note: Node Cost is rows * columns (estimate_cost). Cumulative Cost includes selectivity and column ratio adjustments (calculate_total_plan_cost).\n");
+    return arena_printf(get_node_arena(), "%s%s%s", list, *list ? "," : "", item);
 }
 
-// Update optimize_query to include cost breakup
-Node* optimize_query(Node *root) {
-    if (!root) return NULL;
-    
-    printf("\nOptimizing query...\n");
-    
-    init_stats();
-    
-    NodeCost original_breakup[100];
-    NodeCost selection_breakup[100];
-    NodeCost projection_breakup[100];
-    int original_cost_index = 0, selection_cost_index = 0, projection_cost_index = 0;
-    
-    printf("\nOriginal Execution Plan:\n");
-    CostMetrics original_cost = estimate_cost(root);
-    print_execution_plan(root, "Original Plan", original_breakup, &original_cost_index);
-    
-    Node *original_root = duplicate_node(root);
-    
-    Node *selection_optimized = duplicate_node(original_root);
-    CostMetrics selection_cost = {0, 0, 0.0};
-    if (enable_selection_pushdown) {
-        printf("\nApplying selection push-down...\n");
-        selection_optimized = push_down_selections(selection_optimized);
-        selection_cost = estimate_cost(selection_optimized);
-        print_execution_plan(selection_optimized, "Selection Pushdown Plan", selection_breakup, &selection_cost_index);
-    } else {
-        selection_cost = original_cost;
+// Eager aggregation: γ(L ⨝ R) → γ(γp(L) ⨝ R) when every aggregate reads L.
+// γp groups L by the keys it holds and its join column, so each of its groups
+// joins the same R rows its input rows did; the γ above then merges the
+// partial results (counts add up, AVG goes down as SUM and COUNT). Kept when
+// the smaller join input saves more than γp costs, then tried again below γp.
+static void eager_aggregate(Node *aggregate) {
+    Node *join = aggregate->children[0];
+    while (join && join->op == OP_PROJECT) join = join->children[0];
+    if (!join || join->op != OP_JOIN || !join->children[0] || !join->children[1]) return;
+    Predicate *pred = join->pred;
+    if (!pred || pred->next || !is_join_predicate(pred) || pred->op != CMP_EQ) return;
+
+    char item[256], argument[256], partial_item[300];
+    for (int k = 0; k < 2; k++) {
+        Node *side = join->children[k], *other = join->children[1 - k];
+        const ColumnRef *key = subtree_has_relation(side, pred->left.column.table) ? &pred->left.column : &pred->right.column;
+        if (!subtree_has_relation(side, key->table)) continue;
+
+        const char *keys = "", *aggregates = "";
+        int pushable = 1;
+        for (const char *rest = aggregate->arg1; pushable && (rest = next_list_item(rest, item, sizeof(item))); ) {
+            AggFunc func = parse_aggregate(item, argument, sizeof(argument));
+            if (func == AGG_NONE) {
+                // Keys from the other input stay above γp
+                if (column_within(side, item)) keys = append_item(keys, item);
+                else pushable = column_within(other, item);
+                continue;
+            }
+            pushable = column_within(side, argument);
+            if (func == AGG_AVG) {
+                snprintf(partial_item, sizeof(partial_item), "SUM(%s)", argument);
+                aggregates = append_item(aggregates, partial_item);
+                func = AGG_COUNT;
+            }
+            snprintf(partial_item, sizeof(partial_item), "%s(%s)", agg_func_name(func), argument);
+            aggregates = append_item(aggregates, partial_item);
+        }
+        if (!pushable) continue;
+        snprintf(partial_item, sizeof(partial_item), "%s.%s", symbol_name(key->table), symbol_name(key->column));
+        keys = append_item(keys, partial_item);
+        if (*aggregates) keys = arena_printf(get_node_arena(), "%s,%s", keys, aggregates);
+
+        Node *partial = new_node(OP_AGGREGATE, NULL, NULL);
+        partial->arg1 = (char *)keys;
+        partial->children[0] = side;
+        // Only the join node changes; both inputs are shared with the original plan
+        Node *pushed = new_node(OP_JOIN, NULL, NULL);
+        pushed->arg1 = join->arg1;
+        pushed->arg2 = join->arg2;
+        pushed->pred = join->pred;
+        pushed->children[k] = partial;
+        pushed->children[1 - k] = other;
+        Node *candidate = new_node(OP_AGGREGATE, NULL, NULL);
+        candidate->arg1 = aggregate->arg1;
+        candidate->children[0] = pushed;
+        
+        TRACE_COUNT(TRACE_PLANS_CONSIDERED);
+        if (calculate_total_plan_cost(candidate) >= calculate_total_plan_cost(aggregate)) continue;
+        if (debugkaru) printf("[DEBUG] Partial aggregate %s below %s\n", keys, join->arg1);
+        TRACE_COUNT(TRACE_PARTIAL_AGGREGATES);
+        aggregate->children[0] = pushed;
+        aggregate->cost_valid = 0;
+        eager_aggregate(partial);
+        return;
     }
+}
+
+// A query with aggregates: γ's input is planned on its own, as a projection
+// of the group keys and aggregate arguments, before partial aggregates are
+// pushed below its joins. The plan above γ is kept as written.
+static Node* search_aggregate_plan(Node *root, MemoStats *memo, const char **best_plan_name) {
+    Node *plan = duplicate_node(root);
+    Node *aggregate = plan->op == OP_AGGREGATE ? plan : plan->children[0];
     
-    Node *projection_optimized = duplicate_node(original_root);
-    CostMetrics projection_cost = {0, 0, 0.0};
-    if (enable_projection_pushdown) {
-        printf("\nApplying projection push-down...\n");
-        projection_optimized = push_down_projections(projection_optimized);
-        projection_cost = estimate_cost(projection_optimized);
-        print_execution_plan(projection_optimized, "Projection Pushdown Plan", projection_breakup, &projection_cost_index);
-    } else {
-        projection_cost = original_cost;
+    char item[256], argument[256];
+    const char *columns = "";
+    for (const char *rest = aggregate->arg1; (rest = next_list_item(rest, item, sizeof(item))); ) {
+        parse_aggregate(item, argument, sizeof(argument));
+        columns = append_item(columns, argument);
     }
+    Node *input = new_node(OP_PROJECT, NULL, NULL);
+    input->arg1 = (char *)columns;
+    input->children[0] = aggregate->children[0];
+    aggregate->children[0] = search_plan(input, memo, best_plan_name);
+    aggregate->cost_valid = 0;
+    plan->cost_valid = 0;
     
-    double original_total = calculate_total_plan_cost(root);
-    double selection_total = calculate_total_plan_cost(selection_optimized);
-    double projection_total = calculate_total_plan_cost(projection_optimized);
-    
-    Node *best_plan = root;
-    CostMetrics best_cost = original_cost;
-    const char *best_plan_name = "Original";
-    double best_total = original_total;
-    
-    if (selection_total <= best_total) {
-        best_plan = selection_optimized;
-        best_cost = selection_cost;
-        best_plan_name = "Selection Pushdown";
-        best_total = selection_total;
-    } else {
-        free_node(selection_optimized);
+    if (enable_eager_aggregation) eager_aggregate(aggregate);
+    plan->cost_valid = 0;
+    return plan;
+}
+
+// A hash join's Bloom filter is worth building when the probe input is the
+// larger one, is big enough, and most of its rows have no match on the build side
+#define BLOOM_MIN_PROBE_ROWS 10000
+#define BLOOM_MAX_PASS_FRACTION 0.5
+#define BLOOM_FALSE_POSITIVE_RATE 0.001
+
+// Marks the hash joins whose build keys should filter the scan below their
+// probe input. A probe row passes when its key is among the build rows' keys,
+// which happens for about selectivity × build rows of them (1 when every key
+// matches), plus the filter's false positives.
+static void mark_bloom_filters(Node *node) {
+    if (!node) return;
+    mark_bloom_filters(node->children[0]);
+    mark_bloom_filters(node->children[1]);
+    node->bloom_filter = 0;
+    if (node->op != OP_JOIN || !node->children[0] || !node->children[1] || !is_join_predicate(node->pred) ||
+        node->pred->op != CMP_EQ) return;
+
+    // The executor builds on the input estimated to be smaller (ties: the right one)
+    CostMetrics left = estimate_cost(node->children[0]), right = estimate_cost(node->children[1]);
+    CostMetrics build = left.result_size < right.result_size ? left : right;
+    CostMetrics probe = left.result_size < right.result_size ? right : left;
+    if (probe.result_size < BLOOM_MIN_PROBE_ROWS || probe.result_size <= build.result_size) return;
+
+    double passing = fmin(1.0, get_join_selectivity(node) * build.result_size);
+    passing += (1.0 - passing) * BLOOM_FALSE_POSITIVE_RATE;
+    node->bloom_filter = passing < BLOOM_MAX_PASS_FRACTION;
+    if (debugkaru && node->bloom_filter) {
+        printf("[DEBUG] Bloom filter for %s: %.3f of %d probe rows pass\n", node->arg1, passing, probe.result_size);
     }
+}
+
+void plan_bloom_filters(Node *plan) {
+    if (enable_bloom_filters) mark_bloom_filters(plan);
+}
+
+// Turns every σ(column IN (subquery)) into a semi-join, in place, whose right
+// input is the subquery's own best plan. The semi-join is then costed, pushed
+// down and executed like a join that only keeps the matching left rows.
+static void unnest_subqueries(Node *node) {
+    if (!node) return;
+    unnest_subqueries(node->children[0]);
+    unnest_subqueries(node->children[1]);
     
-    if (projection_total <= best_total) {
-        if (best_plan != root) free_node(best_plan);
-        best_plan = projection_optimized;
-        best_cost = projection_cost;
-        best_plan_name = "Projection Pushdown";
-        best_total = projection_total;
-    } else {
-        free_node(projection_optimized);
-    }
+    Predicate *pred = node->pred;
+    if (node->op != OP_SELECT || !pred || pred->op != CMP_IN || pred->left.kind != OPERAND_COLUMN ||
+        pred->right.kind != OPERAND_SUBQUERY || !pred->right.subquery) return;
+    
+    // The predicate keeps the subquery as written: plan copies share it
+    Node *subquery = duplicate_node(pred->right.subquery);
+    unnest_subqueries(subquery);
+    MemoStats memo;
+    const char *name;
+    node->op = OP_SEMIJOIN;
+    node->children[1] = search_plan(subquery, &memo, &name);
+    node->cost_valid = 0;
+    TRACE_COUNT(TRACE_SUBQUERIES_UNNESTED);
+    if (debugkaru) printf("[DEBUG] Unnested '%s' into a semi-join (%s plan)\n", node->arg1, name);
+}
+
+// Explores the query's rewrites in the memo and returns the cheapest plan found
+static Node* choose_plan(Node *root) {
+    if (optimizer_verbose) printf("\nOptimizing query...\n");
+    
+    // Statistics are loaded once and shared by every query after that
+    if (stats_table_count() == 0) init_stats();
+    double traced = trace_begin();
+    bind_predicates(root);
+    trace_end(TRACE_BIND, traced);
+    traced = trace_begin();
+    unnest_subqueries(root);
+    trace_end(TRACE_UNNEST, traced);
     
-    if (best_plan != root) {
-        free_node(original_root);
+    double original_total = calculate_total_plan_cost(root);
+    if (optimizer_verbose) {
+        printf("\nOriginal Execution Plan:\n");
+        print_execution_plan(root, "Original Plan");
     }
     
-    printf("\nCost Comparison:\n");
-    printf("Metric          | Original      | Selection     | Projection    |\n");
-    printf("----------------|---------------|---------------|---------------|\n");
-    printf("Result Size     | %-13d | %-13d | %-13d | \n",
-           original_cost.result_size, selection_cost.result_size, projection_cost.result_size);
-    printf("Columns         | %-13d | %-13d | %-13d |\n",
-           original_cost.num_columns, selection_cost.num_columns, projection_cost.num_columns);
-    printf("Total Cost      | %-13.1f | %-13.1f | %-13.1f |\n",
-           original_total, selection_total, projection_total);
+    MemoStats memo;
+    const char *best_plan_name;
+    Node *best_plan = search_plan(root, &memo, &best_plan_name);
+    plan_bloom_filters(best_plan);
     
-    printf("\n%s is the best plan(lowest cost) with total cost %.1f\n", 
-           best_plan_name, best_total);
-    // Print cost breakups
-    // print_cost_breakup("Original", original_breakup, original_cost_index, original_total);
-    // print_cost_breakup("Selection Pushdown", selection_breakup, selection_cost_index, selection_total);
-    // print_cost_breakup("Projection Pushdown", projection_breakup, projection_cost_index, projection_total);
+    if (!optimizer_verbose) return best_plan;
     
-    // Free allocated descriptions
-    for (int i = 0; i < original_cost_index; i++) free(original_breakup[i].description);
-    for (int i = 0; i < selection_cost_index; i++) free(selection_breakup[i].description);
-    for (int i = 0; i < projection_cost_index; i++) free(projection_breakup[i].description);
+    printf("\nMemo: %d groups, %d expressions (%d selection, %d projection, %d join rewrites), "
+           "%d costed, %d pruned%s\n", memo.groups, memo.expressions, memo.selection_rewrites,
+           memo.projection_rewrites, memo.join_rewrites, memo.costed, memo.pruned,
+           memo.truncated ? ", exploration truncated" : "");
+    printf("Original plan total cost %.1f\n", original_total);
+    printf("\n%s is the best plan(lowest cost) with total cost %.1f\n",
+           best_plan_name, calculate_total_plan_cost(best_plan));
     
-    printf("\nSelected Best Execution Plan (%s):\n",best_plan_name);
-    print_execution_plan(best_plan, "Best Plan", original_breakup, &original_cost_index);
+    printf("\nSelected Best Execution Plan (%s):\n", best_plan_name);
+    print_execution_plan(best_plan, "Best Plan");
     
     return best_plan;
-}
\ No newline at end of file
+}
+
+Node* optimize_query(Node *root) {
+    if (!root) return NULL;
+    double traced = trace_begin();
+    Node *plan = choose_plan(root);
+    trace_end(TRACE_OPTIMIZE, traced);
+    return plan;
+}
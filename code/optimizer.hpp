@@ -11,6 +11,10 @@ typedef struct JoinOrderNode {
     double cost;
     struct JoinOrderNode *left;
     struct JoinOrderNode *right;
+    Node *relation;             // Base input for leaves (table or filtered table)
+    unsigned long long relations; // Bitset of base relations covered by this subtree
+    int result_size;            // Estimated rows produced by this subtree
+    int num_columns;            // Columns produced by this subtree
 } JoinOrderNode;
 
 typedef struct CostMetrics {
@@ -21,15 +25,35 @@ typedef struct CostMetrics {
 
 
 
+// When zero, optimize_query() picks the best plan without printing any of them
+extern int optimizer_verbose;
+
 Node* optimize_query(Node *root);
 
+// Deep copy of a plan's nodes in the current node arena (predicates are shared)
+Node* duplicate_node(Node *node);
+
+// Qualifies unqualified column references in every predicate of the plan
+void bind_predicates(Node *node);
+
 
 Node* push_down_selections(Node *node);
 Node* push_down_projections(Node *node);
 Node* reorder_joins(Node *node);
 
 JoinOrderNode* find_optimal_join_order(Node *join_node);
+void free_join_order(JoinOrderNode *order);
 CostMetrics estimate_cost(Node *node);
+double calculate_total_plan_cost(Node *node);
+
+// Cached cost annotations: one bottom-up pass fills every stale node,
+// rewrites mark the nodes they touch (and their ancestors) stale again
+void annotate_costs(Node *node);
+void invalidate_costs(Node *node);
+
+// Decides which hash joins of a costed plan filter their probe scan with a
+// Bloom filter; cached plans are re-decided after their estimates change
+void plan_bloom_filters(Node *plan);
 
 
 void print_execution_plan(Node *node, const char *title);
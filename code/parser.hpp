@@ -4,18 +4,56 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "symbols.hpp"
+#include "predicate.hpp"
+#include "arena.hpp"
+
+typedef enum OpKind {
+    OP_PROJECT,   // π
+    OP_SELECT,    // σ
+    OP_JOIN,      // ⨝
+    OP_TABLE,     // Base table
+    OP_SEMIJOIN,  // ⋉ column IN (subquery), once the optimizer has unnested it
+    OP_AGGREGATE  // γ hash aggregation: arg1 lists the group keys, then the aggregates
+} OpKind;
+
+#define MAX_CHILDREN 2
 
 typedef struct Node {
-    char *operation;  // e.g., "π", "σ", "⨝", "table", "cond", "expr"
-    char *arg1;       // Column, condition, or value
-    char *arg2;       // Secondary argument (e.g., table name)
-    struct Node *child;  // Child node (e.g., for WHERE or JOIN)
-    struct Node *next;   // For sibling nodes (e.g., join’s left child)
+    OpKind op;
+    Symbol table_id;     // OP_TABLE: table name
+    int cost_valid;      // Cached estimates below are up to date
+    int est_rows;        // Cached estimate_cost() result size
+    int est_columns;     // Cached estimate_cost() column count
+    char *arg1;          // Column list, condition text, or table name
+    char *arg2;          // Secondary argument (e.g., table alias)
+    Predicate *pred;     // OP_SELECT / OP_JOIN / OP_SEMIJOIN: parsed condition (arg1 is its text)
+    int bloom_filter;    // OP_JOIN: the hash join filters its probe-side scan with its build keys
+    struct Node *children[MAX_CHILDREN];  // [0] = input (left input of a join), [1] = right input of a join
+                                          // (a semi-join's subquery plan)
+    double est_cost;     // Cached estimate_cost() cost
+    double total_cost;   // Cached calculate_total_plan_cost() for this subtree
 } Node;
 
-extern Node *root;
-
-Node *new_node(char *op, char *arg1, char *arg2);
+Node *new_node(OpKind op, char *arg1, char *arg2);
+const char *op_symbol(OpKind op);
 void print_tree(Node *node, int depth);
 
-#endif
\ No newline at end of file
+// State of one parse_query() call
+typedef struct ParseContext {
+    Arena *arena;           // Receives the AST and all of its strings
+    int debug;              // Trace tokens and grammar actions on stdout
+    Node *root;             // The statement's AST after a successful parse
+    int error_line;         // Line of the first syntax error (0 = none)
+    char error[128];
+} ParseContext;
+
+// Parses one statement with its own scanner and parser state, so any number
+// of threads can parse at once, each with its own context and arena. Returns
+// the AST, or NULL if the statement has a syntax error (see context->error).
+Node* parse_query(const char *text, ParseContext *context);
+
+// Context for parsing into arena
+void init_parse_context(ParseContext *context, Arena *arena);
+
+#endif
@@ -3,104 +3,136 @@
 #include <stdlib.h>
 #include <string.h>
 #include "parser.hpp"
+#include "arena.hpp"
+#include "predicate.hpp"
+#include "aggregate.hpp"
+%}
 
-void yyerror(const char *s);
-int yylex();
-extern int yylineno;
+%code requires {
+#include "parser.hpp"
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+}
 
-int debug = 0; // Set to 1 to enable debug prints, 0 to disable
+%code {
+int yylex(YYSTYPE *lvalp, yyscan_t scanner);
+int yyget_lineno(yyscan_t scanner);
+void yyerror(yyscan_t scanner, ParseContext *context, const char *s);
+}
 
-%}
+/* No globals: the scanner and the caller's ParseContext travel with every call */
+%define api.pure full
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {ParseContext *context}
 
 %union {
     char *str;
     int num;
     struct Node *node;
+    struct Predicate *pred;
+    struct Operand *operand;
 }
 
-%token SELECT FROM WHERE JOIN INNER ON AND DOT IN
+%token SELECT FROM WHERE JOIN INNER ON AND DOT IN GROUP BY
 %token COUNT MAX MIN AVG
 %token EQ LT GT COMMA SEMICOLON LPAREN RPAREN
-%token <str> IDENTIFIER
+%token <str> IDENTIFIER STRING
 %token <num> NUMBER
 
-%type <node> query select_clause from_clause where_clause join_clause condition expr table_ref subquery
-%type <str> column column_item
+%type <node> query select_clause from_clause where_clause join_clause table_ref subquery
+%type <pred> condition conjunction
+%type <operand> expr
+%type <str> column column_item group_clause
 
 %%
 
 query: select_clause SEMICOLON
     { 
-        if (debug) printf("Parsed query: %s\n", $1->arg1);
-        root = $1;
+        if (context->debug) printf("Parsed query: %s\n", $1->arg1);
+        context->root = $1;
     }
     ;
 
-select_clause: SELECT column FROM from_clause where_clause
+select_clause: SELECT column FROM from_clause where_clause group_clause
     {
-        $$ = new_node("π", $2, NULL);
+        $$ = new_node(OP_PROJECT, $2, NULL);
+        Node *input = $4;
         if ($5) {
-            $5->child = $4;
-            $$->child = $5;
-        } else {
-            $$->child = $4;
+            $5->children[0] = input;
+            input = $5;
+        }
+        // Aggregates are computed by a γ between the π and the rows they read
+        Node *aggregate = new_aggregate_node($2, $6);
+        if (aggregate) {
+            if (context->debug) printf("Aggregate: %s\n", aggregate->arg1);
+            aggregate->children[0] = input;
+            input = aggregate;
         }
+        $$->children[0] = input;
+    }
+    ;
+
+group_clause: GROUP BY column
+    {
+        if (context->debug) printf("Group by: %s\n", $3);
+        $$ = $3;
+    }
+    | /* empty */
+    {
+        $$ = NULL;
     }
     ;
 
 column: column_item
     { 
-        if (debug) printf("Column: %s\n", $1);
+        if (context->debug) printf("Column: %s\n", $1);
         $$ = $1; 
     }
     | column COMMA column_item
     {
-        char *combined = (char *)malloc(strlen($1) + strlen($3) + 2);
+        char *combined = (char *)arena_alloc(context->arena, strlen($1) + strlen($3) + 2);
         sprintf(combined, "%s,%s", $1, $3);
-        if (debug) printf("Combined columns: %s\n", combined);
+        if (context->debug) printf("Combined columns: %s\n", combined);
         $$ = combined;
     }
     ;
 
 column_item: IDENTIFIER
     { 
-        if (debug) printf("Column item: %s\n", $1);
+        if (context->debug) printf("Column item: %s\n", $1);
         $$ = $1; 
     }
     | IDENTIFIER DOT IDENTIFIER
     {
-        char combined[100];
-        sprintf(combined, "%s.%s", $1, $3);
-        if (debug) printf("Column item with dot: %s\n", combined);
-        $$ = strdup(combined);
+        char *combined = arena_printf(context->arena, "%s.%s", $1, $3);
+        if (context->debug) printf("Column item with dot: %s\n", combined);
+        $$ = combined;
     }
     | COUNT LPAREN column_item RPAREN
     {
-        char agg[100];
-        sprintf(agg, "COUNT(%s)", $3);
-        if (debug) printf("Aggregate COUNT: %s\n", agg);
-        $$ = strdup(agg);
+        char *agg = arena_printf(context->arena, "COUNT(%s)", $3);
+        if (context->debug) printf("Aggregate COUNT: %s\n", agg);
+        $$ = agg;
     }
     | MAX LPAREN column_item RPAREN
     {
-        char agg[100];
-        sprintf(agg, "MAX(%s)", $3);
-        if (debug) printf("Aggregate MAX: %s\n", agg);
-        $$ = strdup(agg);
+        char *agg = arena_printf(context->arena, "MAX(%s)", $3);
+        if (context->debug) printf("Aggregate MAX: %s\n", agg);
+        $$ = agg;
     }
     | MIN LPAREN column_item RPAREN
     {
-        char agg[100];
-        sprintf(agg, "MIN(%s)", $3);
-        if (debug) printf("Aggregate MIN: %s\n", agg);
-        $$ = strdup(agg);
+        char *agg = arena_printf(context->arena, "MIN(%s)", $3);
+        if (context->debug) printf("Aggregate MIN: %s\n", agg);
+        $$ = agg;
     }
     | AVG LPAREN column_item RPAREN
     {
-        char agg[100];
-        sprintf(agg, "AVG(%s)", $3);
-        if (debug) printf("Aggregate AVG: %s\n", agg);
-        $$ = strdup(agg);
+        char *agg = arena_printf(context->arena, "AVG(%s)", $3);
+        if (context->debug) printf("Aggregate AVG: %s\n", agg);
+        $$ = agg;
     }
     ;
 
@@ -108,108 +140,120 @@ from_clause: table_ref
     { 
         $$ = $1; 
     }
-    | table_ref join_clause
+    | from_clause join_clause
     {
         $$ = $2; // Set the join node as the root of from_clause
-        $$->child = $1; // Left table as the first child
+        $$->children[0] = $1; // Everything joined so far as the left input (left-deep)
         // Right table is already set in join_clause
     }
     ;
 
 table_ref: IDENTIFIER
     { 
-        if (debug) printf("Table reference: %s\n", $1);
-        $$ = new_node("table", $1, NULL); 
+        if (context->debug) printf("Table reference: %s\n", $1);
+        $$ = new_node(OP_TABLE, $1, NULL); 
     }
     | IDENTIFIER IDENTIFIER
     {
-        if (debug) printf("Table reference with alias: %s as %s\n", $1, $2);
-        $$ = new_node("table", $1, $2); // arg1 = table name, arg2 = alias
+        if (context->debug) printf("Table reference with alias: %s as %s\n", $1, $2);
+        $$ = new_node(OP_TABLE, $1, $2); // arg1 = table name, arg2 = alias
     }
     ;
 
-join_clause: JOIN table_ref ON condition
+join_clause: JOIN table_ref ON conjunction
     {
-        if (debug) printf("Join clause: %s\n", $2->arg1);
-        $$ = new_node("⨝", $4->arg1, NULL); // Join node with condition
-        $$->child = NULL; // Will be set in from_clause
-        $$->next = $2; // Right table as sibling (will be adjusted in from_clause)
+        if (context->debug) printf("Join clause: %s\n", $2->arg1);
+        $$ = new_node(OP_JOIN, NULL, NULL); // Join node with condition
+        $$->arg1 = (char *)conjunction_text($4);
+        $$->pred = $4;
+        $$->children[0] = NULL; // Will be set in from_clause
+        $$->children[1] = $2; // Right table as the right input
     }
     ;
 
-where_clause: WHERE condition
+where_clause: WHERE conjunction
     { 
-        if (debug) printf("Where clause: %s\n", $2->arg1);
-        $$ =new_node("σ", $2->arg1, NULL); 
+        $$ = new_node(OP_SELECT, NULL, NULL);
+        $$->arg1 = (char *)conjunction_text($2);
+        if (context->debug) printf("Where clause: %s\n", $$->arg1);
+        $$->pred = $2;
     }
     | /* empty */
     { 
-        if (debug) printf("Empty where clause\n");
+        if (context->debug) printf("Empty where clause\n");
         $$ = NULL; 
     }
     ;
 
+/* AND-ed comparisons, linked through Predicate.next in the order written */
+conjunction: condition
+    {
+        $$ = $1;
+    }
+    | conjunction AND condition
+    {
+        Predicate *last = $1;
+        while (last->next) last = last->next;
+        last->next = $3;
+        $$ = $1;
+    }
+    ;
+
 condition: expr EQ expr
     {
-        char cond[100];
-        sprintf(cond, "%s = %s", $1->arg1, $3->arg1);
-        if (debug) printf("Condition: %s\n", cond);
-        $$ = new_node("cond", strdup(cond), NULL);
+        $$ = new_predicate($1, CMP_EQ, $3);
+        if (context->debug) printf("Condition: %s\n", $$->text);
     }
     | expr LT expr
     {
-        char cond[100];
-        sprintf(cond, "%s < %s", $1->arg1, $3->arg1);
-        if (debug) printf("Condition: %s\n", cond);
-        $$ = new_node("cond", strdup(cond), NULL);
+        $$ = new_predicate($1, CMP_LT, $3);
+        if (context->debug) printf("Condition: %s\n", $$->text);
     }
     | expr GT expr
     {
-        char cond[100];
-        sprintf(cond, "%s > %s", $1->arg1, $3->arg1);
-        if (debug) printf("Condition: %s\n", cond);
-        $$ = new_node("cond", strdup(cond), NULL);
+        $$ = new_predicate($1, CMP_GT, $3);
+        if (context->debug) printf("Condition: %s\n", $$->text);
     }
     | expr IN LPAREN subquery RPAREN
     {
-        char cond[100];
-        sprintf(cond, "%s IN (subquery)", $1->arg1);
-        if (debug) printf("Condition with subquery: %s\n", cond);
-        $$ = new_node("cond", strdup(cond), NULL);
-        $$->child = $4; // Subquery as child
+        $$ = new_predicate($1, CMP_IN, new_subquery_operand($4));
+        if (context->debug) printf("Condition with subquery: %s\n", $$->text);
     }
     ;
 
 subquery: select_clause
     { 
-        if (debug) printf("Subquery\n");
+        if (context->debug) printf("Subquery\n");
         $$ = $1; 
     }
     ;
 
 expr: IDENTIFIER
     { 
-        if (debug) printf("Expression: %s\n", $1);
-        $$ = new_node("expr", $1, NULL); 
+        if (context->debug) printf("Expression: %s\n", $1);
+        $$ = new_column_operand(NULL, $1);
     }
     | IDENTIFIER DOT IDENTIFIER
     {
-        char combined[100];
-        sprintf(combined, "%s.%s", $1, $3);
-        if (debug) printf("Expression with dot: %s\n", combined);
-        $$ = new_node("expr", strdup(combined), NULL);
+        if (context->debug) printf("Expression with dot: %s.%s\n", $1, $3);
+        $$ = new_column_operand($1, $3);
     }
     | NUMBER
     {
-        char num[20];
-        sprintf(num, "%d", $1);
-        if (debug) printf("Expression with number: %s\n", num);
-        $$ = new_node("expr", strdup(num), NULL);
+        if (context->debug) printf("Expression with number: %d\n", $1);
+        $$ = new_int_operand($1);
+    }
+    | STRING
+    {
+        if (context->debug) printf("Expression with string: %s\n", $1);
+        $$ = new_string_operand($1);
     }
     ;
 
 %%
 
-void yyerror(const char *s) {
-    fprintf(stderr, "Error at line %d: %s\n", yylineno, s);
+void yyerror(yyscan_t scanner, ParseContext *context, const char *s) {
+    if (context->error_line) return;  // Keep the first error
+    context->error_line = yyget_lineno(scanner);
+    snprintf(context->error, sizeof(context->error), "%s", s);
 }
\ No newline at end of file
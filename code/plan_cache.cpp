@@ -0,0 +1,486 @@
+#include "plan_cache.hpp"
+#include "optimizer.hpp"
+#include "stats.hpp"
+#include "arena.hpp"
+#include "trace.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define PLAN_CACHE_BLOCK_SIZE 4096
+#define INITIAL_KEY_CAPACITY 256
+#define INITIAL_CACHE_BUCKETS 64
+
+// A cached plan and everything it points to, owned by one arena so eviction is
+// a single arena_destroy. Entries sit on a hash chain and on the LRU list.
+typedef struct PlanCacheEntry {
+    unsigned long long hash;
+    char *key;
+    size_t key_length;
+    int param_count;
+    Predicate **slots;          // Cached predicate holding each parameter (NULL if optimized away)
+    Node *plan;
+    size_t footprint;
+    Arena arena;
+    struct PlanCacheEntry *bucket_next;
+    struct PlanCacheEntry *lru_prev;    // Towards the most recently used end
+    struct PlanCacheEntry *lru_next;
+} PlanCacheEntry;
+
+static PlanCacheEntry **buckets = NULL;
+static int bucket_count = 0;
+static PlanCacheEntry *lru_head = NULL;    // Most recently used
+static PlanCacheEntry *lru_tail = NULL;    // Next to evict
+static PlanCacheStats cache_stats;
+
+// Guards the table, the LRU list and the counters. Keys are built and plans
+// are optimized and copied into a new entry without it; lookups hold it while
+// copying a plan out so the entry cannot be evicted underneath them.
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ---------------------------------------------------------------------------
+// Fingerprinting
+// ---------------------------------------------------------------------------
+
+static void key_append(PlanKey *key, const char *text, size_t length) {
+    if (key->length + length + 1 > key->capacity) {
+        while (key->length + length + 1 > key->capacity) key->capacity *= 2;
+        key->text = (char *)realloc(key->text, key->capacity);
+    }
+    memcpy(key->text + key->length, text, length);
+    key->length += length;
+    key->text[key->length] = '\0';
+}
+
+static void key_append_str(PlanKey *key, const char *text) {
+    key_append(key, text, strlen(text));
+}
+
+static void key_append_int(PlanKey *key, int value) {
+    char digits[16];
+    key_append(key, digits, snprintf(digits, sizeof(digits), "%d", value));
+}
+
+static void add_param(PlanKey *key, Predicate *pred) {
+    if (key->param_count == key->param_capacity) {
+        key->param_capacity = key->param_capacity ? key->param_capacity * 2 : 8;
+        key->params = (Predicate **)realloc(key->params, key->param_capacity * sizeof(Predicate *));
+    }
+    key->params[key->param_count++] = pred;
+}
+
+static void fingerprint_node(PlanKey *key, Node *node);
+
+// Operands are written with symbol ids; literals on the right become
+// placeholders numbered by their position in key->params
+static void fingerprint_operand(PlanKey *key, const Operand *operand, Predicate *owner) {
+    switch (operand->kind) {
+        case OPERAND_COLUMN:
+            key_append_str(key, "c");
+            key_append_int(key, operand->column.table);
+            key_append_str(key, ".");
+            key_append_int(key, operand->column.column);
+            return;
+        case OPERAND_INT:
+        case OPERAND_STRING:
+            if (owner) {
+                key_append_str(key, operand->kind == OPERAND_INT ? "?i" : "?s");
+                add_param(key, owner);
+            } else if (operand->kind == OPERAND_INT) {
+                key_append_str(key, "i");
+                key_append_int(key, operand->int_value);
+            } else {
+                key_append_str(key, "'");
+                key_append_str(key, operand->str_value);
+                key_append_str(key, "'");
+            }
+            return;
+        case OPERAND_SUBQUERY:
+            key_append_str(key, "(");
+            fingerprint_node(key, operand->subquery);
+            key_append_str(key, ")");
+            return;
+    }
+}
+
+static void fingerprint_node(PlanKey *key, Node *node) {
+    if (!node) {
+        key_append_str(key, "-");
+        return;
+    }
+
+    key_append_str(key, op_symbol(node->op));
+    key_append_str(key, "(");
+    if (node->pred) {
+        for (Predicate *pred = node->pred; pred; pred = pred->next) {
+            if (pred != node->pred) key_append_str(key, "&");
+            fingerprint_operand(key, &pred->left, NULL);
+            key_append_str(key, cmp_op_symbol(pred->op));
+            fingerprint_operand(key, &pred->right, pred);
+        }
+    } else {
+        if (node->arg1) key_append_str(key, node->arg1);
+        if (node->arg2) {
+            key_append_str(key, " ");
+            key_append_str(key, node->arg2);
+        }
+    }
+    key_append_str(key, ")");
+
+    if (node->children[0] || node->children[1]) {
+        key_append_str(key, "[");
+        fingerprint_node(key, node->children[0]);
+        key_append_str(key, ",");
+        fingerprint_node(key, node->children[1]);
+        key_append_str(key, "]");
+    }
+}
+
+void plan_key_build(PlanKey *key, Node *query) {
+    key->capacity = INITIAL_KEY_CAPACITY;
+    key->text = (char *)malloc(key->capacity);
+    key->text[0] = '\0';
+    key->length = 0;
+    key->params = NULL;
+    key->param_count = 0;
+    key->param_capacity = 0;
+    fingerprint_node(key, query);
+
+    // FNV-1a
+    unsigned long long hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < key->length; i++) {
+        hash ^= (unsigned char)key->text[i];
+        hash *= 1099511628211ULL;
+    }
+    key->hash = hash;
+}
+
+void plan_key_free(PlanKey *key) {
+    free(key->text);
+    free(key->params);
+    key->text = NULL;
+    key->params = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Plan copies
+// ---------------------------------------------------------------------------
+
+// State for copying a plan between the query arena and an entry arena. A
+// predicate shared by several nodes (plans share them with the AST) is copied once.
+typedef struct CopyContext {
+    Arena *arena;
+    const Predicate **from;     // Predicates already copied ...
+    Predicate **to;             // ... and their copies
+    int copy_count;
+    int copy_capacity;
+    Predicate **slots;          // Cached predicate holding each parameter
+    Predicate **params;         // The key's predicates holding each parameter
+    int param_count;
+    int substitute;             // 1: cached -> query (take literals from params), 0: query -> cache
+} CopyContext;
+
+static Node* copy_plan(CopyContext *ctx, Node *node, int *dirty);
+
+static void copy_operand_strings(CopyContext *ctx, Operand *operand) {
+    if (operand->kind == OPERAND_STRING) operand->str_value = arena_strdup(ctx->arena, operand->str_value);
+    if (operand->kind == OPERAND_SUBQUERY) {
+        int ignored = 0;
+        operand->subquery = copy_plan(ctx, operand->subquery, &ignored);
+    }
+    if (operand->kind == OPERAND_COLUMN) {
+        // Handles are looked up again in case the catalog was reloaded since caching
+        operand->column.stats = find_column_stats(operand->column.table, operand->column.column);
+    }
+}
+
+static Predicate* copy_predicate(CopyContext *ctx, const Predicate *pred, int *dirty) {
+    for (int i = 0; i < ctx->copy_count; i++) {
+        if (ctx->from[i] == pred) {
+            for (int p = 0; ctx->substitute && p < ctx->param_count; p++) {
+                if (ctx->slots[p] == pred) *dirty = 1;
+            }
+            return ctx->to[i];
+        }
+    }
+
+    Predicate *copy = (Predicate *)arena_alloc(ctx->arena, sizeof(Predicate));
+    *copy = *pred;
+    copy->text = arena_strdup(ctx->arena, pred->text);
+    copy_operand_strings(ctx, &copy->left);
+    copy_operand_strings(ctx, &copy->right);
+    if (pred->next) copy->next = copy_predicate(ctx, pred->next, dirty);
+
+    for (int p = 0; p < ctx->param_count; p++) {
+        if (!ctx->substitute && ctx->params[p] == pred) {
+            ctx->slots[p] = copy;
+        } else if (ctx->substitute && ctx->slots[p] == pred) {
+            // The query's own predicate already lives in the query arena
+            copy->right = ctx->params[p]->right;
+            copy->text = ctx->params[p]->text;
+            *dirty = 1;
+        }
+    }
+
+    if (ctx->copy_count == ctx->copy_capacity) {
+        ctx->copy_capacity = ctx->copy_capacity ? ctx->copy_capacity * 2 : 8;
+        ctx->from = (const Predicate **)realloc(ctx->from, ctx->copy_capacity * sizeof(Predicate *));
+        ctx->to = (Predicate **)realloc(ctx->to, ctx->copy_capacity * sizeof(Predicate *));
+    }
+    ctx->from[ctx->copy_count] = pred;
+    ctx->to[ctx->copy_count] = copy;
+    ctx->copy_count++;
+    return copy;
+}
+
+// Copies a plan keeping its cost annotations; nodes whose predicate takes a new
+// literal, and their ancestors, are marked stale
+static Node* copy_plan(CopyContext *ctx, Node *node, int *dirty) {
+    if (!node) return NULL;
+
+    Node *copy = (Node *)arena_alloc(ctx->arena, sizeof(Node));
+    *copy = *node;
+
+    int stale = 0;
+    copy->children[0] = copy_plan(ctx, node->children[0], &stale);
+    copy->children[1] = copy_plan(ctx, node->children[1], &stale);
+    copy->arg2 = arena_strdup(ctx->arena, node->arg2);
+    if (node->pred) {
+        copy->pred = copy_predicate(ctx, node->pred, &stale);
+        copy->arg1 = node->arg1 == node->pred->text ? (char *)copy->pred->text : arena_strdup(ctx->arena, node->arg1);
+    } else {
+        copy->arg1 = arena_strdup(ctx->arena, node->arg1);
+    }
+
+    if (stale) {
+        copy->cost_valid = 0;
+        *dirty = 1;
+    }
+    return copy;
+}
+
+static void copy_context_init(CopyContext *ctx, Arena *arena, Predicate **slots,
+                              Predicate **params, int param_count, int substitute) {
+    memset(ctx, 0, sizeof(CopyContext));
+    ctx->arena = arena;
+    ctx->slots = slots;
+    ctx->params = params;
+    ctx->param_count = param_count;
+    ctx->substitute = substitute;
+}
+
+static void copy_context_free(CopyContext *ctx) {
+    free(ctx->from);
+    free(ctx->to);
+}
+
+// ---------------------------------------------------------------------------
+// Cache
+// ---------------------------------------------------------------------------
+
+static void free_entry(PlanCacheEntry *entry) {
+    arena_destroy(&entry->arena);
+    free(entry);
+}
+
+static void destroy_locked() {
+    PlanCacheEntry *entry = lru_head;
+    while (entry) {
+        PlanCacheEntry *next = entry->lru_next;
+        free_entry(entry);
+        entry = next;
+    }
+    free(buckets);
+    buckets = NULL;
+    bucket_count = 0;
+    lru_head = lru_tail = NULL;
+    cache_stats.entries = 0;
+    cache_stats.bytes_used = 0;
+}
+
+static void init_locked(size_t budget) {
+    destroy_locked();
+    bucket_count = INITIAL_CACHE_BUCKETS;
+    buckets = (PlanCacheEntry **)calloc(bucket_count, sizeof(PlanCacheEntry *));
+    memset(&cache_stats, 0, sizeof(cache_stats));
+    cache_stats.budget = budget ? budget : PLAN_CACHE_DEFAULT_BUDGET;
+}
+
+void plan_cache_init(size_t budget) {
+    pthread_mutex_lock(&cache_lock);
+    init_locked(budget);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void plan_cache_destroy() {
+    pthread_mutex_lock(&cache_lock);
+    destroy_locked();
+    pthread_mutex_unlock(&cache_lock);
+}
+
+static void lru_unlink(PlanCacheEntry *entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else lru_tail = entry->lru_prev;
+}
+
+static void lru_push_front(PlanCacheEntry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = entry;
+    lru_head = entry;
+    if (!lru_tail) lru_tail = entry;
+}
+
+static PlanCacheEntry* find_entry(const PlanKey *key) {
+    PlanCacheEntry *entry = buckets[key->hash & (bucket_count - 1)];
+    while (entry && (entry->hash != key->hash || entry->key_length != key->length ||
+                     memcmp(entry->key, key->text, key->length) != 0)) {
+        entry = entry->bucket_next;
+    }
+    return entry;
+}
+
+static void evict(PlanCacheEntry *entry) {
+    PlanCacheEntry **link = &buckets[entry->hash & (bucket_count - 1)];
+    while (*link != entry) link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+    lru_unlink(entry);
+
+    cache_stats.bytes_used -= entry->footprint;
+    cache_stats.entries--;
+    cache_stats.evictions++;
+    free_entry(entry);
+}
+
+static void grow_buckets() {
+    int new_count = bucket_count * 2;
+    PlanCacheEntry **new_buckets = (PlanCacheEntry **)calloc(new_count, sizeof(PlanCacheEntry *));
+    for (int i = 0; i < bucket_count; i++) {
+        PlanCacheEntry *entry = buckets[i];
+        while (entry) {
+            PlanCacheEntry *next = entry->bucket_next;
+            entry->bucket_next = new_buckets[entry->hash & (new_count - 1)];
+            new_buckets[entry->hash & (new_count - 1)] = entry;
+            entry = next;
+        }
+    }
+    free(buckets);
+    buckets = new_buckets;
+    bucket_count = new_count;
+}
+
+static size_t arena_footprint(const Arena *arena) {
+    size_t bytes = 0;
+    for (const ArenaBlock *block = arena->head; block; block = block->next) {
+        bytes += sizeof(ArenaBlock) + block->size;
+    }
+    return bytes;
+}
+
+Node* plan_cache_lookup(const PlanKey *key) {
+    pthread_mutex_lock(&cache_lock);
+    if (!buckets) init_locked(0);
+
+    PlanCacheEntry *entry = find_entry(key);
+    if (!entry || entry->param_count != key->param_count) {
+        cache_stats.misses++;
+        pthread_mutex_unlock(&cache_lock);
+        return NULL;
+    }
+    cache_stats.hits++;
+    lru_unlink(entry);
+    lru_push_front(entry);
+
+    CopyContext ctx;
+    copy_context_init(&ctx, get_node_arena(), entry->slots, key->params, key->param_count, 1);
+    int stale = 0;
+    Node *plan = copy_plan(&ctx, entry->plan, &stale);
+    copy_context_free(&ctx);
+    pthread_mutex_unlock(&cache_lock);
+
+    annotate_costs(plan);
+    plan_bloom_filters(plan);
+    return plan;
+}
+
+void plan_cache_insert(const PlanKey *key, Node *plan) {
+    if (!plan) return;
+    annotate_costs(plan);
+
+    PlanCacheEntry *entry = (PlanCacheEntry *)malloc(sizeof(PlanCacheEntry));
+    arena_init(&entry->arena, PLAN_CACHE_BLOCK_SIZE);
+    entry->hash = key->hash;
+    entry->key_length = key->length;
+    entry->key = (char *)arena_alloc(&entry->arena, key->length + 1);
+    memcpy(entry->key, key->text, key->length + 1);
+    entry->param_count = key->param_count;
+    entry->slots = (Predicate **)arena_alloc(&entry->arena, (key->param_count + 1) * sizeof(Predicate *));
+    memset(entry->slots, 0, (key->param_count + 1) * sizeof(Predicate *));
+
+    CopyContext ctx;
+    copy_context_init(&ctx, &entry->arena, entry->slots, key->params, key->param_count, 0);
+    int stale = 0;
+    entry->plan = copy_plan(&ctx, plan, &stale);
+    copy_context_free(&ctx);
+
+    entry->footprint = sizeof(PlanCacheEntry) + arena_footprint(&entry->arena);
+
+    pthread_mutex_lock(&cache_lock);
+    if (!buckets) init_locked(0);
+    // Too big to cache, or another thread cached this shape first
+    if (entry->footprint > cache_stats.budget || find_entry(key)) {
+        pthread_mutex_unlock(&cache_lock);
+        free_entry(entry);
+        return;
+    }
+    while (lru_tail && cache_stats.bytes_used + entry->footprint > cache_stats.budget) {
+        evict(lru_tail);
+    }
+
+    if (cache_stats.entries + 1 > bucket_count) grow_buckets();
+    PlanCacheEntry **bucket = &buckets[entry->hash & (bucket_count - 1)];
+    entry->bucket_next = *bucket;
+    *bucket = entry;
+    lru_push_front(entry);
+    cache_stats.bytes_used += entry->footprint;
+    cache_stats.entries++;
+    pthread_mutex_unlock(&cache_lock);
+}
+
+PlanCacheStats plan_cache_stats() {
+    pthread_mutex_lock(&cache_lock);
+    PlanCacheStats stats = cache_stats;
+    pthread_mutex_unlock(&cache_lock);
+    return stats;
+}
+
+Node* optimize_query_cached(Node *root) {
+    if (!root) return NULL;
+    if (stats_table_count() == 0) init_stats();
+
+    // The key must be built before optimize_query() binds the AST's columns
+    double traced = trace_begin();
+    PlanKey key;
+    plan_key_build(&key, root);
+    Node *plan = plan_cache_lookup(&key);
+    trace_end(TRACE_PLAN_CACHE, traced);
+
+    if (plan) {
+        TRACE_COUNT(TRACE_PLAN_CACHE_HITS);
+        if (optimizer_verbose) {
+            printf("\nPlan cache hit, reusing the plan chosen for this query shape:\n");
+            print_execution_plan(plan, "Best Plan");
+        }
+    } else {
+        plan = optimize_query(root);
+        traced = trace_begin();
+        plan_cache_insert(&key, plan);
+        trace_end(TRACE_PLAN_CACHE, traced);
+    }
+
+    plan_key_free(&key);
+    return plan;
+}
@@ -0,0 +1,56 @@
+#ifndef PLAN_CACHE_H
+#define PLAN_CACHE_H
+
+#include <stddef.h>
+#include "parser.hpp"
+
+#define PLAN_CACHE_DEFAULT_BUDGET (8 * 1024 * 1024)
+
+// Normalized shape of a parsed query: the AST printed with every literal
+// replaced by a placeholder, plus the predicates holding those literals in
+// the order the placeholders appear. Queries that differ only in literals
+// share a key.
+typedef struct PlanKey {
+    char *text;
+    size_t length;
+    size_t capacity;
+    unsigned long long hash;
+    Predicate **params;         // Predicates whose right operand is a literal
+    int param_count;
+    int param_capacity;
+} PlanKey;
+
+typedef struct PlanCacheStats {
+    long hits;
+    long misses;
+    long evictions;
+    long entries;
+    size_t bytes_used;          // Memory held by cached plans
+    size_t budget;              // Least recently used plans are evicted above this
+} PlanCacheStats;
+
+// The cache is shared by all threads; every function below may be called concurrently.
+
+// Starts an empty cache bounded by budget bytes (0 = PLAN_CACHE_DEFAULT_BUDGET)
+void plan_cache_init(size_t budget);
+
+// Drops every cached plan
+void plan_cache_destroy();
+
+// Fingerprints an unbound AST; release the key with plan_key_free()
+void plan_key_build(PlanKey *key, Node *query);
+void plan_key_free(PlanKey *key);
+
+// On a hit returns a copy of the cached plan in the current node arena with this
+// query's literals substituted and only the costs that depend on them recomputed
+Node* plan_cache_lookup(const PlanKey *key);
+
+// Caches a copy of plan, the optimized form of the query the key was built from
+void plan_cache_insert(const PlanKey *key, Node *plan);
+
+PlanCacheStats plan_cache_stats();
+
+// optimize_query() behind the plan cache
+Node* optimize_query_cached(Node *root);
+
+#endif
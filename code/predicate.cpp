@@ -0,0 +1,117 @@
+#include "predicate.hpp"
+#include "arena.hpp"
+#include <stdio.h>
+#include <string.h>
+
+static Operand* new_operand(OperandKind kind) {
+    Operand *operand = (Operand *)arena_alloc(get_node_arena(), sizeof(Operand));
+    memset(operand, 0, sizeof(Operand));
+    operand->kind = kind;
+    operand->column.table = NO_SYMBOL;
+    operand->column.column = NO_SYMBOL;
+    return operand;
+}
+
+Operand* new_column_operand(const char *table, const char *column) {
+    Operand *operand = new_operand(OPERAND_COLUMN);
+    operand->column.table = table ? intern(table) : NO_SYMBOL;
+    operand->column.column = intern(column);
+    return operand;
+}
+
+Operand* new_int_operand(int value) {
+    Operand *operand = new_operand(OPERAND_INT);
+    operand->int_value = value;
+    return operand;
+}
+
+Operand* new_string_operand(const char *value) {
+    Operand *operand = new_operand(OPERAND_STRING);
+    operand->str_value = arena_strdup(get_node_arena(), value);
+    return operand;
+}
+
+Operand* new_subquery_operand(struct Node *subquery) {
+    Operand *operand = new_operand(OPERAND_SUBQUERY);
+    operand->subquery = subquery;
+    return operand;
+}
+
+const char* cmp_op_symbol(CmpOp op) {
+    switch (op) {
+        case CMP_EQ: return "=";
+        case CMP_LT: return "<";
+        case CMP_GT: return ">";
+        case CMP_IN: return "IN";
+    }
+    return "?";
+}
+
+static int format_operand(char *buf, size_t size, const Operand *operand) {
+    switch (operand->kind) {
+        case OPERAND_COLUMN:
+            if (operand->column.table != NO_SYMBOL) {
+                return snprintf(buf, size, "%s.%s", symbol_name(operand->column.table),
+                                symbol_name(operand->column.column));
+            }
+            return snprintf(buf, size, "%s", symbol_name(operand->column.column));
+        case OPERAND_INT:
+            return snprintf(buf, size, "%d", operand->int_value);
+        case OPERAND_STRING:
+            return snprintf(buf, size, "'%s'", operand->str_value);
+        case OPERAND_SUBQUERY:
+            return snprintf(buf, size, "(subquery)");
+    }
+    return 0;
+}
+
+static const char* format_predicate(const Predicate *pred) {
+    // Measure first so long identifiers are never truncated
+    int left_len = format_operand(NULL, 0, &pred->left);
+    int right_len = format_operand(NULL, 0, &pred->right);
+    const char *op = cmp_op_symbol(pred->op);
+    size_t size = left_len + right_len + strlen(op) + 3;
+
+    char *text = (char *)arena_alloc(get_node_arena(), size);
+    int used = format_operand(text, size, &pred->left);
+    used += snprintf(text + used, size - used, " %s ", op);
+    format_operand(text + used, size - used, &pred->right);
+    return text;
+}
+
+Predicate* new_predicate(Operand *left, CmpOp op, Operand *right) {
+    Predicate *pred = (Predicate *)arena_alloc(get_node_arena(), sizeof(Predicate));
+    if (left->kind != OPERAND_COLUMN && right->kind == OPERAND_COLUMN) {
+        pred->left = *right;
+        pred->right = *left;
+        pred->op = op == CMP_LT ? CMP_GT : (op == CMP_GT ? CMP_LT : op);
+    } else {
+        pred->left = *left;
+        pred->right = *right;
+        pred->op = op;
+    }
+    pred->text = format_predicate(pred);
+    pred->next = NULL;
+    return pred;
+}
+
+const char* conjunction_text(const Predicate *pred) {
+    if (!pred->next) return pred->text;
+    size_t size = 1;
+    for (const Predicate *p = pred; p; p = p->next) size += strlen(p->text) + (p->next ? 5 : 0);
+    char *text = (char *)arena_alloc(get_node_arena(), size);
+    size_t used = 0;
+    for (const Predicate *p = pred; p; p = p->next) {
+        used += snprintf(text + used, size - used, "%s%s", p->text, p->next ? " AND " : "");
+    }
+    return text;
+}
+
+int is_join_predicate(const Predicate *pred) {
+    return pred && pred->left.kind == OPERAND_COLUMN && pred->right.kind == OPERAND_COLUMN;
+}
+
+int is_filter_predicate(const Predicate *pred) {
+    return pred && pred->left.kind == OPERAND_COLUMN &&
+           (pred->right.kind == OPERAND_INT || pred->right.kind == OPERAND_STRING);
+}
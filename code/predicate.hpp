@@ -0,0 +1,65 @@
+#ifndef PREDICATE_H
+#define PREDICATE_H
+
+#include "symbols.hpp"
+
+struct Node;
+typedef enum CmpOp {
+    CMP_EQ,     // =
+    CMP_LT,     // <
+    CMP_GT,     // >
+    CMP_IN      // IN (subquery)
+} CmpOp;
+
+typedef enum OperandKind {
+    OPERAND_COLUMN,
+    OPERAND_INT,
+    OPERAND_STRING,
+    OPERAND_SUBQUERY
+} OperandKind;
+
+struct ColumnStats;
+
+typedef struct ColumnRef {
+    Symbol table;       // NO_SYMBOL until bound when the column was written unqualified
+    Symbol column;
+    struct ColumnStats *stats;  // Catalog handle, resolved by bind_predicates
+} ColumnRef;
+
+typedef struct Operand {
+    OperandKind kind;
+    ColumnRef column;           // OPERAND_COLUMN
+    int int_value;              // OPERAND_INT
+    const char *str_value;      // OPERAND_STRING
+    struct Node *subquery;      // OPERAND_SUBQUERY
+} Operand;
+
+// A comparison parsed once from the query text. Column operands always end up
+// on the left: "5 < t.c" is stored as "t.c > 5".
+typedef struct Predicate {
+    Operand left;
+    CmpOp op;
+    Operand right;
+    const char *text;           // Printable form, e.g. "employees.salary > 50000"
+    struct Predicate *next;     // Next conjunct of an AND chain (NULL once bind_predicates split it)
+} Predicate;
+
+// Constructors allocate from the current node arena
+Operand* new_column_operand(const char *table, const char *column);
+Operand* new_int_operand(int value);
+Operand* new_string_operand(const char *value);
+Operand* new_subquery_operand(struct Node *subquery);
+Predicate* new_predicate(Operand *left, CmpOp op, Operand *right);
+
+const char* cmp_op_symbol(CmpOp op);
+
+// Printable form of an AND chain, e.g. "t.a > 5 AND t.b = 2"
+const char* conjunction_text(const Predicate *pred);
+
+// Column = column comparison between two tables
+int is_join_predicate(const Predicate *pred);
+
+// Column compared against a literal
+int is_filter_predicate(const Predicate *pred);
+
+#endif
@@ -3,4 +3,5 @@ SELECT employees.name, departments.dept_name FROM employees JOIN departments ON
 SELECT employees.name, departments.dept_name FROM employees JOIN departments ON employees.dept_id = departments.dept_id WHERE departments.dept_name = 'Engineering';
 SELECT employees.name, salaries.salary FROM employees JOIN salaries ON employees.emp_id = salaries.emp_id WHERE salaries.salary > 50000;
 SELECT departments.dept_name, employees.salary FROM employees JOIN departments ON employees.dept_id = departments.dept_id WHERE departments.dept_name  = "ARTS";
-SELECT departments.dept_name, projects.dept_id FROM projects JOIN departments ON projects.dept_id = departments.dept_id WHERE projects.budget > 100000;
\ No newline at end of file
+SELECT departments.dept_name, projects.dept_id FROM projects JOIN departments ON projects.dept_id = departments.dept_id WHERE projects.budget > 100000;
+SELECT employees.name, projects.project_name FROM employees JOIN salaries ON employees.emp_id = salaries.emp_id JOIN departments ON employees.dept_id = departments.dept_id JOIN projects ON projects.dept_id = departments.dept_id AND projects.budget = salaries.salary WHERE salaries.year > 2020 AND departments.location = 'Boston' AND projects.budget > 100000;
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "scheduler.hpp"
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// Morsels [head, tail) still queued on one worker; the owner pops at head,
+// thieves at tail. Padded so neighbouring queues do not share a cache line.
+typedef struct WorkerQueue {
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+    char padding[64];
+} WorkerQueue;
+
+static struct {
+    int thread_count;           // Configured workers, including the caller (0 = not set yet)
+    int started;                // Workers whose threads are running
+    pthread_t *threads;
+    WorkerQueue *queues;
+    pthread_mutex_t lock;       // Guards everything below
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    unsigned long generation;   // Bumped once per run
+    int active;                 // Pool threads still working on the current run
+    int stopping;
+    MorselTask task;
+    void *context;
+} pool = {0, 0, NULL, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+          0, 0, 0, NULL, NULL};
+
+static int take_morsel(int worker) {
+    WorkerQueue *own = &pool.queues[worker];
+    int morsel = -1;
+    pthread_mutex_lock(&own->lock);
+    if (own->head < own->tail) morsel = own->head++;
+    pthread_mutex_unlock(&own->lock);
+    if (morsel >= 0) return morsel;
+
+    for (int i = 1; i < pool.started && morsel < 0; i++) {
+        WorkerQueue *victim = &pool.queues[(worker + i) % pool.started];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail) morsel = --victim->tail;
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return morsel;
+}
+
+// Morsels are only ever removed during a run, so once every queue is empty the
+// worker has nothing left to do
+static void work(int worker) {
+    int morsel;
+    while ((morsel = take_morsel(worker)) >= 0) pool.task(pool.context, worker, morsel);
+}
+
+static void* worker_main(void *arg) {
+    int worker = (int)(long)arg;
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.generation == seen && !pool.stopping) pthread_cond_wait(&pool.wake, &pool.lock);
+        if (pool.stopping) break;
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        work(worker);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.active == 0) pthread_cond_signal(&pool.done);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static void start_pool() {
+    int threads = scheduler_threads();
+    pool.queues = (WorkerQueue *)calloc(threads, sizeof(WorkerQueue));
+    for (int w = 0; w < threads; w++) pthread_mutex_init(&pool.queues[w].lock, NULL);
+    pool.threads = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    pool.stopping = 0;
+    pool.started = threads;
+    for (int w = 1; w < threads; w++) pthread_create(&pool.threads[w], NULL, worker_main, (void *)(long)w);
+}
+
+void scheduler_set_threads(int threads) {
+    if (threads < 1) threads = 1;
+    if (threads == pool.thread_count) return;
+    scheduler_shutdown();
+    pool.thread_count = threads;
+}
+
+int scheduler_threads() {
+    if (pool.thread_count == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        pool.thread_count = cpus > 0 ? (int)cpus : 1;
+    }
+    return pool.thread_count;
+}
+
+void scheduler_run(int morsel_count, MorselTask task, void *context) {
+    if (morsel_count <= 0) return;
+    if (scheduler_threads() == 1 || morsel_count == 1) {
+        for (int m = 0; m < morsel_count; m++) task(context, 0, m);
+        return;
+    }
+    if (!pool.started) start_pool();
+
+    int threads = pool.started;
+    for (int w = 0; w < threads; w++) {
+        pool.queues[w].head = (int)((long long)morsel_count * w / threads);
+        pool.queues[w].tail = (int)((long long)morsel_count * (w + 1) / threads);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.task = task;
+    pool.context = context;
+    pool.active = threads - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    work(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.active > 0) pthread_cond_wait(&pool.done, &pool.lock);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+void scheduler_shutdown() {
+    if (!pool.started) return;
+    pthread_mutex_lock(&pool.lock);
+    pool.stopping = 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+    for (int w = 1; w < pool.started; w++) pthread_join(pool.threads[w], NULL);
+    for (int w = 0; w < pool.started; w++) pthread_mutex_destroy(&pool.queues[w].lock);
+    free(pool.threads);
+    free(pool.queues);
+    pool.threads = NULL;
+    pool.queues = NULL;
+    pool.started = 0;
+}
@@ -0,0 +1,22 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Work-stealing thread pool for morsel-driven execution. A run hands out the
+// morsels [0, morsel_count) in contiguous blocks, one block per worker; a
+// worker takes its own morsels front to back and, once they are gone, steals
+// from the back of other workers' blocks. The calling thread is worker 0.
+
+typedef void (*MorselTask)(void *context, int worker, int morsel);
+
+// Workers used by later runs (default: one per online CPU)
+void scheduler_set_threads(int threads);
+int scheduler_threads();
+
+// Runs task for every morsel and returns once all of them have finished.
+// Tasks must not call scheduler_run themselves.
+void scheduler_run(int morsel_count, MorselTask task, void *context);
+
+// Stops the pool's threads; the next run starts them again
+void scheduler_shutdown();
+
+#endif
@@ -0,0 +1,347 @@
+#include "server.hpp"
+#include "parser.hpp"
+#include "optimizer.hpp"
+#include "plan_cache.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVER_QUEUE_CAPACITY 256       // Accepted connections waiting for a worker
+#define SERVER_READ_SIZE 4096
+#define SERVER_MAX_LINE (1 << 20)       // Longer requests are refused and the connection closed
+
+static volatile sig_atomic_t stop_requested = 0;
+static int serve_with_cache = 1;
+static long request_count = 0;
+static long error_count = 0;
+
+// ---------------------------------------------------------------------------
+// Responses
+// ---------------------------------------------------------------------------
+
+typedef struct OutBuffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+} OutBuffer;
+
+static void out_append(OutBuffer *out, const char *text, size_t length) {
+    if (out->length + length + 1 > out->capacity) {
+        while (out->length + length + 1 > out->capacity) out->capacity = out->capacity ? out->capacity * 2 : 1024;
+        out->data = (char *)realloc(out->data, out->capacity);
+    }
+    memcpy(out->data + out->length, text, length);
+    out->length += length;
+    out->data[out->length] = '\0';
+}
+
+static void out_printf(OutBuffer *out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void out_printf(OutBuffer *out, const char *format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    out_append(out, text, length < (int)sizeof(text) ? length : sizeof(text) - 1);
+}
+
+static void out_json_string(OutBuffer *out, const char *text) {
+    out_append(out, "\"", 1);
+    for (const unsigned char *p = (const unsigned char *)(text ? text : ""); *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            char escaped[2] = {'\\', (char)*p};
+            out_append(out, escaped, 2);
+        } else if (*p < 0x20) {
+            out_printf(out, "\\u%04x", *p);
+        } else {
+            out_append(out, (const char *)p, 1);
+        }
+    }
+    out_append(out, "\"", 1);
+}
+
+static const char* op_name(OpKind op) {
+    switch (op) {
+        case OP_PROJECT: return "project";
+        case OP_SELECT:  return "select";
+        case OP_JOIN:    return "join";
+        case OP_TABLE:   return "table";
+        case OP_SEMIJOIN: return "semijoin";
+        case OP_AGGREGATE: return "aggregate";
+    }
+    return "?";
+}
+
+static void out_plan(OutBuffer *out, Node *node) {
+    CostMetrics cost = estimate_cost(node);
+    out_printf(out, "{\"op\":\"%s\",\"arg\":", op_name(node->op));
+    out_json_string(out, node->arg1);
+    out_printf(out, ",\"rows\":%d,\"cost\":%.1f", cost.result_size, cost.cost);
+    if (node->children[0] || node->children[1]) {
+        out_append(out, ",\"in\":[", 7);
+        int first = 1;
+        for (int i = 0; i < MAX_CHILDREN; i++) {
+            if (!node->children[i]) continue;
+            if (!first) out_append(out, ",", 1);
+            out_plan(out, node->children[i]);
+            first = 0;
+        }
+        out_append(out, "]", 1);
+    }
+    out_append(out, "}", 1);
+}
+
+static double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Answers one request line; the caller's node arena holds the query and is reset afterwards
+static void handle_request(char *line, Arena *arena, OutBuffer *out) {
+    if (strcmp(line, "STATS") == 0) {
+        PlanCacheStats cache = plan_cache_stats();
+        out_printf(out, "{\"ok\":true,\"requests\":%ld,\"errors\":%ld,\"cache_hits\":%ld,\"cache_misses\":%ld,"
+                   "\"cache_entries\":%ld,\"cache_bytes\":%zu}\n",
+                   __atomic_load_n(&request_count, __ATOMIC_RELAXED), __atomic_load_n(&error_count, __ATOMIC_RELAXED),
+                   cache.hits, cache.misses, cache.entries, cache.bytes_used);
+        return;
+    }
+    __atomic_fetch_add(&request_count, 1, __ATOMIC_RELAXED);
+
+    // The terminating semicolon is optional on the wire
+    size_t length = strlen(line);
+    const char *text = line;
+    if (line[length - 1] != ';') text = arena_printf(arena, "%s;", line);
+
+    trace_query_begin(text);
+    double start = now_us();
+    ParseContext parse;
+    init_parse_context(&parse, arena);
+    Node *root = parse_query(text, &parse);
+    if (!root) {
+        trace_query_end();
+        __atomic_fetch_add(&error_count, 1, __ATOMIC_RELAXED);
+        out_printf(out, "{\"ok\":false,\"line\":%d,\"error\":", parse.error_line);
+        out_json_string(out, parse.error_line ? parse.error : "no statement");
+        out_append(out, "}\n", 2);
+        return;
+    }
+
+    Node *plan = serve_with_cache ? optimize_query_cached(root) : optimize_query(root);
+    double elapsed = now_us() - start;
+    trace_query_end();
+
+    out_printf(out, "{\"ok\":true,\"cost\":%.1f,\"rows\":%d,\"us\":%.1f,\"plan\":",
+               calculate_total_plan_cost(plan), estimate_cost(plan).result_size, elapsed);
+    out_plan(out, plan);
+    out_append(out, "}\n", 2);
+}
+
+static int write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+// Serves request lines from in_fd until end of input. Every complete line read
+// so far is answered before the next read, so pipelined requests are batched
+// into one write. A line over SERVER_MAX_LINE bytes gets an error and ends the
+// stream.
+static void serve_stream(int in_fd, int out_fd, Arena *arena) {
+    size_t capacity = SERVER_READ_SIZE, used = 0;
+    char *buffer = (char *)malloc(capacity);
+    OutBuffer out = {NULL, 0, 0};
+
+    for (;;) {
+        if (used + SERVER_READ_SIZE > capacity) {
+            capacity *= 2;
+            buffer = (char *)realloc(buffer, capacity);
+        }
+        ssize_t received = read(in_fd, buffer + used, capacity - used);
+        if (received < 0 && errno == EINTR) {
+            if (stop_requested) break;
+            continue;
+        }
+        if (received <= 0) break;
+        used += received;
+
+        out.length = 0;
+        char *line = buffer, *newline;
+        while ((newline = (char *)memchr(line, '\n', used - (line - buffer)))) {
+            *newline = '\0';
+            if (newline > line && newline[-1] == '\r') newline[-1] = '\0';
+            while (*line == ' ' || *line == '\t') line++;
+            if (*line) {
+                handle_request(line, arena, &out);
+                arena_reset(arena);
+            }
+            line = newline + 1;
+        }
+        used -= line - buffer;
+        memmove(buffer, line, used);
+        int too_long = used > SERVER_MAX_LINE;
+        if (too_long) {
+            __atomic_fetch_add(&request_count, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&error_count, 1, __ATOMIC_RELAXED);
+            out_printf(&out, "{\"ok\":false,\"error\":\"request longer than %d bytes\"}\n", SERVER_MAX_LINE);
+        }
+        if (out.length > 0 && write_all(out_fd, out.data, out.length) < 0) break;
+        if (too_long) break;
+    }
+    free(buffer);
+    free(out.data);
+}
+
+// ---------------------------------------------------------------------------
+// Worker pool
+// ---------------------------------------------------------------------------
+
+static struct {
+    int fds[SERVER_QUEUE_CAPACITY];
+    int head;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} connections = {{0}, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static void* worker_main(void *arg) {
+    (void)arg;
+    Arena arena;
+    arena_init(&arena, ARENA_DEFAULT_BLOCK_SIZE);
+    set_node_arena(&arena);
+
+    for (;;) {
+        pthread_mutex_lock(&connections.lock);
+        while (connections.count == 0) pthread_cond_wait(&connections.ready, &connections.lock);
+        int fd = connections.fds[connections.head];
+        connections.head = (connections.head + 1) % SERVER_QUEUE_CAPACITY;
+        connections.count--;
+        pthread_mutex_unlock(&connections.lock);
+
+        serve_stream(fd, fd, &arena);
+        close(fd);
+    }
+    return NULL;
+}
+
+// Queues an accepted connection; refuses it when every slot is taken
+static void enqueue_connection(int fd) {
+    pthread_mutex_lock(&connections.lock);
+    if (connections.count == SERVER_QUEUE_CAPACITY) {
+        pthread_mutex_unlock(&connections.lock);
+        close(fd);
+        return;
+    }
+    connections.fds[(connections.head + connections.count) % SERVER_QUEUE_CAPACITY] = fd;
+    connections.count++;
+    pthread_cond_signal(&connections.ready);
+    pthread_mutex_unlock(&connections.lock);
+}
+
+static void on_stop_signal(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+int run_server(const char *socket_path, int workers, int use_plan_cache) {
+    optimizer_verbose = 0;
+    serve_with_cache = use_plan_cache;
+    signal(SIGPIPE, SIG_IGN);
+
+    // Protocol output gets its own descriptor; anything else printed to
+    // stdout (statistics loading, diagnostics) goes to stderr instead
+    int protocol_fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    init_stats();
+    if (use_plan_cache) plan_cache_init(PLAN_CACHE_DEFAULT_BUDGET);
+
+    if (strcmp(socket_path, "-") == 0) {
+        Arena arena;
+        arena_init(&arena, ARENA_DEFAULT_BLOCK_SIZE);
+        set_node_arena(&arena);
+        serve_stream(STDIN_FILENO, protocol_fd, &arena);
+        arena_destroy(&arena);
+        close(protocol_fd);
+        return 0;
+    }
+    close(protocol_fd);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(listen_fd, SERVER_QUEUE_CAPACITY) < 0) {
+        perror(socket_path);
+        return 1;
+    }
+
+    // No SA_RESTART: a signal has to interrupt accept()
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    // Workers inherit a mask blocking both signals, so they are delivered to
+    // this thread
+    sigset_t stop_signals, previous;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &previous);
+    if (workers < 1) workers = 1;
+    for (int w = 0; w < workers; w++) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, worker_main, NULL);
+        pthread_detach(thread);
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    fprintf(stderr, "Listening on %s with %d workers\n", socket_path, workers);
+
+    while (!stop_requested) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
+        enqueue_connection(fd);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    PlanCacheStats cache = plan_cache_stats();
+    fprintf(stderr, "Served %ld requests (%ld errors), plan cache %ld hits / %ld misses\n",
+            __atomic_load_n(&request_count, __ATOMIC_RELAXED), __atomic_load_n(&error_count, __ATOMIC_RELAXED),
+            cache.hits, cache.misses);
+    // Workers may still be inside a connection; exiting the process ends them
+    return 0;
+}
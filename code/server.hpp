@@ -0,0 +1,22 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+// Optimizer daemon. Statistics and the plan cache are loaded once; clients
+// then send one SQL statement per line and get one JSON object per line back:
+//
+//   {"ok":true,"cost":1234.0,"rows":733,"us":41.2,"plan":{"op":"project",
+//    "arg":"name","rows":733,"cost":733.0,"in":[...]}}
+//   {"ok":false,"line":1,"error":"syntax error"}
+//
+// A request line over 1 MB is answered with an error and the connection closed.
+//
+// "us" is the time spent parsing and optimizing the statement. The line STATS
+// returns request and plan cache counters instead.
+//
+// socket_path names a Unix domain socket served by `workers` threads, each
+// handling one connection at a time; "-" serves stdin/stdout on the calling
+// thread. Runs until SIGINT or SIGTERM (or end of input) and returns the exit
+// status.
+int run_server(const char *socket_path, int workers, int use_plan_cache);
+
+#endif
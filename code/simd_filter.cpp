@@ -0,0 +1,303 @@
+#include "simd_filter.hpp"
+#include "colfile.hpp"
+#include <immintrin.h>
+
+// Kernels compare one block of 64 values into a 64-bit match mask; the drivers
+// below walk a column block by block and finish the tail with the scalar code.
+typedef unsigned long long (*MaskI64Fn)(const long long *values, CmpOp op, long long constant);
+typedef unsigned long long (*MaskI32Fn)(const int *values, CmpOp op, int constant);
+
+static MaskI64Fn mask_i64 = NULL;
+static MaskI32Fn mask_i32 = NULL;
+static FilterIsa active_isa = FILTER_SCALAR;
+
+// ---------------------------------------------------------------------------
+// Scalar
+// ---------------------------------------------------------------------------
+
+static inline unsigned long long match(long long value, CmpOp op, long long constant) {
+    switch (op) {
+        case CMP_EQ: return value == constant;
+        case CMP_LT: return value < constant;
+        case CMP_GT: return value > constant;
+        case CMP_IN: return 0;
+    }
+    return 0;
+}
+
+// NULL int64 values (COLFILE_NULL) match no comparison
+static inline unsigned long long match_i64(long long value, CmpOp op, long long constant) {
+    return (unsigned long long)(value != COLFILE_NULL) & match(value, op, constant);
+}
+
+static unsigned long long mask_i64_tail(const long long *values, int count, CmpOp op, long long constant) {
+    unsigned long long mask = 0;
+    for (int i = 0; i < count; i++) mask |= match_i64(values[i], op, constant) << i;
+    return mask;
+}
+
+static unsigned long long mask_i32_tail(const int *values, int count, CmpOp op, int constant) {
+    unsigned long long mask = 0;
+    for (int i = 0; i < count; i++) mask |= match(values[i], op, constant) << i;
+    return mask;
+}
+
+static unsigned long long mask_i64_scalar(const long long *values, CmpOp op, long long constant) {
+    return mask_i64_tail(values, 64, op, constant);
+}
+
+static unsigned long long mask_i32_scalar(const int *values, CmpOp op, int constant) {
+    return mask_i32_tail(values, 64, op, constant);
+}
+
+// ---------------------------------------------------------------------------
+// SSE4.2: 2 x int64 or 4 x int32 per compare
+// ---------------------------------------------------------------------------
+
+// NULL is the smallest int64, so only = and < can match it; they also require
+// values > NULL
+__attribute__((target("sse4.2")))
+static inline __m128i compare_i64_sse42(__m128i values, __m128i constant, CmpOp op) {
+    __m128i not_null = _mm_cmpgt_epi64(values, _mm_set1_epi64x(COLFILE_NULL));
+    switch (op) {
+        case CMP_EQ: return _mm_and_si128(_mm_cmpeq_epi64(values, constant), not_null);
+        case CMP_LT: return _mm_and_si128(_mm_cmpgt_epi64(constant, values), not_null);
+        case CMP_GT: return _mm_cmpgt_epi64(values, constant);
+        case CMP_IN: break;
+    }
+    return _mm_setzero_si128();
+}
+
+__attribute__((target("sse4.2")))
+static unsigned long long mask_i64_sse42(const long long *values, CmpOp op, long long constant) {
+    __m128i broadcast = _mm_set1_epi64x(constant);
+    unsigned long long mask = 0;
+    for (int i = 0; i < 64; i += 2) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(values + i));
+        __m128i hits = compare_i64_sse42(chunk, broadcast, op);
+        mask |= (unsigned long long)_mm_movemask_pd(_mm_castsi128_pd(hits)) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("sse4.2")))
+static inline __m128i compare_i32_sse42(__m128i values, __m128i constant, CmpOp op) {
+    switch (op) {
+        case CMP_EQ: return _mm_cmpeq_epi32(values, constant);
+        case CMP_LT: return _mm_cmplt_epi32(values, constant);
+        case CMP_GT: return _mm_cmpgt_epi32(values, constant);
+        case CMP_IN: break;
+    }
+    return _mm_setzero_si128();
+}
+
+__attribute__((target("sse4.2")))
+static unsigned long long mask_i32_sse42(const int *values, CmpOp op, int constant) {
+    __m128i broadcast = _mm_set1_epi32(constant);
+    unsigned long long mask = 0;
+    for (int i = 0; i < 64; i += 4) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(values + i));
+        __m128i hits = compare_i32_sse42(chunk, broadcast, op);
+        mask |= (unsigned long long)_mm_movemask_ps(_mm_castsi128_ps(hits)) << i;
+    }
+    return mask;
+}
+
+// ---------------------------------------------------------------------------
+// AVX2: 4 x int64 or 8 x int32 per compare
+// ---------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static inline __m256i compare_i64_avx2(__m256i values, __m256i constant, CmpOp op) {
+    __m256i not_null = _mm256_cmpgt_epi64(values, _mm256_set1_epi64x(COLFILE_NULL));
+    switch (op) {
+        case CMP_EQ: return _mm256_and_si256(_mm256_cmpeq_epi64(values, constant), not_null);
+        case CMP_LT: return _mm256_and_si256(_mm256_cmpgt_epi64(constant, values), not_null);
+        case CMP_GT: return _mm256_cmpgt_epi64(values, constant);
+        case CMP_IN: break;
+    }
+    return _mm256_setzero_si256();
+}
+
+__attribute__((target("avx2")))
+static unsigned long long mask_i64_avx2(const long long *values, CmpOp op, long long constant) {
+    __m256i broadcast = _mm256_set1_epi64x(constant);
+    unsigned long long mask = 0;
+    for (int i = 0; i < 64; i += 4) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(values + i));
+        __m256i hits = compare_i64_avx2(chunk, broadcast, op);
+        mask |= (unsigned long long)_mm256_movemask_pd(_mm256_castsi256_pd(hits)) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i compare_i32_avx2(__m256i values, __m256i constant, CmpOp op) {
+    switch (op) {
+        case CMP_EQ: return _mm256_cmpeq_epi32(values, constant);
+        case CMP_LT: return _mm256_cmpgt_epi32(constant, values);
+        case CMP_GT: return _mm256_cmpgt_epi32(values, constant);
+        case CMP_IN: break;
+    }
+    return _mm256_setzero_si256();
+}
+
+__attribute__((target("avx2")))
+static unsigned long long mask_i32_avx2(const int *values, CmpOp op, int constant) {
+    __m256i broadcast = _mm256_set1_epi32(constant);
+    unsigned long long mask = 0;
+    for (int i = 0; i < 64; i += 8) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(values + i));
+        __m256i hits = compare_i32_avx2(chunk, broadcast, op);
+        mask |= (unsigned long long)_mm256_movemask_ps(_mm256_castsi256_ps(hits)) << i;
+    }
+    return mask;
+}
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+static FilterIsa detect_isa() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return FILTER_AVX2;
+    if (__builtin_cpu_supports("sse4.2")) return FILTER_SSE42;
+    return FILTER_SCALAR;
+}
+
+static void select_kernels(FilterIsa limit) {
+    FilterIsa isa = detect_isa();
+    if (isa > limit) isa = limit;
+    switch (isa) {
+        case FILTER_AVX2:
+            mask_i64 = mask_i64_avx2;
+            mask_i32 = mask_i32_avx2;
+            break;
+        case FILTER_SSE42:
+            mask_i64 = mask_i64_sse42;
+            mask_i32 = mask_i32_sse42;
+            break;
+        case FILTER_SCALAR:
+            mask_i64 = mask_i64_scalar;
+            mask_i32 = mask_i32_scalar;
+            break;
+    }
+    active_isa = isa;
+}
+
+static void ensure_kernels() {
+    // Function-local static initialization runs exactly once, even across threads
+    static const int initialized = (select_kernels(FILTER_AVX2), 1);
+    (void)initialized;
+}
+
+FilterIsa filter_isa() {
+    ensure_kernels();
+    return active_isa;
+}
+
+const char* filter_isa_name(FilterIsa isa) {
+    switch (isa) {
+        case FILTER_SCALAR: return "scalar";
+        case FILTER_SSE42:  return "sse4.2";
+        case FILTER_AVX2:   return "avx2";
+    }
+    return "?";
+}
+
+void filter_force_isa(FilterIsa isa) {
+    ensure_kernels();
+    select_kernels(isa);
+}
+
+// ---------------------------------------------------------------------------
+// Drivers
+// ---------------------------------------------------------------------------
+
+// Appends base + position of every set bit of mask
+static inline int expand_mask(unsigned long long mask, int base, int *out) {
+    int count = 0;
+    while (mask) {
+        out[count++] = base + __builtin_ctzll(mask);
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+void filter_i64_bitmap(const long long *values, int n, CmpOp op, long long constant, unsigned long long *bitmap) {
+    ensure_kernels();
+    int blocks = n / 64;
+    for (int b = 0; b < blocks; b++) bitmap[b] = mask_i64(values + b * 64, op, constant);
+    if (n % 64) bitmap[blocks] = mask_i64_tail(values + blocks * 64, n % 64, op, constant);
+}
+
+void filter_i32_bitmap(const int *values, int n, CmpOp op, int constant, unsigned long long *bitmap) {
+    ensure_kernels();
+    int blocks = n / 64;
+    for (int b = 0; b < blocks; b++) bitmap[b] = mask_i32(values + b * 64, op, constant);
+    if (n % 64) bitmap[blocks] = mask_i32_tail(values + blocks * 64, n % 64, op, constant);
+}
+
+int filter_i64_select(const long long *values, int n, CmpOp op, long long constant, int *out) {
+    ensure_kernels();
+    int blocks = n / 64, count = 0;
+    for (int b = 0; b < blocks; b++) count += expand_mask(mask_i64(values + b * 64, op, constant), b * 64, out + count);
+    if (n % 64) count += expand_mask(mask_i64_tail(values + blocks * 64, n % 64, op, constant), blocks * 64, out + count);
+    return count;
+}
+
+int filter_i32_select(const int *values, int n, CmpOp op, int constant, int *out) {
+    ensure_kernels();
+    int blocks = n / 64, count = 0;
+    for (int b = 0; b < blocks; b++) count += expand_mask(mask_i32(values + b * 64, op, constant), b * 64, out + count);
+    if (n % 64) count += expand_mask(mask_i32_tail(values + blocks * 64, n % 64, op, constant), blocks * 64, out + count);
+    return count;
+}
+
+static inline unsigned long long conjunction_mask(const FilterTerm *terms, int term_count, int base, int count) {
+    unsigned long long mask = count == 64 ? ~0ULL : (1ULL << count) - 1;
+    for (int t = 0; t < term_count; t++) {
+        const long long *values = terms[t].values + base;
+        mask &= count == 64 ? mask_i64(values, terms[t].op, terms[t].constant)
+                            : mask_i64_tail(values, count, terms[t].op, terms[t].constant);
+    }
+    return mask;
+}
+
+void filter_conjunction_bitmap(const FilterTerm *terms, int term_count, int n, unsigned long long *bitmap) {
+    ensure_kernels();
+    for (int base = 0; base < n; base += 64) {
+        bitmap[base / 64] = conjunction_mask(terms, term_count, base, n - base < 64 ? n - base : 64);
+    }
+}
+
+int filter_conjunction_select(const FilterTerm *terms, int term_count, int n, int *out) {
+    ensure_kernels();
+    int count = 0;
+    for (int base = 0; base < n; base += 64) {
+        count += expand_mask(conjunction_mask(terms, term_count, base, n - base < 64 ? n - base : 64), base, out + count);
+    }
+    return count;
+}
+
+int filter_conjunction_refine(const FilterTerm *terms, int term_count, const int *in, int n, int *out) {
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        int row = in[i];
+        unsigned long long keep = 1;
+        for (int t = 0; t < term_count; t++) keep &= match_i64(terms[t].values[row], terms[t].op, terms[t].constant);
+        out[count] = row;
+        count += (int)keep;
+    }
+    return count;
+}
+
+int bitmap_to_selection(const unsigned long long *bitmap, int n, int *out) {
+    int count = 0;
+    for (int base = 0; base < n; base += 64) {
+        unsigned long long mask = bitmap[base / 64];
+        if (n - base < 64) mask &= (1ULL << (n - base)) - 1;
+        count += expand_mask(mask, base, out + count);
+    }
+    return count;
+}
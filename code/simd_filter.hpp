@@ -0,0 +1,50 @@
+#ifndef SIMD_FILTER_H
+#define SIMD_FILTER_H
+
+#include "predicate.hpp"
+
+// Comparison kernels for σ filters over dense column chunks. Each kernel has
+// AVX2, SSE4.2 and scalar versions; the widest one the CPU supports is picked
+// once at startup. Matches come out as bitmaps (bit i of word i / 64 set when
+// row i matches) or as selection vectors of matching row indexes. An int64
+// NULL (COLFILE_NULL) matches no comparison.
+
+typedef enum FilterIsa {
+    FILTER_SCALAR,
+    FILTER_SSE42,
+    FILTER_AVX2
+} FilterIsa;
+
+// One "column op constant" term of a conjunction over int64 columns
+typedef struct FilterTerm {
+    const long long *values;
+    CmpOp op;                   // CMP_EQ, CMP_LT or CMP_GT
+    long long constant;
+} FilterTerm;
+
+FilterIsa filter_isa();
+const char* filter_isa_name(FilterIsa isa);
+
+// Restricts the kernels to isa (or lower, if the CPU lacks it), e.g. to compare paths
+void filter_force_isa(FilterIsa isa);
+
+// bitmap needs (n + 63) / 64 words
+void filter_i64_bitmap(const long long *values, int n, CmpOp op, long long constant, unsigned long long *bitmap);
+void filter_i32_bitmap(const int *values, int n, CmpOp op, int constant, unsigned long long *bitmap);
+
+// Writes indexes of matching rows to out and returns how many there are
+int filter_i64_select(const long long *values, int n, CmpOp op, long long constant, int *out);
+int filter_i32_select(const int *values, int n, CmpOp op, int constant, int *out);
+
+// AND of every term over rows [0, n): each term is evaluated for every row and
+// the masks are combined, so no row takes a data-dependent branch
+void filter_conjunction_bitmap(const FilterTerm *terms, int term_count, int n, unsigned long long *bitmap);
+int filter_conjunction_select(const FilterTerm *terms, int term_count, int n, int *out);
+
+// Narrows an existing selection vector (rows not adjacent in memory, so scalar)
+int filter_conjunction_refine(const FilterTerm *terms, int term_count, const int *in, int n, int *out);
+
+// Indexes of the set bits of bitmap below n
+int bitmap_to_selection(const unsigned long long *bitmap, int n, int *out);
+
+#endif
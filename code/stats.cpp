@@ -5,11 +5,74 @@
 #include <math.h>
 #include <ctype.h>
 
-#define MAX_TABLES 10
-#define MAX_COLUMNS_PER_TABLE 10
+#define INITIAL_TABLE_CAPACITY 16
+#define INITIAL_COLUMN_CAPACITY 8
+#define INITIAL_INDEX_BUCKETS 64
 
-TableStats *tables[MAX_TABLES];
-int table_count = 0;
+static const char *stats_file_path = STATS_DEFAULT_FILE;
+
+static TableStats **tables = NULL;
+static int table_count = 0;
+static int table_capacity = 0;
+
+// Open-addressing index over (table, column) symbol pairs. Table entries use
+// NO_SYMBOL as their column, so one probe finds either kind of entry.
+typedef struct CatalogEntry {
+    Symbol table_id;
+    Symbol column_id;
+    void *stats;            // TableStats* or ColumnStats*; NULL marks an empty slot
+} CatalogEntry;
+
+static CatalogEntry *index_entries = NULL;
+static int index_buckets = 0;
+static int index_used = 0;
+
+static unsigned int hash_key(Symbol table_id, Symbol column_id) {
+    unsigned long long key = ((unsigned long long)(unsigned int)table_id << 32) | (unsigned int)column_id;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return (unsigned int)key;
+}
+
+static CatalogEntry* find_entry(Symbol table_id, Symbol column_id) {
+    unsigned int mask = index_buckets - 1;
+    unsigned int slot = hash_key(table_id, column_id) & mask;
+    while (index_entries[slot].stats &&
+           (index_entries[slot].table_id != table_id || index_entries[slot].column_id != column_id)) {
+        slot = (slot + 1) & mask;
+    }
+    return &index_entries[slot];
+}
+
+static void grow_index() {
+    CatalogEntry *old_entries = index_entries;
+    int old_buckets = index_buckets;
+
+    index_buckets = index_buckets ? index_buckets * 2 : INITIAL_INDEX_BUCKETS;
+    index_entries = (CatalogEntry *)calloc(index_buckets, sizeof(CatalogEntry));
+    for (int i = 0; i < old_buckets; i++) {
+        if (old_entries[i].stats) {
+            *find_entry(old_entries[i].table_id, old_entries[i].column_id) = old_entries[i];
+        }
+    }
+    free(old_entries);
+}
+
+static void index_insert(Symbol table_id, Symbol column_id, void *stats) {
+    // Keep the load factor under one half
+    if ((index_used + 1) * 2 > index_buckets) grow_index();
+    CatalogEntry *entry = find_entry(table_id, column_id);
+    if (!entry->stats) index_used++;
+    entry->table_id = table_id;
+    entry->column_id = column_id;
+    entry->stats = stats;
+}
+
+static void* index_lookup(Symbol table_id, Symbol column_id) {
+    if (!index_entries || table_id == NO_SYMBOL) return NULL;
+    return find_entry(table_id, column_id)->stats;
+}
 
 // Helper function to create a new column stat
 static ColumnStats* create_column_stat(const char *table, const char *column, 
@@ -17,14 +80,102 @@ static ColumnStats* create_column_stat(const char *table, const char *column,
     ColumnStats *stat = (ColumnStats *)malloc(sizeof(ColumnStats));
     stat->table = strdup(table);
     stat->column = strdup(column);
+    stat->qualified_name = (char *)malloc(strlen(table) + strlen(column) + 2);
+    sprintf(stat->qualified_name, "%s.%s", table, column);
+    stat->table_id = intern(table);
+    stat->column_id = intern(column);
     stat->distinct_values = distinct;
     stat->min_value = min;
     stat->max_value = max;
     stat->selectivity = sel;
+    stat->null_count = 0;
+    stat->histogram_buckets = 0;
+    stat->histogram_bounds = NULL;
+    stat->mcv_count = 0;
+    stat->mcv_values = NULL;
+    stat->mcv_frequencies = NULL;
     return stat;
 }
 
-// Initialize statistics from metadata.txt or defaults
+TableStats* add_table_stats(const char *table_name, int row_count, int bytes_per_row) {
+    Symbol table_id = intern(table_name);
+    TableStats *table = (TableStats *)index_lookup(table_id, NO_SYMBOL);
+    if (table) {
+        table->row_count = row_count;
+        table->size_in_bytes = row_count * bytes_per_row;
+        return table;
+    }
+
+    table = (TableStats *)malloc(sizeof(TableStats));
+    table->name = strdup(table_name);
+    table->table_id = table_id;
+    table->row_count = row_count;
+    table->column_count = 0;
+    table->column_capacity = INITIAL_COLUMN_CAPACITY;
+    table->size_in_bytes = row_count * bytes_per_row;
+    table->column_names = (char **)malloc(table->column_capacity * sizeof(char *));
+    table->columns = (ColumnStats **)malloc(table->column_capacity * sizeof(ColumnStats *));
+
+    if (table_count == table_capacity) {
+        table_capacity = table_capacity ? table_capacity * 2 : INITIAL_TABLE_CAPACITY;
+        tables = (TableStats **)realloc(tables, table_capacity * sizeof(TableStats *));
+    }
+    tables[table_count++] = table;
+    index_insert(table_id, NO_SYMBOL, table);
+    return table;
+}
+
+ColumnStats* add_column_stats(TableStats *table, const char *column_name,
+                              int distinct, int min, int max, double sel) {
+    ColumnStats *stat = (ColumnStats *)index_lookup(table->table_id, intern(column_name));
+    if (stat) {
+        stat->distinct_values = distinct;
+        stat->min_value = min;
+        stat->max_value = max;
+        stat->selectivity = sel;
+        return stat;
+    }
+
+    if (table->column_count == table->column_capacity) {
+        table->column_capacity *= 2;
+        table->column_names = (char **)realloc(table->column_names, table->column_capacity * sizeof(char *));
+        table->columns = (ColumnStats **)realloc(table->columns, table->column_capacity * sizeof(ColumnStats *));
+    }
+    stat = create_column_stat(table->name, column_name, distinct, min, max, sel);
+    table->column_names[table->column_count] = strdup(column_name);
+    table->columns[table->column_count] = stat;
+    table->column_count++;
+    index_insert(stat->table_id, stat->column_id, stat);
+    return stat;
+}
+
+void set_column_histogram(ColumnStats *stats, const int *bounds, int bucket_count) {
+    free(stats->histogram_bounds);
+    stats->histogram_bounds = NULL;
+    stats->histogram_buckets = 0;
+    if (bucket_count <= 0) return;
+
+    stats->histogram_bounds = (int *)malloc((bucket_count + 1) * sizeof(int));
+    memcpy(stats->histogram_bounds, bounds, (bucket_count + 1) * sizeof(int));
+    stats->histogram_buckets = bucket_count;
+}
+
+void set_column_mcv(ColumnStats *stats, const int *values, const double *frequencies, int count) {
+    free(stats->mcv_values);
+    free(stats->mcv_frequencies);
+    stats->mcv_values = NULL;
+    stats->mcv_frequencies = NULL;
+    stats->mcv_count = 0;
+    if (count <= 0) return;
+
+    stats->mcv_values = (int *)malloc(count * sizeof(int));
+    stats->mcv_frequencies = (double *)malloc(count * sizeof(double));
+    memcpy(stats->mcv_values, values, count * sizeof(int));
+    memcpy(stats->mcv_frequencies, frequencies, count * sizeof(double));
+    stats->mcv_count = count;
+}
+
+// Initialize statistics from the defaults, then the stats file if there is one
 void init_stats() {
     printf("Initializing statistics...\n");
 
@@ -68,32 +219,193 @@ void init_stats() {
           {"budget", 1000, 10000, 1000000, 0.001}}}
     };
     int default_table_count = 4;
+
+    // Skewed value distributions: most salaries and budgets sit in the low end of
+    // their range, and a few departments own most employees and projects.
+    struct {
+        char *table;
+        char *column;
+        int buckets;
+        int bounds[11];
+    } default_histograms[] = {
+        {"employees", "salary", 10,
+         {30000, 34000, 38000, 42000, 46000, 50000, 55000, 61000, 70000, 90000, 150000}},
+        {"salaries", "salary", 10,
+         {30000, 34000, 38000, 42000, 46000, 50000, 55000, 61000, 70000, 90000, 150000}},
+        {"salaries", "bonus", 5,
+         {0, 500, 1500, 3000, 8000, 50000}},
+        {"projects", "budget", 10,
+         {10000, 15000, 20000, 25000, 32000, 40000, 50000, 65000, 90000, 150000, 1000000}}
+    };
+    int default_histogram_count = 4;
+
+    struct {
+        char *table;
+        char *column;
+        int count;
+        int values[3];
+        double frequencies[3];
+    } default_mcvs[] = {
+        {"employees", "dept_id", 3, {1, 2, 3}, {0.20, 0.15, 0.10}},
+        {"employees", "salary", 3, {50000, 40000, 60000}, {0.05, 0.04, 0.03}},
+        {"salaries", "salary", 3, {50000, 40000, 60000}, {0.05, 0.04, 0.03}},
+        {"salaries", "bonus", 1, {0}, {0.30}},
+        {"projects", "dept_id", 2, {1, 2}, {0.12, 0.08}}
+    };
+    int default_mcv_count = 5;
+    
+    // Start from an empty catalog so repeated calls do not leak or duplicate entries
+    free_stats();
     
     // Initialize tables
     for (int i = 0; i < default_table_count; i++) {
-        TableStats *table = (TableStats *)malloc(sizeof(TableStats));
-        table->name = strdup(default_tables[i].name);
-        table->row_count = default_tables[i].row_count;
-        table->column_count = default_tables[i].column_count;
-        table->size_in_bytes = table->row_count * default_tables[i].bytes_per_row;
-        table->column_names = (char **)malloc(table->column_count * sizeof(char *));
-        table->columns = (ColumnStats**)malloc(table->column_count * sizeof(ColumnStats *));
+        TableStats *table = add_table_stats(default_tables[i].name,
+                                            default_tables[i].row_count,
+                                            default_tables[i].bytes_per_row);
+        for (int j = 0; j < default_tables[i].column_count; j++) {
+            add_column_stats(table,
+                             default_tables[i].columns[j].column,
+                             default_tables[i].columns[j].distinct,
+                             default_tables[i].columns[j].min,
+                             default_tables[i].columns[j].max,
+                             default_tables[i].columns[j].sel);
+        }
+    }
+
+    for (int i = 0; i < default_histogram_count; i++) {
+        ColumnStats *stats = get_column_stats(default_histograms[i].table, default_histograms[i].column);
+        if (stats) set_column_histogram(stats, default_histograms[i].bounds, default_histograms[i].buckets);
+    }
+    for (int i = 0; i < default_mcv_count; i++) {
+        ColumnStats *stats = get_column_stats(default_mcvs[i].table, default_mcvs[i].column);
+        if (stats) set_column_mcv(stats, default_mcvs[i].values, default_mcvs[i].frequencies, default_mcvs[i].count);
+    }
 
+    FILE *probe = fopen(stats_file_path, "r");
+    if (probe) {
+        fclose(probe);
+        int loaded = load_stats(stats_file_path);
+        if (loaded >= 0) printf("Loaded statistics for %d tables from %s\n", loaded, stats_file_path);
+        else fprintf(stderr, "Ignoring malformed stats file %s\n", stats_file_path);
+    }
+
+    printf("Statistics initialized for %d tables\n", table_count);
+}
+
+void set_stats_file(const char *path) {
+    stats_file_path = path;
+}
+
+const char* stats_file() {
+    return stats_file_path;
+}
+
+// Stats file format, one record per line:
+//   table <name> <row_count> <bytes_per_row>
+//   column <table> <column> <distinct> <min> <max> <null_count> <selectivity>
+//   histogram <table> <column> <buckets> <bound 0> ... <bound buckets>
+//   mcv <table> <column> <count> <value> <frequency> ...
+int save_stats(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    for (int i = 0; i < table_count; i++) {
+        TableStats *table = tables[i];
+        fprintf(file, "table %s %d %d\n", table->name, table->row_count,
+                table->row_count > 0 ? table->size_in_bytes / table->row_count : 0);
         for (int j = 0; j < table->column_count; j++) {
-            table->column_names[j] = strdup(default_tables[i].column_names[j]);
-            table->columns[j] = create_column_stat(
-                table->name,
-                default_tables[i].columns[j].column,
-                default_tables[i].columns[j].distinct,
-                default_tables[i].columns[j].min,
-                default_tables[i].columns[j].max,
-                default_tables[i].columns[j].sel
-            );
+            ColumnStats *column = table->columns[j];
+            fprintf(file, "column %s %s %d %d %d %d %.17g\n", table->name, column->column, column->distinct_values,
+                    column->min_value, column->max_value, column->null_count, column->selectivity);
+            if (column->histogram_buckets > 0) {
+                fprintf(file, "histogram %s %s %d", table->name, column->column, column->histogram_buckets);
+                for (int b = 0; b <= column->histogram_buckets; b++) fprintf(file, " %d", column->histogram_bounds[b]);
+                fprintf(file, "\n");
+            }
+            if (column->mcv_count > 0) {
+                fprintf(file, "mcv %s %s %d", table->name, column->column, column->mcv_count);
+                for (int m = 0; m < column->mcv_count; m++) {
+                    fprintf(file, " %d %.17g", column->mcv_values[m], column->mcv_frequencies[m]);
+                }
+                fprintf(file, "\n");
+            }
         }
-        tables[table_count++] = table;
     }
+    int failed = ferror(file);
+    if (fclose(file) != 0 || failed) {
+        perror(path);
+        return -1;
+    }
+    return table_count;
+}
 
-    printf("Statistics initialized for %d tables\n", table_count);
+// Reads count ints (histogram bounds) or count value/frequency pairs (MCVs) that follow
+// the first `offset` characters of line; returns 0 if the line is short
+static int read_int_list(const char *line, int offset, int count, int *values, double *frequencies) {
+    const char *p = line + offset;
+    for (int i = 0; i < count; i++) {
+        int consumed;
+        if (sscanf(p, " %d%n", &values[i], &consumed) != 1) return 0;
+        p += consumed;
+        if (frequencies) {
+            if (sscanf(p, " %lf%n", &frequencies[i], &consumed) != 1) return 0;
+            p += consumed;
+        }
+    }
+    return 1;
+}
+
+int load_stats(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    char *line = NULL;
+    size_t capacity = 0;
+    char table_name[256], column_name[256];
+    int loaded = 0, ok = 1;
+    while (ok && getline(&line, &capacity, file) != -1) {
+        int rows, bytes_per_row, distinct, min, max, nulls, count, offset;
+        double sel;
+        if (line[0] == '\n' || line[0] == '#') continue;
+
+        if (sscanf(line, "table %255s %d %d", table_name, &rows, &bytes_per_row) == 3) {
+            TableStats *table = add_table_stats(table_name, rows, bytes_per_row);
+            // Columns that are not in the file keep no stale distributions
+            for (int j = 0; j < table->column_count; j++) {
+                set_column_histogram(table->columns[j], NULL, 0);
+                set_column_mcv(table->columns[j], NULL, NULL, 0);
+            }
+            loaded++;
+        } else if (sscanf(line, "column %255s %255s %d %d %d %d %lf", table_name, column_name,
+                          &distinct, &min, &max, &nulls, &sel) == 7) {
+            TableStats *table = get_table_stats(table_name);
+            if (!table) { ok = 0; break; }
+            add_column_stats(table, column_name, distinct, min, max, sel)->null_count = nulls;
+        } else if (sscanf(line, "histogram %255s %255s %d%n", table_name, column_name, &count, &offset) == 3) {
+            ColumnStats *stats = get_column_stats(table_name, column_name);
+            if (!stats || count <= 0) { ok = 0; break; }
+            int *bounds = (int *)malloc((count + 1) * sizeof(int));
+            ok = read_int_list(line, offset, count + 1, bounds, NULL);
+            if (ok) set_column_histogram(stats, bounds, count);
+            free(bounds);
+        } else if (sscanf(line, "mcv %255s %255s %d%n", table_name, column_name, &count, &offset) == 3) {
+            ColumnStats *stats = get_column_stats(table_name, column_name);
+            if (!stats || count <= 0) { ok = 0; break; }
+            int *values = (int *)malloc(count * sizeof(int));
+            double *frequencies = (double *)malloc(count * sizeof(double));
+            ok = read_int_list(line, offset, count, values, frequencies);
+            if (ok) set_column_mcv(stats, values, frequencies, count);
+            free(values);
+            free(frequencies);
+        } else {
+            ok = 0;
+        }
+    }
+    free(line);
+    fclose(file);
+    return ok ? loaded : -1;
 }
 
 void free_stats() {
@@ -101,6 +413,10 @@ void free_stats() {
         for (int j = 0; j < tables[i]->column_count; j++) {
             free(tables[i]->columns[j]->table);
             free(tables[i]->columns[j]->column);
+            free(tables[i]->columns[j]->qualified_name);
+            free(tables[i]->columns[j]->histogram_bounds);
+            free(tables[i]->columns[j]->mcv_values);
+            free(tables[i]->columns[j]->mcv_frequencies);
             free(tables[i]->columns[j]);
             free(tables[i]->column_names[j]);
         }
@@ -110,29 +426,176 @@ void free_stats() {
         free(tables[i]);
     }
     table_count = 0;
+    if (index_entries) memset(index_entries, 0, index_buckets * sizeof(CatalogEntry));
+    index_used = 0;
+}
+
+TableStats* find_table_stats(Symbol table_id) {
+    return (TableStats *)index_lookup(table_id, NO_SYMBOL);
+}
+
+ColumnStats* find_column_stats(Symbol table_id, Symbol column_id) {
+    if (column_id == NO_SYMBOL) return NULL;
+    return (ColumnStats *)index_lookup(table_id, column_id);
 }
 
 TableStats *get_table_stats(const char *table_name) {
-    for (int i = 0; i < table_count; i++) {
-        if (strcmp(tables[i]->name, table_name) == 0) {
-            return tables[i];
-        }
-    }
-    // printf("No statistics found for table %s\n", table_name);
-    return NULL;
+    return find_table_stats(lookup_symbol(table_name));
 }
 
 ColumnStats *get_column_stats(const char *table_name, const char *column_name) {
-    TableStats *table = get_table_stats(table_name);
-    if (!table) return NULL;
+    return find_column_stats(lookup_symbol(table_name), lookup_symbol(column_name));
+}
 
-    for (int i = 0; i < table->column_count; i++) {
-        if (strcmp(table->columns[i]->column, column_name) == 0) {
-            return table->columns[i];
-        }
+int stats_table_count() {
+    return table_count;
+}
+
+TableStats* stats_table_at(int index) {
+    return (index >= 0 && index < table_count) ? tables[index] : NULL;
+}
+
+static double clamp_fraction(double fraction) {
+    return fraction > 1.0 ? 1.0 : (fraction < 0.0 ? 0.0 : fraction);
+}
+
+// Fraction of all rows held by the MCV list
+static double mcv_total_frequency(const ColumnStats *stats) {
+    double total = 0.0;
+    for (int i = 0; i < stats->mcv_count; i++) total += stats->mcv_frequencies[i];
+    return total > 1.0 ? 1.0 : total;
+}
+
+// Fraction of the non-MCV rows whose value is below `value`: binary search for the
+// bucket holding it, then interpolate linearly inside that bucket. Without a
+// histogram the non-MCV rows are assumed uniform over [min, max].
+static double fraction_below(const ColumnStats *stats, double value) {
+    int buckets = stats->histogram_buckets;
+    if (buckets == 0) {
+        double range = stats->max_value - stats->min_value;
+        return range > 0 ? clamp_fraction((value - stats->min_value) / range) : 0.5;
+    }
+
+    const int *bounds = stats->histogram_bounds;
+    if (value <= bounds[0]) return 0.0;
+    if (value >= bounds[buckets]) return 1.0;
+
+    // Find the last bound <= value; it starts the bucket containing value
+    int lo = 0, hi = buckets;
+    while (hi - lo > 1) {
+        int mid = (lo + hi) / 2;
+        if (bounds[mid] <= value) lo = mid;
+        else hi = mid;
+    }
+    double width = bounds[lo + 1] - bounds[lo];
+    double within = width > 0 ? (value - bounds[lo]) / width : 0.0;
+    return (lo + within) / buckets;
+}
+
+// Distinct values outside the MCV list
+static double non_mcv_distinct(const ColumnStats *stats) {
+    double distinct = stats->distinct_values - stats->mcv_count;
+    return distinct < 1.0 ? 1.0 : distinct;
+}
+
+// Histogram join: walk both histograms' bounds in order and, for every segment
+// where buckets overlap, match the rows each side puts there assuming values are
+// spread uniformly within a bucket (containment: rows / max distinct in segment).
+static double histogram_join_selectivity(const ColumnStats *left, const ColumnStats *right) {
+    const int *lb = left->histogram_bounds, *rb = right->histogram_bounds;
+    int ln = left->histogram_buckets, rn = right->histogram_buckets;
+    double left_distinct = non_mcv_distinct(left), right_distinct = non_mcv_distinct(right);
+    double selectivity = 0.0;
+
+    int i = 0, j = 0;
+    double start = fmax(lb[0], rb[0]);
+    while (i < ln && j < rn) {
+        if (lb[i + 1] <= start) { i++; continue; }
+        if (rb[j + 1] <= start) { j++; continue; }
+        double end = fmin(lb[i + 1], rb[j + 1]);
+        double left_width = lb[i + 1] - lb[i], right_width = rb[j + 1] - rb[j];
+        double left_rows = (left_width > 0 ? (end - start) / left_width : 1.0) / ln;
+        double right_rows = (right_width > 0 ? (end - start) / right_width : 1.0) / rn;
+        double distinct = fmax(left_rows * left_distinct, right_rows * right_distinct);
+        if (distinct > 0) selectivity += left_rows * right_rows / fmax(distinct, 1.0);
+        start = end;
+    }
+    return selectivity;
+}
+
+// Fraction of the table's rows where the column is not NULL
+static double non_null_fraction(const ColumnStats *stats) {
+    if (stats->null_count <= 0) return 1.0;
+    TableStats *table = find_table_stats(stats->table_id);
+    if (!table || table->row_count <= 0) return 1.0;
+    return clamp_fraction(1.0 - (double)stats->null_count / table->row_count);
+}
+
+// Fraction of the column's rows equal to a value outside its MCV list. The
+// value's bucket holds 1/buckets of the non-MCV rows, spread over the distinct
+// values it can hold; without a histogram they are uniform over [min, max].
+static double non_mcv_frequency(const ColumnStats *stats, int value) {
+    double rest = 1.0 - mcv_total_frequency(stats);
+    if (rest <= 0.0) return 0.0;
+
+    int buckets = stats->histogram_buckets;
+    if (buckets == 0) {
+        int has_range = stats->min_value != 0 || stats->max_value != 0;
+        if (has_range && (value < stats->min_value || value > stats->max_value)) return 0.0;
+        return rest / non_mcv_distinct(stats);
+    }
+
+    const int *bounds = stats->histogram_bounds;
+    if (value < bounds[0] || value > bounds[buckets]) return 0.0;
+    int lo = 0, hi = buckets;
+    while (hi - lo > 1) {
+        int mid = (lo + hi) / 2;
+        if (bounds[mid] <= value) lo = mid;
+        else hi = mid;
     }
-    // printf(" No statistics found for column %s.%s\n", table_name, column_name);
-    return NULL;
+    double distinct = fmin(non_mcv_distinct(stats) / buckets, bounds[lo + 1] - bounds[lo] + 1.0);
+    return rest / buckets / fmax(distinct, 1.0);
+}
+
+// Fraction of the column's rows equal to value
+static double value_frequency(const ColumnStats *stats, int value) {
+    for (int i = 0; i < stats->mcv_count; i++) {
+        if (stats->mcv_values[i] == value) return stats->mcv_frequencies[i];
+    }
+    return non_mcv_frequency(stats, value);
+}
+
+// Join selectivity among the non-NULL rows of both sides
+static double value_join_selectivity(const ColumnStats *left, const ColumnStats *right) {
+    // Every MCV matches the same value on the other side, whether that is an
+    // MCV there or falls in its histogram; the remaining rows of both sides
+    // are matched bucket by bucket, or uniformly without histograms.
+    double selectivity = 0.0;
+    for (int i = 0; i < left->mcv_count; i++) {
+        selectivity += left->mcv_frequencies[i] * value_frequency(right, left->mcv_values[i]);
+    }
+    for (int j = 0; j < right->mcv_count; j++) {
+        int common = 0;
+        for (int i = 0; i < left->mcv_count && !common; i++) common = left->mcv_values[i] == right->mcv_values[j];
+        if (!common) selectivity += right->mcv_frequencies[j] * non_mcv_frequency(left, right->mcv_values[j]);
+    }
+
+    double rest = (1.0 - mcv_total_frequency(left)) * (1.0 - mcv_total_frequency(right));
+    if (left->histogram_buckets > 0 && right->histogram_buckets > 0) {
+        selectivity += rest * histogram_join_selectivity(left, right);
+    } else {
+        selectivity += rest / fmax(non_mcv_distinct(left), non_mcv_distinct(right));
+    }
+    return clamp_fraction(selectivity);
+}
+
+double column_join_selectivity(const ColumnStats *left, const ColumnStats *right) {
+    // NULL never equals anything
+    return value_join_selectivity(left, right) * non_null_fraction(left) * non_null_fraction(right);
+}
+
+double column_semijoin_selectivity(const ColumnStats *left, const ColumnStats *right, double values) {
+    return clamp_fraction(value_join_selectivity(left, right) * non_null_fraction(left) * values);
 }
 
 double calculate_join_selectivity(const char *table1, const char *column1, 
@@ -149,29 +612,57 @@ double calculate_join_selectivity(const char *table1, const char *column1,
         return default_sel;
     }
 
-    return 1.0 / fmax(stats1->distinct_values, stats2->distinct_values);
+    return column_join_selectivity(stats1, stats2);
 }
 
 double calculate_condition_selectivity(const char *table, const char *column,
-                                     const char *op, int value) {
+                                     CmpOp op, int value) {
     ColumnStats *stats = get_column_stats(table, column);
     if (!stats) return 1.0;
+    return column_condition_selectivity(stats, op, value);
+}
 
+// Condition selectivity from the MCV list plus the histogram (or a uniform
+// distribution) over the remaining rows
+static double distribution_selectivity(const ColumnStats *stats, CmpOp op, int value) {
+    if (op == CMP_EQ) return value_frequency(stats, value);
+
+    double rest = 1.0 - mcv_total_frequency(stats);
+
+    double mcv_part = 0.0;
+    for (int i = 0; i < stats->mcv_count; i++) {
+        if ((op == CMP_LT && stats->mcv_values[i] < value) ||
+            (op == CMP_GT && stats->mcv_values[i] > value)) {
+            mcv_part += stats->mcv_frequencies[i];
+        }
+    }
+    double below = fraction_below(stats, value);
+    if (op == CMP_LT) return clamp_fraction(mcv_part + rest * below);
+    return clamp_fraction(mcv_part + rest * (1.0 - below));
+}
+
+// Condition selectivity among the column's non-NULL rows
+static double value_condition_selectivity(const ColumnStats *stats, CmpOp op, int value) {
     if (stats->min_value == 0 && stats->max_value == 0) {
         return 1.0 / stats->distinct_values;
     }
 
+    if ((stats->histogram_buckets > 0 || stats->mcv_count > 0) &&
+        (op == CMP_EQ || op == CMP_LT || op == CMP_GT)) {
+        return distribution_selectivity(stats, op, value);
+    }
+
     double range = stats->max_value - stats->min_value;
     if (range <= 0) return 0.5;
 
-    if (strcmp(op, "=") == 0) {
+    if (op == CMP_EQ) {
         return 1.0 / stats->distinct_values;
     }
-    else if (strcmp(op, "<") == 0 || strcmp(op, "<=") == 0) {
+    else if (op == CMP_LT) {
         double fraction = (value - stats->min_value) / range;
         return fraction > 1.0 ? 1.0 : (fraction < 0.0 ? 0.0 : fraction);
     }
-    else if (strcmp(op, ">") == 0 || strcmp(op, ">=") == 0) {
+    else if (op == CMP_GT) {
         double fraction = (stats->max_value - value) / range;
         return fraction > 1.0 ? 1.0 : (fraction < 0.0 ? 0.0 : fraction);
     }
@@ -179,6 +670,37 @@ double calculate_condition_selectivity(const char *table, const char *column,
     return 0.5;
 }
 
+double column_condition_selectivity(const ColumnStats *stats, CmpOp op, int value) {
+    // NULL fails every comparison
+    return value_condition_selectivity(stats, op, value) * non_null_fraction(stats);
+}
+
+double calculate_predicate_selectivity(const Predicate *pred) {
+    if (!pred || pred->left.kind != OPERAND_COLUMN || pred->left.column.table == NO_SYMBOL) {
+        return 0.05; // Default selectivity
+    }
+    const ColumnRef *left = &pred->left.column;
+    ColumnStats *stats = left->stats ? left->stats : find_column_stats(left->table, left->column);
+
+    switch (pred->right.kind) {
+        case OPERAND_COLUMN: {
+            const ColumnRef *right = &pred->right.column;
+            if (right->table == NO_SYMBOL) return 0.05;
+            ColumnStats *right_stats = right->stats ? right->stats : find_column_stats(right->table, right->column);
+            if (stats && right_stats) return column_join_selectivity(stats, right_stats);
+            return calculate_join_selectivity(symbol_name(left->table), symbol_name(left->column),
+                                              symbol_name(right->table), symbol_name(right->column));
+        }
+        case OPERAND_INT:
+            return stats ? column_condition_selectivity(stats, pred->op, pred->right.int_value) : 1.0;
+        case OPERAND_STRING:
+        case OPERAND_SUBQUERY:
+            // Non-numeric operands carry no range information
+            return stats ? column_condition_selectivity(stats, pred->op, 0) : 1.0;
+    }
+    return 0.05;
+}
+
 int estimate_result_size(const char *table_name, double selectivity) {
     TableStats *stats = get_table_stats(table_name);
     if (!stats) return 0;
@@ -2,44 +2,104 @@
 #define STATS_H
 
 #include <stdlib.h>
+#include "predicate.hpp"
 
 typedef struct ColumnStats {
     char *table;
     char *column;
+    char *qualified_name;   // "table.column", built once when the column is registered
+    Symbol table_id;
+    Symbol column_id;
     int distinct_values;
     int min_value;
     int max_value;
     double selectivity;
+    int null_count;             // Rows where the column is NULL
+    int histogram_buckets;      // Equi-depth buckets over the non-MCV rows (0 = assume uniform)
+    int *histogram_bounds;      // histogram_buckets + 1 ascending boundaries
+    int mcv_count;              // Most common values, tracked separately from the histogram
+    int *mcv_values;
+    double *mcv_frequencies;    // Fraction of all rows equal to each value
 } ColumnStats;
 
 typedef struct TableStats {
     char *name;
+    Symbol table_id;
     int row_count;          // Number of tuples (ntups)
     int column_count;       // Number of columns (ncols)
+    int column_capacity;    // Allocated slots in column_names / columns
     char **column_names;    // Array of column names
     ColumnStats **columns;  // Array of column statistics
     int size_in_bytes;      // Average row size * row count
 } TableStats;
 
-// Initialize statistics from metadata file
+#define STATS_DEFAULT_FILE "table_stats.txt"
+
+// Load the built-in defaults, then whatever the stats file (written by ANALYZE) holds
 void init_stats();
 
+// Stats file init_stats() reads and ANALYZE writes (STATS_DEFAULT_FILE unless set)
+void set_stats_file(const char *path);
+const char* stats_file();
+
+// Write every table in the catalog to path, or read tables from it (replacing
+// the statistics of tables already present). load_stats returns the number of
+// tables read, or -1 if the file cannot be opened or is malformed.
+int save_stats(const char *path);
+int load_stats(const char *path);
+
 // Free statistics memory
 void free_stats();
 
+// Register a table (or return the existing entry). The returned pointer, and every
+// ColumnStats added to it, stays valid until free_stats(), so callers may keep
+// them as handles instead of looking names up again.
+TableStats* add_table_stats(const char *table_name, int row_count, int bytes_per_row);
+
+// Register (or update) statistics for one column of a table
+ColumnStats* add_column_stats(TableStats *table, const char *column_name,
+                              int distinct, int min, int max, double sel);
+
+// Attach an equi-depth histogram (bucket_count + 1 ascending bounds) to a column
+void set_column_histogram(ColumnStats *stats, const int *bounds, int bucket_count);
+
+// Attach a most-common-values list to a column
+void set_column_mcv(ColumnStats *stats, const int *values, const double *frequencies, int count);
+
 // Get statistics for a table
 TableStats* get_table_stats(const char *table_name);
 
 // Get column statistics
 ColumnStats* get_column_stats(const char *table_name, const char *column_name);
 
+// O(1) lookups by interned identifiers
+TableStats* find_table_stats(Symbol table_id);
+ColumnStats* find_column_stats(Symbol table_id, Symbol column_id);
+
+// Number of registered tables, and the i-th one in registration order
+int stats_table_count();
+TableStats* stats_table_at(int index);
+
 // Calculate join selectivity between two columns
 double calculate_join_selectivity(const char *table1, const char *column1, 
                                  const char *table2, const char *column2);
 
 // Calculate selectivity for a condition
 double calculate_condition_selectivity(const char *table, const char *column, 
-                                     const char *op, int value);
+                                     CmpOp op, int value);
+
+// Same estimates on already resolved handles
+double column_join_selectivity(const ColumnStats *left, const ColumnStats *right);
+double column_condition_selectivity(const ColumnStats *stats, CmpOp op, int value);
+
+// Fraction of left's rows with a match among `values` distinct values drawn
+// from right (an IN subquery's result): each value matches left's rows with
+// the join selectivity of the two columns
+double column_semijoin_selectivity(const ColumnStats *left, const ColumnStats *right, double values);
+
+// Selectivity of a parsed predicate whose column references are bound to tables
+// (join selectivity for column = column, condition selectivity for column op literal)
+double calculate_predicate_selectivity(const Predicate *pred);
 
 // Calculate estimated size after applying a condition
 int estimate_result_size(const char *table_name, double selectivity);
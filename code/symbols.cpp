@@ -0,0 +1,93 @@
+#include "symbols.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define INITIAL_SYMBOL_BUCKETS 64
+
+static char **names = NULL;      // id -> name
+static int symbol_count = 0;
+static int name_capacity = 0;
+
+static Symbol *buckets = NULL;   // open addressing, NO_SYMBOL marks an empty slot
+static int bucket_count = 0;
+
+// Queries on different threads intern concurrently; lookups far outnumber new names
+static pthread_rwlock_t symbols_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static unsigned int hash_name(const char *name) {
+    unsigned int hash = 2166136261u;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int find_slot(const char *name) {
+    unsigned int mask = bucket_count - 1;
+    unsigned int slot = hash_name(name) & mask;
+    while (buckets[slot] != NO_SYMBOL && strcmp(names[buckets[slot]], name) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static void grow_buckets() {
+    int new_count = bucket_count ? bucket_count * 2 : INITIAL_SYMBOL_BUCKETS;
+    free(buckets);
+    buckets = (Symbol *)malloc(new_count * sizeof(Symbol));
+    for (int i = 0; i < new_count; i++) buckets[i] = NO_SYMBOL;
+    bucket_count = new_count;
+    for (int id = 0; id < symbol_count; id++) {
+        buckets[find_slot(names[id])] = id;
+    }
+}
+
+Symbol lookup_symbol(const char *name) {
+    if (!name) return NO_SYMBOL;
+    pthread_rwlock_rdlock(&symbols_lock);
+    Symbol id = buckets ? buckets[find_slot(name)] : NO_SYMBOL;
+    pthread_rwlock_unlock(&symbols_lock);
+    return id;
+}
+
+Symbol intern(const char *name) {
+    if (!name) return NO_SYMBOL;
+    Symbol existing = lookup_symbol(name);
+    if (existing != NO_SYMBOL) return existing;
+
+    pthread_rwlock_wrlock(&symbols_lock);
+    if (!buckets) grow_buckets();
+
+    // Another thread may have added it since the lookup
+    int slot = find_slot(name);
+    if (buckets[slot] != NO_SYMBOL) {
+        existing = buckets[slot];
+        pthread_rwlock_unlock(&symbols_lock);
+        return existing;
+    }
+
+    if (symbol_count == name_capacity) {
+        name_capacity = name_capacity ? name_capacity * 2 : INITIAL_SYMBOL_BUCKETS;
+        names = (char **)realloc(names, name_capacity * sizeof(char *));
+    }
+    Symbol id = symbol_count++;
+    names[id] = strdup(name);
+
+    // Keep the load factor under one half
+    if (symbol_count * 2 > bucket_count) {
+        grow_buckets();
+    } else {
+        buckets[slot] = id;
+    }
+    pthread_rwlock_unlock(&symbols_lock);
+    return id;
+}
+
+const char* symbol_name(Symbol id) {
+    pthread_rwlock_rdlock(&symbols_lock);
+    const char *name = id >= 0 && id < symbol_count ? names[id] : NULL;
+    pthread_rwlock_unlock(&symbols_lock);
+    return name;
+}
@@ -0,0 +1,20 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+// Interned identifiers: every distinct table/column name maps to a small integer,
+// so the optimizer can compare names with == instead of strcmp
+typedef int Symbol;
+
+#define NO_SYMBOL -1
+
+// Returns the id for name, adding it to the table on first use
+Symbol intern(const char *name);
+
+// Returns the id for name, or NO_SYMBOL if it was never interned
+Symbol lookup_symbol(const char *name);
+
+// Returns the canonical string for an id (valid for the lifetime of the process).
+// All three functions may be called from any thread.
+const char* symbol_name(Symbol id);
+
+#endif
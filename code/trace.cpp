@@ -0,0 +1,186 @@
+#include "trace.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define TRACE_MAX_EVENTS 1024           // Spans kept per query for Chrome output; the rest only count
+#define TRACE_SQL_LENGTH 1024
+
+static const char *phase_names[TRACE_PHASE_COUNT] = {
+    "parse", "optimize", "bind", "unnest", "selection_pushdown", "projection_pushdown", "join_order", "explore", "search",
+    "costing", "plan_cache", "execute"
+};
+
+static const char *counter_names[TRACE_COUNTER_COUNT] = {
+    "cost_calls", "node_costs", "plans_considered", "plans_pruned", "memo_groups", "memo_expressions",
+    "selections_pushed", "projections_pushed", "join_rewrites", "join_pairs", "subqueries_unnested",
+    "partial_aggregates", "plan_cache_hits"
+};
+
+typedef struct TraceEvent {
+    TracePhase phase;
+    double start;
+    double duration;
+} TraceEvent;
+
+// Everything recorded for the statement a thread is working on
+typedef struct QueryTrace {
+    int active;
+    double start;
+    char sql[TRACE_SQL_LENGTH];
+    double phase_us[TRACE_PHASE_COUNT];
+    long phase_calls[TRACE_PHASE_COUNT];
+    TraceEvent events[TRACE_MAX_EVENTS];
+    int event_count;
+} QueryTrace;
+
+int trace_active = 0;
+thread_local long trace_counters[TRACE_COUNTER_COUNT];
+
+static thread_local QueryTrace *current = NULL;
+static thread_local int thread_number = 0;
+
+static struct {
+    FILE *file;
+    TraceFormat format;
+    double epoch;               // Timestamps are microseconds since trace_open()
+    long written;               // Chrome events written, for the separators
+    int threads;
+    pthread_mutex_t lock;       // Guards the file and everything above
+} output = {NULL, TRACE_JSON, 0.0, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+
+static double clock_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void print_json_string(FILE *file, const char *text) {
+    fputc('"', file);
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        if (*p == '"' || *p == '\\') fprintf(file, "\\%c", *p);
+        else if (*p < 0x20) fprintf(file, "\\u%04x", *p);
+        else fputc(*p, file);
+    }
+    fputc('"', file);
+}
+
+int trace_open(const char *path, TraceFormat format) {
+    FILE *file = strcmp(path, "-") == 0 ? stderr : fopen(path, "w");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    pthread_mutex_lock(&output.lock);
+    output.file = file;
+    output.format = format;
+    // One microsecond early, so that no span starts at 0 (trace_begin's "off" value)
+    output.epoch = clock_us() - 1.0;
+    output.written = 0;
+    if (format == TRACE_CHROME) fprintf(file, "[\n");
+    pthread_mutex_unlock(&output.lock);
+    __atomic_store_n(&trace_active, 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void trace_close() {
+    if (!TRACE_ON()) return;
+    __atomic_store_n(&trace_active, 0, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&output.lock);
+    if (output.format == TRACE_CHROME) fprintf(output.file, "\n]\n");
+    if (output.file != stderr) fclose(output.file);
+    else fflush(output.file);
+    output.file = NULL;
+    pthread_mutex_unlock(&output.lock);
+}
+
+void trace_query_begin(const char *sql) {
+    if (!TRACE_ON()) return;
+    if (!current) {
+        current = (QueryTrace *)malloc(sizeof(QueryTrace));
+        pthread_mutex_lock(&output.lock);
+        thread_number = ++output.threads;
+        pthread_mutex_unlock(&output.lock);
+    }
+    current->active = 1;
+    snprintf(current->sql, sizeof(current->sql), "%s", sql);
+    memset(current->phase_us, 0, sizeof(current->phase_us));
+    memset(current->phase_calls, 0, sizeof(current->phase_calls));
+    memset(trace_counters, 0, sizeof(trace_counters));
+    current->event_count = 0;
+    current->start = clock_us() - output.epoch;
+}
+
+double trace_begin() {
+    if (!TRACE_ON() || !current || !current->active) return 0.0;
+    return clock_us() - output.epoch;
+}
+
+void trace_end(TracePhase phase, double start) {
+    if (start == 0.0 || !current || !current->active) return;
+    double duration = clock_us() - output.epoch - start;
+    current->phase_us[phase] += duration;
+    current->phase_calls[phase]++;
+    // Costing runs once per candidate plan and would drown the timeline; it is only summed
+    if (phase != TRACE_COSTING && current->event_count < TRACE_MAX_EVENTS) {
+        TraceEvent *event = &current->events[current->event_count++];
+        event->phase = phase;
+        event->start = start;
+        event->duration = duration;
+    }
+}
+
+static void write_json_record(FILE *file, const QueryTrace *query, double total) {
+    fprintf(file, "{\"sql\":");
+    print_json_string(file, query->sql);
+    fprintf(file, ",\"thread\":%d,\"start_us\":%.1f,\"total_us\":%.1f,\"phases\":{", thread_number, query->start, total);
+    int first = 1;
+    for (int p = 0; p < TRACE_PHASE_COUNT; p++) {
+        if (!query->phase_calls[p]) continue;
+        fprintf(file, "%s\"%s\":{\"us\":%.1f,\"calls\":%ld}", first ? "" : ",", phase_names[p], query->phase_us[p],
+                query->phase_calls[p]);
+        first = 0;
+    }
+    fprintf(file, "},\"counters\":{");
+    for (int c = 0; c < TRACE_COUNTER_COUNT; c++) {
+        fprintf(file, "%s\"%s\":%ld", c ? "," : "", counter_names[c], trace_counters[c]);
+    }
+    fprintf(file, "}}\n");
+}
+
+static void write_chrome_event(FILE *file, const char *name, double start, double duration) {
+    fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"optimizer\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,\"pid\":%d,\"tid\":%d",
+            output.written++ ? ",\n" : "", name, start, duration, (int)getpid(), thread_number);
+}
+
+static void write_chrome_record(FILE *file, const QueryTrace *query, double total) {
+    // The statement as a whole, carrying its counters and summed costing time
+    write_chrome_event(file, "query", query->start, total);
+    fprintf(file, ",\"args\":{\"sql\":");
+    print_json_string(file, query->sql);
+    fprintf(file, ",\"costing_us\":%.1f", query->phase_us[TRACE_COSTING]);
+    for (int c = 0; c < TRACE_COUNTER_COUNT; c++) fprintf(file, ",\"%s\":%ld", counter_names[c], trace_counters[c]);
+    fprintf(file, "}}");
+
+    for (int e = 0; e < query->event_count; e++) {
+        const TraceEvent *event = &query->events[e];
+        write_chrome_event(file, phase_names[event->phase], event->start, event->duration);
+        fprintf(file, "}");
+    }
+}
+
+void trace_query_end() {
+    if (!current || !current->active) return;
+    current->active = 0;
+    double total = clock_us() - output.epoch - current->start;
+
+    pthread_mutex_lock(&output.lock);
+    if (output.file) {
+        if (output.format == TRACE_CHROME) write_chrome_record(output.file, current, total);
+        else write_json_record(output.file, current, total);
+    }
+    pthread_mutex_unlock(&output.lock);
+}
@@ -0,0 +1,70 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Optimizer tracing, switched on at run time with --trace. Every traced query
+// records how long each phase took (spans may nest: costing happens inside the
+// rewrites) and how often the optimizer did the things below. When a query
+// ends its record is written out, either as one JSON object per line or as
+// Chrome trace events (chrome://tracing, Perfetto).
+//
+// While tracing is off the instrumentation costs one test of trace_active.
+// State is per thread, so concurrent queries are traced independently.
+
+typedef enum TracePhase {
+    TRACE_PARSE,
+    TRACE_OPTIMIZE,                 // All of optimize_query()
+    TRACE_BIND,
+    TRACE_UNNEST,                   // IN subqueries turned into semi-joins, their plans included
+    TRACE_SELECTION_PUSHDOWN,
+    TRACE_PROJECTION_PUSHDOWN,
+    TRACE_JOIN_ORDER,               // DP/greedy join orders that seed the memo
+    TRACE_EXPLORE,                  // Applying the memo's rules
+    TRACE_SEARCH,                   // Costing the memo's groups
+    TRACE_COSTING,                  // estimate_cost() and calculate_total_plan_cost()
+    TRACE_PLAN_CACHE,               // Key building, lookup and insertion
+    TRACE_EXECUTE,
+    TRACE_PHASE_COUNT
+} TracePhase;
+
+typedef enum TraceCounter {
+    TRACE_COST_CALLS,               // estimate_cost() and calculate_total_plan_cost() calls
+    TRACE_NODE_COSTS,               // Nodes whose cost was actually (re)computed
+    TRACE_PLANS_CONSIDERED,         // Memo expressions costed by optimize_query()
+    TRACE_PLANS_PRUNED,             // Memo expressions skipped because their inputs cost too much
+    TRACE_MEMO_GROUPS,
+    TRACE_MEMO_EXPRESSIONS,
+    TRACE_SELECTIONS_PUSHED,        // σ moved below a join, σ or π
+    TRACE_PROJECTIONS_PUSHED,       // π moved below a σ or a join
+    TRACE_JOIN_REWRITES,            // Join commutativity and associativity applied
+    TRACE_JOIN_PAIRS,               // Join pairs costed while ordering joins
+    TRACE_SUBQUERIES_UNNESTED,
+    TRACE_PARTIAL_AGGREGATES,       // Partial γ pushed below a join
+    TRACE_PLAN_CACHE_HITS,
+    TRACE_COUNTER_COUNT
+} TraceCounter;
+
+typedef enum TraceFormat {
+    TRACE_JSON,
+    TRACE_CHROME
+} TraceFormat;
+
+// Read without locks by every thread (acquire loads, plain loads on x86)
+extern int trace_active;
+extern thread_local long trace_counters[TRACE_COUNTER_COUNT];
+
+#define TRACE_ON() __atomic_load_n(&trace_active, __ATOMIC_ACQUIRE)
+#define TRACE_COUNT(counter) do { if (TRACE_ON()) trace_counters[counter]++; } while (0)
+
+// Starts writing traces to path ("-" = stderr); returns 0, or -1 if it cannot be opened
+int trace_open(const char *path, TraceFormat format);
+void trace_close();
+
+// Brackets one statement; only phases inside the brackets are recorded
+void trace_query_begin(const char *sql);
+void trace_query_end();
+
+// trace_begin() returns the span's start time (0 while tracing is off) for the matching trace_end()
+double trace_begin();
+void trace_end(TracePhase phase, double start);
+
+#endif
@@ -0,0 +1,407 @@
+// workload: generates a synthetic schema, its data and a query workload for
+// scaling tests.
+//
+//   workload <output dir> [--tables <n>] [--min-rows <n>] [--max-rows <n>]
+//            [--skew <s>] [--correlation <r>] [--queries <n>]
+//            [--shape chain|star|cycle|clique|mixed] [--min-relations <n>]
+//            [--max-relations <n>] [--filters <n>] [--seed <n>] [--no-data]
+//
+// Tables t0 .. t<n-1> have log-uniformly distributed sizes and the columns
+//
+//   id   1 .. rows, unique
+//   fk   references id: 1 .. min-rows, so it matches a row of every table
+//   val  0 .. 999
+//   cor  0 .. 99; with probability --correlation it is val / 10
+//
+// fk and val follow a Zipf distribution with exponent --skew (0 = uniform).
+// The output directory receives one .col file per table (unless --no-data),
+// stats.txt with statistics computed from the generated values (histograms
+// and most common values included) and queries.sql with one statement per
+// line. Every query joins distinct tables along a chain, star, cycle or
+// clique join graph; a table's ON clause holds its edges to every table
+// joined before it, and up to --filters random comparisons go to WHERE, all
+// combined with AND. Run it with
+//
+//   query_processor --stats <dir>/stats.txt --data <dir> --batch <dir>/queries.sql
+#include "colfile.hpp"
+#include "stats.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WORKLOAD_COLUMNS 4
+#define WORKLOAD_VAL_DOMAIN 1000
+#define WORKLOAD_COR_DOMAIN 100
+#define WORKLOAD_HISTOGRAM_BUCKETS 10
+#define WORKLOAD_MCV_COUNT 3
+#define WORKLOAD_MAX_RELATIONS 64       // The optimizer's join graph limit
+
+static const char *column_names[WORKLOAD_COLUMNS] = {"id", "fk", "val", "cor"};
+
+typedef enum JoinShape {
+    SHAPE_CHAIN,
+    SHAPE_STAR,
+    SHAPE_CYCLE,
+    SHAPE_CLIQUE,
+    SHAPE_MIXED
+} JoinShape;
+
+static const char *shape_names[] = {"chain", "star", "cycle", "clique", "mixed"};
+
+typedef struct WorkloadOptions {
+    const char *dir;
+    int tables;
+    int min_rows;
+    int max_rows;
+    double skew;
+    double correlation;
+    int queries;
+    JoinShape shape;
+    int min_relations;
+    int max_relations;
+    int filters;
+    unsigned long long seed;
+    int write_data;
+} WorkloadOptions;
+
+// ---------------------------------------------------------------------------
+// Random numbers
+// ---------------------------------------------------------------------------
+
+static unsigned long long rng_state;
+
+static unsigned long long next_random() {
+    // splitmix64
+    unsigned long long z = (rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static double random_unit() {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Uniform in [0, n)
+static int random_below(int n) {
+    return (int)(random_unit() * n);
+}
+
+// Zipf over ranks 0 .. n-1 by inverting the cumulative distribution
+typedef struct ZipfSampler {
+    double *cdf;
+    int n;
+} ZipfSampler;
+
+static void zipf_init(ZipfSampler *zipf, int n, double s) {
+    zipf->n = n;
+    zipf->cdf = (double *)malloc(n * sizeof(double));
+    double total = 0.0;
+    for (int k = 0; k < n; k++) {
+        total += pow(k + 1, -s);
+        zipf->cdf[k] = total;
+    }
+    for (int k = 0; k < n; k++) zipf->cdf[k] /= total;
+}
+
+static int zipf_sample(const ZipfSampler *zipf) {
+    double u = random_unit();
+    int low = 0, high = zipf->n - 1;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (zipf->cdf[mid] < u) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// ---------------------------------------------------------------------------
+// Schema and data
+// ---------------------------------------------------------------------------
+
+// Spreads Zipf ranks over the domain so the popular values are not all small
+static long long scatter_rank(int rank, int domain) {
+    return (long long)rank * 7919 % domain;
+}
+
+static void generate_table(long long **columns, int rows, const WorkloadOptions *options,
+                           const ZipfSampler *fk_zipf, const ZipfSampler *val_zipf) {
+    for (int row = 0; row < rows; row++) {
+        long long val = scatter_rank(zipf_sample(val_zipf), WORKLOAD_VAL_DOMAIN);
+        columns[0][row] = row + 1;
+        columns[1][row] = scatter_rank(zipf_sample(fk_zipf), options->min_rows) + 1;
+        columns[2][row] = val;
+        columns[3][row] = random_unit() < options->correlation ? val / 10 : random_below(WORKLOAD_COR_DOMAIN);
+    }
+}
+
+// Records distinct count, range, an equi-depth histogram and, for skewed
+// columns, the most common values of values[0 .. rows), which lie in [0, max_value]
+static void add_generated_column_stats(TableStats *table, const char *column, const long long *values,
+                                       int rows, int max_value) {
+    int *counts = (int *)calloc(max_value + 1, sizeof(int));
+    for (int row = 0; row < rows; row++) counts[values[row]]++;
+
+    int distinct = 0, min = max_value, max = 0;
+    for (int v = 0; v <= max_value; v++) {
+        if (!counts[v]) continue;
+        distinct++;
+        if (v < min) min = v;
+        if (v > max) max = v;
+    }
+    ColumnStats *stats = add_column_stats(table, column, distinct, min, max, 1.0 / distinct);
+
+    int bounds[WORKLOAD_HISTOGRAM_BUCKETS + 1];
+    int bucket = 1;
+    long long seen = 0;
+    bounds[0] = min;
+    for (int v = min; v <= max && bucket < WORKLOAD_HISTOGRAM_BUCKETS; v++) {
+        seen += counts[v];
+        while (bucket < WORKLOAD_HISTOGRAM_BUCKETS && seen >= (long long)rows * bucket / WORKLOAD_HISTOGRAM_BUCKETS) {
+            bounds[bucket++] = v;
+        }
+    }
+    while (bucket <= WORKLOAD_HISTOGRAM_BUCKETS) bounds[bucket++] = max;
+    set_column_histogram(stats, bounds, WORKLOAD_HISTOGRAM_BUCKETS);
+
+    // Only values at least twice as common as average are worth listing
+    int mcv_values[WORKLOAD_MCV_COUNT];
+    double mcv_frequencies[WORKLOAD_MCV_COUNT];
+    int mcv_count = 0;
+    for (int m = 0; m < WORKLOAD_MCV_COUNT; m++) {
+        int best = -1;
+        for (int v = min; v <= max; v++) {
+            if (counts[v] > 0 && (best < 0 || counts[v] > counts[best])) best = v;
+        }
+        if (best < 0 || counts[best] < 2.0 * rows / distinct) break;
+        mcv_values[mcv_count] = best;
+        mcv_frequencies[mcv_count++] = (double)counts[best] / rows;
+        counts[best] = 0;
+    }
+    set_column_mcv(stats, mcv_values, mcv_frequencies, mcv_count);
+    free(counts);
+}
+
+static int write_column_file(const char *path, const char *table_name, long long **columns, int rows) {
+    uint64_t size = colfile_size(WORKLOAD_COLUMNS, rows);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, size) < 0) {
+        perror(path);
+        return -1;
+    }
+    char *mapping = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    ColumnFileHeader *header = (ColumnFileHeader *)mapping;
+    memcpy(header->magic, COLFILE_MAGIC, sizeof(header->magic));
+    header->version = COLFILE_VERSION;
+    header->column_count = WORKLOAD_COLUMNS;
+    header->row_count = rows;
+    strncpy(header->table_name, table_name, COLFILE_NAME_LENGTH - 1);
+
+    ColumnFileEntry *entries = (ColumnFileEntry *)(header + 1);
+    for (int c = 0; c < WORKLOAD_COLUMNS; c++) {
+        strcpy(entries[c].name, column_names[c]);
+        entries[c].type = COLUMN_INT64;
+        entries[c].offset = colfile_column_offset(WORKLOAD_COLUMNS, rows, c);
+        memcpy(mapping + entries[c].offset, columns[c], rows * sizeof(long long));
+    }
+
+    int status = 0;
+    if (msync(mapping, size, MS_SYNC) < 0) {
+        perror(path);
+        status = -1;
+    }
+    munmap(mapping, size);
+    close(fd);
+    return status;
+}
+
+// Generates every table, writing its .col file and statistics; returns total rows or -1
+static long long generate_schema(const WorkloadOptions *options) {
+    ZipfSampler fk_zipf, val_zipf;
+    zipf_init(&fk_zipf, options->min_rows, options->skew);
+    zipf_init(&val_zipf, WORKLOAD_VAL_DOMAIN, options->skew);
+
+    long long **columns = (long long **)malloc(WORKLOAD_COLUMNS * sizeof(long long *));
+    for (int c = 0; c < WORKLOAD_COLUMNS; c++) {
+        columns[c] = (long long *)malloc((size_t)options->max_rows * sizeof(long long));
+    }
+
+    long long total_rows = 0;
+    for (int t = 0; t < options->tables; t++) {
+        // Log-uniform between min_rows and max_rows
+        double exponent = random_unit();
+        int rows = (int)(options->min_rows * pow((double)options->max_rows / options->min_rows, exponent));
+        char name[32];
+        snprintf(name, sizeof(name), "t%d", t);
+        generate_table(columns, rows, options, &fk_zipf, &val_zipf);
+
+        TableStats *table = add_table_stats(name, rows, WORKLOAD_COLUMNS * (int)sizeof(long long));
+        add_generated_column_stats(table, "id", columns[0], rows, rows);
+        add_generated_column_stats(table, "fk", columns[1], rows, options->min_rows);
+        add_generated_column_stats(table, "val", columns[2], rows, WORKLOAD_VAL_DOMAIN - 1);
+        add_generated_column_stats(table, "cor", columns[3], rows, WORKLOAD_COR_DOMAIN - 1);
+
+        if (options->write_data) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s.col", options->dir, name);
+            if (write_column_file(path, name, columns, rows) < 0) return -1;
+        }
+        total_rows += rows;
+    }
+
+    for (int c = 0; c < WORKLOAD_COLUMNS; c++) free(columns[c]);
+    free(columns);
+    free(fk_zipf.cdf);
+    free(val_zipf.cdf);
+    return total_rows;
+}
+
+// ---------------------------------------------------------------------------
+// Queries
+// ---------------------------------------------------------------------------
+
+// Whether the join graph of the given shape has an edge between the i-th and
+// j-th relation of a query (j < i) over count relations
+static int has_edge(JoinShape shape, int i, int j, int count) {
+    switch (shape) {
+        case SHAPE_CHAIN:  return j == i - 1;
+        case SHAPE_STAR:   return j == 0;
+        case SHAPE_CYCLE:  return j == i - 1 || (count > 2 && i == count - 1 && j == 0);
+        case SHAPE_CLIQUE: return 1;
+        case SHAPE_MIXED:  break;
+    }
+    return 0;
+}
+
+static void write_query(FILE *out, const WorkloadOptions *options) {
+    int count = options->min_relations + random_below(options->max_relations - options->min_relations + 1);
+    JoinShape shape = options->shape == SHAPE_MIXED ? (JoinShape)random_below(SHAPE_MIXED) : options->shape;
+
+    // Distinct tables by a partial Fisher-Yates shuffle
+    int *order = (int *)malloc(options->tables * sizeof(int));
+    for (int t = 0; t < options->tables; t++) order[t] = t;
+    for (int i = 0; i < count; i++) {
+        int pick = i + random_below(options->tables - i);
+        int swap = order[i];
+        order[i] = order[pick];
+        order[pick] = swap;
+    }
+
+    fprintf(out, "SELECT t%d.val, t%d.id FROM t%d", order[0], order[count - 1], order[0]);
+    for (int i = 1; i < count; i++) {
+        fprintf(out, " JOIN t%d ON", order[i]);
+        int conjuncts = 0;
+        for (int j = 0; j < i; j++) {
+            if (!has_edge(shape, i, j, count)) continue;
+            // Alternate the direction of the foreign key along the graph
+            int from = (i + j) % 2 ? order[i] : order[j], to = from == order[i] ? order[j] : order[i];
+            fprintf(out, "%s t%d.fk = t%d.id", conjuncts++ ? " AND" : "", from, to);
+        }
+    }
+
+    int filters = random_below(options->filters + 1);
+    for (int f = 0; f < filters; f++) {
+        int table = order[random_below(count)];
+        fprintf(out, f == 0 ? " WHERE" : " AND");
+        switch (random_below(4)) {
+            case 0: fprintf(out, " t%d.val < %d", table, random_below(WORKLOAD_VAL_DOMAIN)); break;
+            case 1: fprintf(out, " t%d.val = %lld", table, scatter_rank(random_below(10), WORKLOAD_VAL_DOMAIN)); break;
+            case 2: fprintf(out, " t%d.cor > %d", table, random_below(WORKLOAD_COR_DOMAIN)); break;
+            case 3: fprintf(out, " t%d.fk < %d", table, 1 + random_below(options->min_rows)); break;
+        }
+    }
+    fprintf(out, ";\n");
+    free(order);
+}
+
+// ---------------------------------------------------------------------------
+// Driver
+// ---------------------------------------------------------------------------
+
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s <output dir> [--tables <n>] [--min-rows <n>] [--max-rows <n>]\n", program);
+    fprintf(stderr, "           [--skew <s>] [--correlation <r>] [--queries <n>]\n");
+    fprintf(stderr, "           [--shape chain|star|cycle|clique|mixed] [--min-relations <n>]\n");
+    fprintf(stderr, "           [--max-relations <n>] [--filters <n>] [--seed <n>] [--no-data]\n");
+}
+
+static int parse_shape(const char *text, JoinShape *shape) {
+    for (int s = 0; s <= SHAPE_MIXED; s++) {
+        if (strcmp(text, shape_names[s]) == 0) {
+            *shape = (JoinShape)s;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    WorkloadOptions options = {NULL, 50, 1000, 100000, 0.0, 0.0, 100, SHAPE_MIXED, 2, 50, 2, 1, 1};
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        int has_value = i + 1 < argc;
+        if (arg[0] != '-' && !options.dir) options.dir = arg;
+        else if (strcmp(arg, "--tables") == 0 && has_value) options.tables = atoi(argv[++i]);
+        else if (strcmp(arg, "--min-rows") == 0 && has_value) options.min_rows = atoi(argv[++i]);
+        else if (strcmp(arg, "--max-rows") == 0 && has_value) options.max_rows = atoi(argv[++i]);
+        else if (strcmp(arg, "--skew") == 0 && has_value) options.skew = atof(argv[++i]);
+        else if (strcmp(arg, "--correlation") == 0 && has_value) options.correlation = atof(argv[++i]);
+        else if (strcmp(arg, "--queries") == 0 && has_value) options.queries = atoi(argv[++i]);
+        else if (strcmp(arg, "--min-relations") == 0 && has_value) options.min_relations = atoi(argv[++i]);
+        else if (strcmp(arg, "--max-relations") == 0 && has_value) options.max_relations = atoi(argv[++i]);
+        else if (strcmp(arg, "--filters") == 0 && has_value) options.filters = atoi(argv[++i]);
+        else if (strcmp(arg, "--seed") == 0 && has_value) options.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(arg, "--no-data") == 0) options.write_data = 0;
+        else if (strcmp(arg, "--shape") == 0 && has_value && parse_shape(argv[i + 1], &options.shape)) i++;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!options.dir || options.tables < 1 || options.min_rows < 1 || options.max_rows < options.min_rows ||
+        options.min_relations < 1 || options.max_relations < options.min_relations || options.filters < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    // A query joins distinct tables
+    if (options.max_relations > options.tables) options.max_relations = options.tables;
+    if (options.max_relations > WORKLOAD_MAX_RELATIONS) options.max_relations = WORKLOAD_MAX_RELATIONS;
+    if (options.min_relations > options.max_relations) options.min_relations = options.max_relations;
+
+    mkdir(options.dir, 0755);
+    rng_state = options.seed;
+
+    long long total_rows = generate_schema(&options);
+    if (total_rows < 0) return 1;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/stats.txt", options.dir);
+    if (save_stats(path) < 0) return 1;
+
+    snprintf(path, sizeof(path), "%s/queries.sql", options.dir);
+    FILE *out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return 1;
+    }
+    for (int q = 0; q < options.queries; q++) write_query(out, &options);
+    fclose(out);
+
+    printf("Generated %d tables (%lld rows%s) and %d %s queries over %d-%d relations in %s\n", options.tables,
+           total_rows, options.write_data ? "" : ", statistics only", options.queries, shape_names[options.shape],
+           options.min_relations, options.max_relations, options.dir);
+    free_stats();
+    return 0;
+}